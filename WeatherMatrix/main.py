@@ -62,6 +62,8 @@ def parse_args() -> argparse.Namespace:
     parser.add_argument("--led-chain", type=int, default=2)
     parser.add_argument("--led-parallel", type=int, default=1)
     parser.add_argument("--led-pwm-bits", type=int, default=11)
+    parser.add_argument("--dither-bits", type=int, default=0,
+                        help="Temporal dithering: extra color depth on top of --led-pwm-bits (0-4)")
     parser.add_argument("--led-slowdown-gpio", type=int, default=2)
     parser.add_argument("--brightness", type=int, default=80)
     parser.add_argument("--font", default=DEFAULT_FONT)
@@ -136,6 +138,23 @@ def init_matrix(args: argparse.Namespace) -> RGBMatrix:
     return RGBMatrix(options=options)
 
 
+def init_canvas(matrix: RGBMatrix, args: argparse.Namespace):
+    """Canvas to draw on: the matrix itself, or a dithering canvas that needs show()."""
+    if args.dither_bits <= 0:
+        return matrix
+    from rgbmatrix import DitherCanvas  # pylint: disable=import-outside-toplevel
+
+    canvas = DitherCanvas(matrix, extra_bits=args.dither_bits)
+    logging.info("Temporal dithering: %s extra bits", canvas.extra_bits)
+    return canvas
+
+
+def show(canvas) -> None:
+    """Put what was drawn on the panel; drawing on the matrix directly shows right away."""
+    if hasattr(canvas, "Show"):
+        canvas.Show()
+
+
 def load_font(font_path: str) -> graphics.Font:
     if graphics is None:
         raise SystemExit("rgbmatrix library not available")
@@ -232,15 +251,18 @@ def weather_loop(matrix, font, service: WeatherService, args: argparse.Namespace
                 weather.condition_main,
             )
             draw_weather(matrix, font, weather)
+            show(matrix)
             last_error = None
         except WeatherProviderError as err:
             logging.error("Weather fetch failed: %s", err)
             if last_error != str(err):
                 draw_status(matrix, font, "WEATHER API ERROR", graphics.Color(255, 0, 0))
+                show(matrix)
             last_error = str(err)
         except Exception as exc:
             logging.exception("Unexpected error: %s", exc)
             draw_status(matrix, font, "FATAL ERROR", graphics.Color(255, 0, 0))
+            show(matrix)
 
         time.sleep(max(args.refresh, 1.0))
 
@@ -256,19 +278,23 @@ def main() -> None:
     api_key, lat, lon, _ = load_config(args.units)
 
     matrix = init_matrix(args)
+    canvas = init_canvas(matrix, args)
     font = load_font(args.font)
     service = build_weather_service(api_key, lat, lon, args)
 
     signal.signal(signal.SIGINT, signal_handler)
     signal.signal(signal.SIGTERM, signal_handler)
 
-    draw_status(matrix, font, "Starting weather display", graphics.Color(0, 255, 0))
+    draw_status(canvas, font, "Starting weather display", graphics.Color(0, 255, 0))
+    show(canvas)
 
     try:
-        weather_loop(matrix, font, service, args)
+        weather_loop(canvas, font, service, args)
     except KeyboardInterrupt:
         logging.info("Stopping display")
     finally:
+        if canvas is not matrix:
+            canvas.Stop()
         matrix.Clear()
         logging.info("Matrix cleared")
 
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Compare two led-bench JSON results.
+
+  ./compare.py baseline.json new.json [--threshold 5] [--fail]
+
+Prints the change in CPU time per operation for every benchmark present in
+both files. Changes beyond the threshold (percent) are marked. With --fail,
+exits with status 1 if any benchmark got slower by more than the threshold.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(filename):
+    with open(filename) as f:
+        data = json.load(f)
+    return data.get("context", {}), {b["name"]: b for b in data["benchmarks"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("contender")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="Percent change to mark (default: 5)")
+    parser.add_argument("--metric", choices=("cpu_time", "real_time"),
+                        default="cpu_time")
+    parser.add_argument("--fail", action="store_true",
+                        help="Exit 1 if anything got slower than threshold")
+    args = parser.parse_args()
+
+    base_context, base = load(args.baseline)
+    new_context, new = load(args.contender)
+    for key in ("machine", "panel"):
+        if base_context.get(key) != new_context.get(key):
+            print("Note: %s differs: %s vs. %s" % (
+                key, base_context.get(key), new_context.get(key)))
+
+    print("%-36s %14s %14s %9s" % ("Benchmark", "Baseline", "Contender",
+                                   "Change"))
+    regressions = 0
+    for name, b in base.items():
+        if name not in new:
+            print("%-36s %14.1f %14s" % (name, b[args.metric], "missing"))
+            continue
+        before = b[args.metric]
+        after = new[name][args.metric]
+        change = 100.0 * (after - before) / before if before > 0 else 0.0
+        mark = ""
+        if change > args.threshold:
+            mark = "  slower"
+            regressions += 1
+        elif change < -args.threshold:
+            mark = "  faster"
+        print("%-36s %11.1f ns %11.1f ns %+8.1f%%%s" % (
+            name, before, after, change, mark))
+    for name in new:
+        if name not in base:
+            print("%-36s %14s %11.1f ns" % (name, "new",
+                                            new[name][args.metric]))
+
+    if args.fail and regressions:
+        print("%d benchmark(s) slower than +%g%%" % (regressions,
+                                                     args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
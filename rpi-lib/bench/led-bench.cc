@@ -0,0 +1,517 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Microbenchmarks of the CPU hot paths of the library: drawing, fonts,
+// streams and pixel mappers. Runs without touching the GPIO.
+// Use compare.py to compare the JSON output of two runs.
+
+#include "led-matrix.h"
+#include "graphics.h"
+#include "content-streamer.h"
+#include "pixel-mapper.h"
+#include "sprite.h"
+#include "transitions.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/utsname.h>
+#include <time.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace rgb_matrix;
+
+// Keeps the compiler from optimizing away results nobody looks at.
+static volatile int sink;
+
+struct Benchmark {
+  std::string name;
+  // Runs the operation "iterations" times.
+  std::function<void(int64_t iterations)> run;
+};
+
+struct Result {
+  std::string name;
+  int64_t iterations;
+  double real_ns;  // Per iteration, best of the repetitions.
+  double cpu_ns;
+};
+
+static double NowNs(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static Result Measure(const Benchmark &b, double min_seconds,
+                      int repetitions) {
+  // Find an iteration count that runs for at least "min_seconds".
+  int64_t iterations = 1;
+  for (;;) {
+    const double start = NowNs(CLOCK_MONOTONIC);
+    b.run(iterations);
+    const double elapsed = NowNs(CLOCK_MONOTONIC) - start;
+    if (elapsed >= min_seconds * 1e9 || iterations >= (1LL << 40)) break;
+    const double factor = elapsed > 0 ? 1.4 * min_seconds * 1e9 / elapsed
+      : 100;
+    iterations = std::max(iterations + 1,
+                          (int64_t)(iterations * std::min(factor, 100.0)));
+  }
+  Result result = { b.name, iterations, 0, 0 };
+  for (int r = 0; r < repetitions; ++r) {
+    const double real_start = NowNs(CLOCK_MONOTONIC);
+    const double cpu_start = NowNs(CLOCK_THREAD_CPUTIME_ID);
+    b.run(iterations);
+    const double cpu = (NowNs(CLOCK_THREAD_CPUTIME_ID) - cpu_start)
+      / iterations;
+    const double real = (NowNs(CLOCK_MONOTONIC) - real_start) / iterations;
+    if (r == 0 || real < result.real_ns) result.real_ns = real;
+    if (r == 0 || cpu < result.cpu_ns) result.cpu_ns = cpu;
+  }
+  return result;
+}
+
+static void AddCanvasBenchmarks(FrameCanvas *canvas,
+                                std::vector<Benchmark> *benchmarks) {
+  const int width = canvas->width();
+  const int height = canvas->height();
+  benchmarks->push_back({"Canvas/SetPixel", [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) {
+          canvas->SetPixel(i % width, (i / width) % height,
+                           i & 0xff, 0x80, 0x40);
+        }
+      }});
+  benchmarks->push_back({"Canvas/Fill", [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) canvas->Fill(i & 0xff, 0x80, 0x40);
+      }});
+  benchmarks->push_back({"Canvas/Clear", [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) canvas->Clear();
+      }});
+
+  // An image the size of the canvas.
+  std::vector<uint8_t> image(3 * width * height);
+  for (size_t i = 0; i < image.size(); ++i) image[i] = i * 7;
+  benchmarks->push_back({"SetImage/RGB", [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) {
+          SetImage(canvas, 0, 0, image.data(), image.size(),
+                   width, height, false);
+        }
+      }});
+  benchmarks->push_back({"SetImage/BGR", [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) {
+          SetImage(canvas, 0, 0, image.data(), image.size(),
+                   width, height, true);
+        }
+      }});
+
+  const Color color(255, 128, 0);
+  benchmarks->push_back({"DrawLine/diagonal", [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) {
+          DrawLine(canvas, 0, 0, width - 1, height - 1, color);
+        }
+      }});
+  benchmarks->push_back({"DrawCircle/r15", [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) {
+          DrawCircle(canvas, width / 2, height / 2, 15, color);
+        }
+      }});
+
+  std::string serialized;
+  {
+    const char *data;
+    size_t len;
+    canvas->Serialize(&data, &len);
+    serialized.assign(data, len);
+  }
+  benchmarks->push_back({"FrameCanvas/Serialize", [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) {
+          const char *data;
+          size_t len;
+          canvas->Serialize(&data, &len);
+          sink = data[len - 1];
+        }
+      }});
+  benchmarks->push_back({"FrameCanvas/Deserialize", [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) {
+          canvas->Deserialize(serialized.data(), serialized.size());
+        }
+      }});
+}
+
+static void AddStreamBenchmarks(FrameCanvas *canvas,
+                                std::vector<Benchmark> *benchmarks) {
+  benchmarks->push_back({"StreamWriter/Stream", [=](int64_t n) {
+        // Start over every so often, so that memory use stays bounded.
+        MemStreamIO *io = NULL;
+        StreamWriter *writer = NULL;
+        for (int64_t i = 0; i < n; ++i) {
+          if (i % 256 == 0) {
+            delete writer;
+            delete io;
+            io = new MemStreamIO();
+            writer = new StreamWriter(io);
+          }
+          writer->Stream(*canvas, 10000);
+        }
+        delete writer;
+        delete io;
+      }});
+
+  // Recording 10k frames of 4KB (a small panel) in memory.
+  static const int kRecordFrames = 10000;
+  const std::vector<char> block(4096, 0x55);
+  benchmarks->push_back({"MemStreamIO/Append10k", [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) {
+          MemStreamIO io;
+          for (int f = 0; f < kRecordFrames; ++f)
+            io.Append(block.data(), block.size());
+        }
+      }});
+  benchmarks->push_back({"ChunkedMemStreamIO/Append10k", [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) {
+          ChunkedMemStreamIO io;
+          for (int f = 0; f < kRecordFrames; ++f)
+            io.Append(block.data(), block.size());
+        }
+      }});
+  benchmarks->push_back({"ChunkedMemStreamIO/Append10k/memfd",
+        [=](int64_t n) {
+        for (int64_t i = 0; i < n; ++i) {
+          ChunkedMemStreamIO io(1 << 20, true);
+          for (int f = 0; f < kRecordFrames; ++f)
+            io.Append(block.data(), block.size());
+        }
+      }});
+
+  // Shared between runs; only read from.
+  std::shared_ptr<MemStreamIO> recorded(new MemStreamIO());
+  {
+    StreamWriter writer(recorded.get());
+    for (int i = 0; i < 64; ++i) writer.Stream(*canvas, 10000);
+  }
+  benchmarks->push_back({"StreamReader/GetNext", [=](int64_t n) {
+        StreamReader reader(recorded.get());
+        uint32_t hold_time_us;
+        for (int64_t i = 0; i < n; ++i) {
+          if (!reader.GetNext(canvas, &hold_time_us)) {
+            reader.Rewind();
+            reader.GetNext(canvas, &hold_time_us);
+          }
+        }
+      }});
+}
+
+static void AddFontBenchmarks(FrameCanvas *canvas, const std::string &dir,
+                              std::vector<Benchmark> *benchmarks) {
+  static const char *const kFonts[] = {
+    "4x6.bdf", "6x10.bdf", "9x18.bdf", "texgyre-27.bdf"
+  };
+  static const char kText[] = "Hello, World! 12:34";
+  const Color color(255, 255, 0);
+  const Color outline(0, 0, 255);
+  for (const char *font_name : kFonts) {
+    const std::string path = dir + "/" + font_name;
+    std::shared_ptr<Font> font(new Font());
+    if (!font->LoadFont(path.c_str())) {
+      fprintf(stderr, "Skipping %s: can't load\n", path.c_str());
+      continue;
+    }
+    const std::string name = std::string(font_name, strlen(font_name) - 4);
+    const int y = font->baseline();
+    benchmarks->push_back({"Font/LoadFont/" + name, [=](int64_t n) {
+          for (int64_t i = 0; i < n; ++i) {
+            Font f;
+            f.LoadFont(path.c_str());
+          }
+        }});
+    benchmarks->push_back({"DrawText/" + name, [=](int64_t n) {
+          for (int64_t i = 0; i < n; ++i) {
+            sink = DrawText(canvas, *font, 0, y, color, NULL, kText);
+          }
+        }});
+    benchmarks->push_back({"DrawTextOutlined/" + name, [=](int64_t n) {
+          for (int64_t i = 0; i < n; ++i) {
+            sink = DrawTextOutlined(canvas, *font, 1, y, color, outline,
+                                    kText);
+          }
+        }});
+    benchmarks->push_back({"TextRunCache/DrawText/" + name, [=](int64_t n) {
+          TextRunCache cache;
+          for (int64_t i = 0; i < n; ++i) {
+            sink = cache.DrawText(canvas, *font, 0, y, color, NULL, kText);
+          }
+        }});
+    benchmarks->push_back({"MeasureText/" + name, [=](int64_t n) {
+          for (int64_t i = 0; i < n; ++i) {
+            sink = MeasureText(*font, kText);
+          }
+        }});
+  }
+}
+
+static void AddTransitionBenchmarks(FrameCanvas *canvas,
+                                    std::vector<Benchmark> *benchmarks) {
+  static const char *const kNames[] = {
+    "Crossfade", "WipeLeft", "WipeRight", "WipeUp", "WipeDown",
+    "SlideLeft", "SlideRight", "SlideUp", "SlideDown", "Dissolve"
+  };
+  // One operation is one frame of the transition. Blending is measured at
+  // 192x64 (three 64x64 panels), independent of the canvas size.
+  const int width = 192, height = 64;
+  std::shared_ptr<std::vector<uint8_t> > images(
+    new std::vector<uint8_t>(2 * 3 * width * height));
+  for (size_t i = 0; i < images->size(); ++i) (*images)[i] = i * 7;
+  const uint8_t *from = images->data();
+  const uint8_t *to = from + 3 * width * height;
+  for (int t = Transition::CROSSFADE; t <= Transition::DISSOLVE; ++t) {
+    const Transition::Type type = (Transition::Type)t;
+    benchmarks->push_back({"Transition/Blend/" + std::string(kNames[t]),
+          [=](int64_t n) {
+          Transition transition(type, width, height, from, to);
+          for (int64_t i = 0; i < n; ++i) {
+            sink = transition.Blend((i % 59 + 1) / 60.0f)[0];
+          }
+          (void)images;  // Keeps the images alive.
+        }});
+  }
+
+  // Including writing into the canvas.
+  std::shared_ptr<std::vector<uint8_t> > canvas_images(
+    new std::vector<uint8_t>(2 * 3 * canvas->width() * canvas->height()));
+  for (size_t i = 0; i < canvas_images->size(); ++i)
+    (*canvas_images)[i] = i * 7;
+  benchmarks->push_back({"Transition/Render/Crossfade", [=](int64_t n) {
+        const int size = 3 * canvas->width() * canvas->height();
+        Transition transition(Transition::CROSSFADE,
+                              canvas->width(), canvas->height(),
+                              canvas_images->data(),
+                              canvas_images->data() + size);
+        for (int64_t i = 0; i < n; ++i) {
+          transition.Render((i % 59 + 1) / 60.0f, canvas);
+        }
+      }});
+}
+
+static void AddSpriteBenchmarks(FrameCanvas *canvas,
+                                std::vector<Benchmark> *benchmarks) {
+  // A 64x64 image spinning around the center of the canvas, a degree per
+  // operation, like the rotating block of demo -D 0.
+  const int size = 64;
+  std::shared_ptr<std::vector<uint8_t> > pixels(
+    new std::vector<uint8_t>(4 * size * size));
+  for (size_t i = 0; i < pixels->size(); ++i)
+    (*pixels)[i] = (i % 4 == 3) ? ((i / 4) % 7 ? 255 : 0) : i * 7;
+  const struct {
+    const char *name;
+    Sprite::Format format;
+    SpriteSampling sampling;
+  } kVariants[] = {
+    { "Nearest", Sprite::RGB, SAMPLE_NEAREST },
+    { "Bilinear", Sprite::RGB, SAMPLE_BILINEAR },
+    { "Nearest/RGBA", Sprite::RGBA, SAMPLE_NEAREST },
+    { "Bilinear/RGBA", Sprite::RGBA, SAMPLE_BILINEAR },
+  };
+  for (const auto &v : kVariants) {
+    const Sprite sprite(pixels->data(), size, size, v.format);
+    const SpriteSampling sampling = v.sampling;
+    benchmarks->push_back({"DrawSprite/" + std::string(v.name),
+          [=](int64_t n) {
+          for (int64_t i = 0; i < n; ++i) {
+            AffineTransform t;
+            t.Translate(-size / 2.0f, -size / 2.0f)
+              .Rotate((i % 360) * 3.14159265f / 180)
+              .Translate(canvas->width() / 2.0f, canvas->height() / 2.0f);
+            DrawSprite(canvas, sprite, t, sampling);
+          }
+          (void)pixels;  // Keeps the pixels alive.
+        }});
+  }
+}
+
+// Parameter to instantiate the standard mappers with.
+static const char *MapperParameter(const std::string &name) {
+  if (strcasecmp(name.c_str(), "Rotate") == 0) return "90";
+  if (strcasecmp(name.c_str(), "Mirror") == 0) return "H";
+  if (strcasecmp(name.c_str(), "V-mapper") == 0) return "Z";
+  return NULL;
+}
+
+static void AddMapperBenchmarks(int panel_cols, int panel_rows,
+                                std::vector<Benchmark> *benchmarks) {
+  // Mappers such as the U-mapper need a chain to rearrange.
+  const int chain = 4;
+  const int parallel = 1;
+  const int matrix_width = panel_cols * chain;
+  const int matrix_height = panel_rows * parallel;
+  const std::vector<std::string> names = GetAvailablePixelMappers();
+  for (const std::string &name : names) {
+    const PixelMapper *mapper = FindPixelMapper(name.c_str(), chain, parallel,
+                                                MapperParameter(name));
+    int width, height;
+    if (mapper == NULL
+        || !mapper->GetSizeMapping(matrix_width, matrix_height,
+                                   &width, &height)) {
+      fprintf(stderr, "Skipping pixel mapper %s\n", name.c_str());
+      continue;
+    }
+    // One iteration maps every visible pixel once.
+    benchmarks->push_back({"PixelMapper/" + name, [=](int64_t n) {
+          int mx, my;
+          for (int64_t i = 0; i < n; ++i) {
+            for (int y = 0; y < height; ++y) {
+              for (int x = 0; x < width; ++x) {
+                mapper->MapVisibleToMatrix(matrix_width, matrix_height,
+                                           x, y, &mx, &my);
+              }
+            }
+            sink = mx + my;
+          }
+        }});
+  }
+}
+
+static std::string JsonEscape(const std::string &s) {
+  std::string result;
+  for (char c : s) {
+    if (c == '"' || c == '\\') result += '\\';
+    result += c;
+  }
+  return result;
+}
+
+static bool WriteJson(const char *filename, const RGBMatrix::Options &options,
+                      double min_seconds, const std::vector<Result> &results) {
+  FILE *out = (strcmp(filename, "-") == 0) ? stdout : fopen(filename, "w");
+  if (out == NULL) {
+    perror(filename);
+    return false;
+  }
+  struct utsname uts;
+  uname(&uts);
+  char date[64];
+  const time_t now = time(NULL);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+  fprintf(out, "{\n  \"context\": {\n");
+  fprintf(out, "    \"date\": \"%s\",\n", date);
+  fprintf(out, "    \"host\": \"%s\",\n", JsonEscape(uts.nodename).c_str());
+  fprintf(out, "    \"machine\": \"%s\",\n", JsonEscape(uts.machine).c_str());
+  fprintf(out, "    \"panel\": \"%dx%d chain %d parallel %d\",\n",
+          options.cols, options.rows, options.chain_length, options.parallel);
+  fprintf(out, "    \"min_time_seconds\": %g\n  },\n", min_seconds);
+  fprintf(out, "  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    fprintf(out, "    {\"name\": \"%s\", \"iterations\": %lld, "
+            "\"real_time\": %.2f, \"cpu_time\": %.2f, "
+            "\"time_unit\": \"ns\"}%s\n",
+            JsonEscape(r.name).c_str(), (long long)r.iterations,
+            r.real_ns, r.cpu_ns, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  if (out != stdout) fclose(out);
+  return true;
+}
+
+static int usage(const char *progname) {
+  fprintf(stderr, "usage: %s [options]\n", progname);
+  fprintf(stderr, "Options:\n"
+          "\t-o <file.json>    : Write results as JSON ('-' for stdout).\n"
+          "\t-f <filter>       : Only run benchmarks containing this text.\n"
+          "\t-t <seconds>      : Minimum time per measurement "
+          "(Default: 0.2).\n"
+          "\t-r <count>        : Repetitions, the best is reported "
+          "(Default: 3).\n"
+          "\t-F <font-dir>     : Directory with the BDF fonts "
+          "(Default: ../fonts).\n"
+          "\t-l                : List benchmarks and exit.\n\n");
+  rgb_matrix::PrintMatrixFlags(stderr);
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  RGBMatrix::Options matrix_options;
+  rgb_matrix::RuntimeOptions runtime_opt;
+  // Same panel for everyone unless asked otherwise, so that results compare.
+  matrix_options.rows = 32;
+  matrix_options.cols = 64;
+  if (!rgb_matrix::ParseOptionsFromFlags(&argc, &argv,
+                                         &matrix_options, &runtime_opt)) {
+    return usage(argv[0]);
+  }
+
+  const char *json_file = NULL;
+  const char *filter = NULL;
+  const char *font_dir = "../fonts";
+  double min_seconds = 0.2;
+  int repetitions = 3;
+  bool list_only = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "o:f:t:r:F:l")) != -1) {
+    switch (opt) {
+    case 'o': json_file = optarg; break;
+    case 'f': filter = optarg; break;
+    case 't': min_seconds = atof(optarg); break;
+    case 'r': repetitions = std::max(1, atoi(optarg)); break;
+    case 'F': font_dir = optarg; break;
+    case 'l': list_only = true; break;
+    default:
+      return usage(argv[0]);
+    }
+  }
+
+  runtime_opt.do_gpio_init = false;
+  RGBMatrix *matrix = RGBMatrix::CreateFromOptions(matrix_options,
+                                                   runtime_opt);
+  if (matrix == NULL) return 1;
+  FrameCanvas *canvas = matrix->CreateFrameCanvas();
+
+  std::vector<Benchmark> benchmarks;
+  AddCanvasBenchmarks(canvas, &benchmarks);
+  AddStreamBenchmarks(canvas, &benchmarks);
+  AddFontBenchmarks(canvas, font_dir, &benchmarks);
+  AddTransitionBenchmarks(canvas, &benchmarks);
+  AddSpriteBenchmarks(canvas, &benchmarks);
+  AddMapperBenchmarks(matrix_options.cols, matrix_options.rows, &benchmarks);
+
+  std::vector<Result> results;
+  if (!list_only) {
+    fprintf(stderr, "%-36s %15s %19s %12s\n",
+            "Benchmark", "Time/op", "CPU/op", "Iterations");
+  }
+  for (const Benchmark &b : benchmarks) {
+    if (filter && b.name.find(filter) == std::string::npos) continue;
+    if (list_only) {
+      printf("%s\n", b.name.c_str());
+      continue;
+    }
+    const Result r = Measure(b, min_seconds, repetitions);
+    fprintf(stderr, "%-36s %12.1f ns %12.1f ns cpu %12lld\n",
+            r.name.c_str(), r.real_ns, r.cpu_ns, (long long)r.iterations);
+    results.push_back(r);
+  }
+
+  delete matrix;
+  if (json_file && !list_only
+      && !WriteJson(json_file, matrix_options, min_seconds, results)) {
+    return 1;
+  }
+  return 0;
+}
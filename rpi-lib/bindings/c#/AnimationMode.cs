@@ -0,0 +1,14 @@
+namespace RPiRgbLEDMatrix;
+
+/// <summary>
+/// The order in which a <see cref="RGBLedAnimation"/> shows its frames.
+/// </summary>
+public enum AnimationMode
+{
+    /// <summary>0, 1, ... n-1, 0, 1, ...</summary>
+    Loop = 0,
+    /// <summary>0, 1, ... n-1, n-2, ... 1, 0, 1, ...</summary>
+    PingPong = 1,
+    /// <summary>0, 1, ... n-1, then the last frame stays.</summary>
+    Once = 2
+}
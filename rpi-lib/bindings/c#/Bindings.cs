@@ -45,6 +45,29 @@ internal static class Bindings
     [SuppressGCTransition]
     public static extern void led_matrix_set_brightness(IntPtr matrix, byte brightness);
 
+    [DllImport(Lib)]
+    public static extern IntPtr led_animation_create(IntPtr matrix);
+
+    [DllImport(Lib)]
+    public static extern void led_animation_delete(IntPtr animation);
+
+    [DllImport(Lib)]
+    public static extern IntPtr led_animation_add_frame(IntPtr animation, uint hold_time_us);
+
+    [DllImport(Lib)]
+    public static extern void led_animation_set_mode(IntPtr animation, int mode);
+
+    [DllImport(Lib)]
+    [return: MarshalAs(UnmanagedType.U1)]
+    public static extern bool led_animation_start(IntPtr animation);
+
+    [DllImport(Lib)]
+    public static extern void led_animation_stop(IntPtr animation);
+
+    [DllImport(Lib)]
+    [return: MarshalAs(UnmanagedType.U1)]
+    public static extern bool led_animation_is_playing(IntPtr animation);
+
     [DllImport(Lib, CharSet = CharSet.Ansi)]
     public static extern IntPtr load_font(string bdf_font_file);
 
@@ -56,6 +79,9 @@ internal static class Bindings
     public static extern int vertical_draw_text(IntPtr canvas, IntPtr font, int x, int y, byte r, byte g, byte b,
                                                 string utf8_text, int kerning_offset);
 
+    [DllImport(Lib, CharSet = CharSet.Ansi)]
+    public static extern int measure_text(IntPtr font, string utf8_text, int kerning_offset);
+
     [DllImport(Lib, CharSet = CharSet.Ansi)]
     public static extern void delete_font(IntPtr font);
 
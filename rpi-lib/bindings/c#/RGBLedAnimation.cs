@@ -0,0 +1,72 @@
+namespace RPiRgbLEDMatrix;
+
+/// <summary>
+/// Plays pre-rendered frames on its own thread in the native library.
+/// Each frame is drawn once; after <see cref="Start"/>, the player only
+/// swaps the frames on vsync, so no drawing or sleeping is needed in
+/// managed code.
+/// </summary>
+public class RGBLedAnimation : IDisposable
+{
+    private IntPtr _animation;
+    private bool disposedValue = false;
+
+    /// <summary>
+    /// Creates a player for the given matrix, which has to outlive it.
+    /// </summary>
+    /// <param name="matrix">The matrix to show the frames on.</param>
+    public RGBLedAnimation(RGBLedMatrix matrix) => _animation = led_animation_create(matrix.matrix);
+
+    /// <summary>
+    /// Adds a frame and returns the canvas to draw it on.
+    /// </summary>
+    /// <param name="holdTime">How long the frame is shown.</param>
+    /// <exception cref="InvalidOperationException">While playing.</exception>
+    public RGBLedCanvas AddFrame(TimeSpan holdTime)
+    {
+        var canvas = led_animation_add_frame(_animation, (uint)(holdTime.Ticks / 10));
+        if (canvas == IntPtr.Zero)
+            throw new InvalidOperationException("Can't add frames while playing");
+        return new(canvas);
+    }
+
+    /// <summary>
+    /// The order of frames; takes effect with the next <see cref="Start"/>.
+    /// </summary>
+    public AnimationMode Mode
+    {
+        set => led_animation_set_mode(_animation, (int)value);
+    }
+
+    /// <summary>
+    /// Starts playing from the first frame.
+    /// </summary>
+    /// <returns><see langword="false"/> if there are no frames or it is already playing.</returns>
+    public bool Start() => led_animation_start(_animation);
+
+    /// <summary>
+    /// Stops playing. The frame shown last stays on the matrix.
+    /// </summary>
+    public void Stop() => led_animation_stop(_animation);
+
+    /// <summary>
+    /// <see langword="false"/> once stopped, or after the last frame in <see cref="AnimationMode.Once"/>.
+    /// </summary>
+    public bool IsPlaying => led_animation_is_playing(_animation);
+
+    protected virtual void Dispose(bool disposing)
+    {
+        if (disposedValue) return;
+        led_animation_delete(_animation);
+        disposedValue = true;
+    }
+
+    ~RGBLedAnimation() => Dispose(false);
+
+    /// <inheritdoc/>
+    public void Dispose()
+    {
+        Dispose(true);
+        GC.SuppressFinalize(this);
+    }
+}
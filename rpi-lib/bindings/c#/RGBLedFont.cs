@@ -22,6 +22,13 @@ public class RGBLedFont : IDisposable
             return vertical_draw_text(canvas, _font, x, y, color.R, color.G, color.B, text, spacing);
     }
 
+    /// <summary>
+    /// Returns the width in pixels the text would take up when drawn, without drawing it.
+    /// </summary>
+    /// <param name="text">The text to measure.</param>
+    /// <param name="spacing">Additional spacing between characters.</param>
+    public int MeasureText(string text, int spacing = 0) => measure_text(_font, text, spacing);
+
     protected virtual void Dispose(bool disposing)
     {
         if (disposedValue) return;
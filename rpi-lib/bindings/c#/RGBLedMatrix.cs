@@ -8,7 +8,7 @@ namespace RPiRgbLEDMatrix;
 /// </summary>
 public class RGBLedMatrix : IDisposable
 {
-    private IntPtr matrix;
+    internal IntPtr matrix;
     private bool disposedValue = false;
 
     /// <summary>
@@ -22,22 +22,16 @@ Console.CancelKeyPress += (s, e) =>
     e.Cancel = true; // don't terminate, we need to dispose
 };
 
-var frame = -1;
-// preprocess frames to get delays and pixel buffers
-var frames = image.Frames
-    .Select(f => (
-        Pixels: f.DangerousTryGetSinglePixelMemory(out var memory) ? memory : throw new("Could not get pixel buffer"),
-        Delay: f.Metadata.GetGifMetadata().FrameDelay * 10
-    )).ToArray();
+// upload every frame once; the library then loops through them on its own
+using var animation = new RGBLedAnimation(matrix);
+foreach (var f in image.Frames)
+{
+    var pixels = f.DangerousTryGetSinglePixelMemory(out var memory) ? memory : throw new("Could not get pixel buffer");
+    var delay = TimeSpan.FromMilliseconds(f.Metadata.GetGifMetadata().FrameDelay * 10);
+    animation.AddFrame(delay).SetPixels(0, 0, canvas.Width, canvas.Height, MemoryMarshal.Cast<Rgb24, Color>(pixels.Span));
+}
+animation.Start();
 
 // run until user presses Ctrl+C
 while (running)
-{
-    frame = (frame + 1) % frames.Length;
-
-    var data = MemoryMarshal.Cast<Rgb24, Color>(frames[frame].Pixels.Span);
-    canvas.SetPixels(0, 0, canvas.Width, canvas.Height, data);
-
-    matrix.SwapOnVsync(canvas);
-    Thread.Sleep(frames[frame].Delay);
-}
+    Thread.Sleep(100);
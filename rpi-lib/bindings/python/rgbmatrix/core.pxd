@@ -10,6 +10,25 @@ cdef class FrameCanvas(Canvas):
 cdef class RGBMatrix(Canvas):
     cdef cppinc.RGBMatrix *__matrix
 
+cdef class StreamIO:
+    cdef cppinc.StreamIO *__io
+
+cdef class StreamWriter:
+    cdef cppinc.StreamWriter *__writer
+    cdef StreamIO __stream
+
+cdef class StreamReader:
+    cdef cppinc.StreamReader *__reader
+    cdef StreamIO __stream
+
+cdef class DitherCanvas(Canvas):
+    cdef cppinc.DitherCanvas *__canvas
+    cdef RGBMatrix __matrix
+
+cdef class AnimationPlayer:
+    cdef cppinc.AnimationPlayer *__player
+    cdef RGBMatrix __matrix
+
 cdef class RGBMatrixOptions:
     cdef cppinc.Options __options
     cdef cppinc.RuntimeOptions __runtime_options
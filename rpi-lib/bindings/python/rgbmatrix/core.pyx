@@ -1,8 +1,11 @@
 # distutils: language = c++
 
 from libcpp cimport bool
-from libc.stdint cimport uint8_t, uint32_t, uintptr_t
+from libc.stdint cimport uint8_t, uint32_t, uintptr_t, int64_t
+from cpython.exc cimport PyErr_CheckSignals
+from posix.time cimport clock_gettime, nanosleep, timespec, CLOCK_MONOTONIC
 import cython
+import os
 
 cdef extern from "Python.h":
     void* PyCapsule_GetPointer(object capsule, const char* name)
@@ -49,7 +52,7 @@ cdef class Canvas:
     @cython.boundscheck(False)
     @cython.wraparound(False)
     def SetPixelsPillow(self, int xstart, int ystart, int width, int height, object image_capsule):
-        cdef cppinc.FrameCanvas* my_canvas = <cppinc.FrameCanvas*>self._getCanvas()
+        cdef cppinc.Canvas* my_canvas = self._getCanvas()
         cdef int frame_width = my_canvas.width()
         cdef int frame_height = my_canvas.height()
         cdef int row, col
@@ -101,6 +104,78 @@ cdef class FrameCanvas(Canvas):
         def __get__(self): return (<cppinc.FrameCanvas*>self._getCanvas()).brightness()
         def __set__(self, val): (<cppinc.FrameCanvas*>self._getCanvas()).SetBrightness(val)
 
+    # The content of this canvas in its internal representation, as bytes.
+    # Only valid for a matrix with the same options.
+    def Serialize(self):
+        cdef const char *data
+        cdef size_t length
+        (<cppinc.FrameCanvas*>self._getCanvas()).Serialize(&data, &length)
+        return data[:length]
+
+    # Load content from Serialize(). Returns False if the size doesn't match.
+    def Deserialize(self, bytes data):
+        return (<cppinc.FrameCanvas*>self._getCanvas()).Deserialize(data, len(data))
+
+# Streams of pre-rendered frames, as written and played by led-image-viewer.
+# Render an animation once with StreamWriter, then play it back with
+# RGBMatrix.PlayStream() at native speed.
+cdef class StreamIO:
+    def __dealloc__(self):
+        del self.__io
+
+cdef class FileStreamIO(StreamIO):
+    def __cinit__(self, path, bint write = False):
+        flags = os.O_CREAT | os.O_TRUNC | os.O_WRONLY if write else os.O_RDONLY
+        (<StreamIO>self).__io = new cppinc.FileStreamIO(os.open(path, flags, 0o644))
+
+# Read-only; the file is memory mapped, so reading needs no system calls.
+cdef class MemMapViewInput(StreamIO):
+    def __cinit__(self, path):
+        cdef cppinc.MemMapViewInput *io = new cppinc.MemMapViewInput(
+            os.open(path, os.O_RDONLY))
+        (<StreamIO>self).__io = io
+        if not io.IsInitialized():
+            raise OSError("Can't map " + str(path))
+
+cdef class StreamWriter:
+    def __cinit__(self, StreamIO stream not None):
+        self.__stream = stream  # Keep it alive while we use it.
+        self.__writer = new cppinc.StreamWriter(stream.__io)
+
+    def __dealloc__(self):
+        del self.__writer
+
+    # Append the frame to be shown for "hold_time_us" microseconds.
+    def Stream(self, FrameCanvas canvas not None, uint32_t hold_time_us):
+        return self.__writer.Stream(
+            (<cppinc.FrameCanvas*>canvas._getCanvas())[0], hold_time_us)
+
+cdef class StreamReader:
+    def __cinit__(self, StreamIO stream not None):
+        self.__stream = stream
+        self.__reader = new cppinc.StreamReader(stream.__io)
+
+    def __dealloc__(self):
+        del self.__reader
+
+    def Rewind(self):
+        self.__reader.Rewind()
+
+    # Read the next frame into "canvas". Returns its hold time in
+    # microseconds, or None at the end of the stream.
+    def GetNext(self, FrameCanvas canvas not None):
+        cdef uint32_t hold_time_us = 0
+        cdef cppinc.FrameCanvas *frame = <cppinc.FrameCanvas*>canvas._getCanvas()
+        cdef bool success
+        with nogil:
+            success = self.__reader.GetNext(frame, &hold_time_us)
+        return hold_time_us if success else None
+
+cdef int64_t __monotonic_micros() nogil:
+    cdef timespec ts
+    clock_gettime(CLOCK_MONOTONIC, &ts)
+    return ts.tv_sec * 1000000 + ts.tv_nsec // 1000
+
 
 cdef class RGBMatrixOptions:
     def __cinit__(self):
@@ -270,6 +345,44 @@ cdef class RGBMatrix(Canvas):
     def SwapOnVSync(self, FrameCanvas newFrame, uint8_t framerate_fraction = 1):
         return __createFrameCanvas(self.__matrix.SwapOnVSync(newFrame.__canvas, framerate_fraction))
 
+    # Play the stream from "reader" with the timing it was written with,
+    # "loops" times (forever if negative), using the offscreen "canvas".
+    # Everything but checking for Ctrl-C between frames runs without the
+    # GIL. Returns the new offscreen canvas, like SwapOnVSync().
+    def PlayStream(self, StreamReader reader not None,
+                   FrameCanvas canvas not None, int loops = 1,
+                   uint8_t framerate_fraction = 1):
+        cdef cppinc.FrameCanvas *offscreen = <cppinc.FrameCanvas*>canvas._getCanvas()
+        cdef uint32_t hold_time_us
+        cdef int64_t wait_us
+        cdef timespec ts
+        cdef bool success
+        cdef int frames
+        cdef int k = 0
+        while loops < 0 or k < loops:
+            frames = 0
+            while True:
+                with nogil:
+                    success = reader.__reader.GetNext(offscreen, &hold_time_us)
+                    if success:
+                        wait_us = __monotonic_micros() + hold_time_us
+                        offscreen = self.__matrix.SwapOnVSync(
+                            offscreen, framerate_fraction)
+                        wait_us -= __monotonic_micros()
+                        if wait_us > 0:
+                            ts.tv_sec = wait_us // 1000000
+                            ts.tv_nsec = (wait_us % 1000000) * 1000
+                            nanosleep(&ts, NULL)
+                if not success:
+                    break
+                frames += 1
+                PyErr_CheckSignals()
+            reader.__reader.Rewind()
+            if frames == 0:
+                break  # Empty or unreadable stream.
+            k += 1
+        return __createFrameCanvas(offscreen)
+
     property luminanceCorrect:
         def __get__(self): return self.__matrix.luminance_correct()
         def __set__(self, luminanceCorrect): self.__matrix.set_luminance_correct(luminanceCorrect)
@@ -288,6 +401,106 @@ cdef class RGBMatrix(Canvas):
     property width:
         def __get__(self): return self.__matrix.width()
 
+# Plays pre-rendered frames on a thread of the library: draw each frame once
+# on the canvas returned by AddFrame(), then Start(). No Python code runs
+# while it plays, so a looping animation costs next to no CPU.
+cdef class AnimationPlayer:
+    LOOP = cppinc.ANIMATION_LOOP            # 0, 1, ... n-1, 0, 1, ...
+    PING_PONG = cppinc.ANIMATION_PING_PONG  # 0, 1, ... n-1, n-2, ... 1, 0, ...
+    ONCE = cppinc.ANIMATION_ONCE            # 0, 1, ... n-1, last frame stays.
+
+    def __cinit__(self, RGBMatrix matrix not None):
+        self.__matrix = matrix  # Has to outlive us.
+        self.__player = new cppinc.AnimationPlayer(matrix.__matrix)
+
+    def __dealloc__(self):
+        with nogil:
+            self.__player.Stop()
+        del self.__player
+
+    # Add a frame shown for "hold_time_us" microseconds; returns the
+    # FrameCanvas to draw it on. Not while playing.
+    def AddFrame(self, uint32_t hold_time_us):
+        cdef cppinc.FrameCanvas *frame = self.__player.AddFrame(hold_time_us)
+        if frame == NULL:
+            raise Exception("Can't add frames while playing")
+        return __createFrameCanvas(frame)
+
+    # Takes effect with the next Start().
+    def SetMode(self, int mode):
+        self.__player.SetMode(<cppinc.AnimationMode>mode)
+
+    # Start from the first frame. Returns False if there are no frames or
+    # it is already playing.
+    def Start(self):
+        return self.__player.Start()
+
+    # The frame shown last stays on the matrix, in the canvas that was shown
+    # before Start(), so your own canvases stay valid.
+    def Stop(self):
+        with nogil:
+            self.__player.Stop()
+
+    # False once stopped, or after the last frame in ONCE mode.
+    def IsPlaying(self):
+        return self.__player.IsPlaying()
+
+    property frame_count:
+        def __get__(self): return self.__player.frame_count()
+
+# Temporal dithering: shows more color depth than the matrix' pwm_bits by
+# cycling sub-frames on every refresh. Draw on it, then Show(). Don't use
+# SwapOnVSync() on the matrix while showing.
+cdef class DitherCanvas(Canvas):
+    def __cinit__(self, RGBMatrix matrix not None, int extra_bits = 3,
+                  int min_cycle_hz = 100):
+        cdef cppinc.DitherOptions options
+        options.extra_bits = extra_bits
+        options.min_cycle_hz = min_cycle_hz
+        self.__matrix = matrix  # Has to outlive us.
+        with nogil:  # Measures the refresh rate first.
+            self.__canvas = new cppinc.DitherCanvas(matrix.__matrix, options)
+
+    def __dealloc__(self):
+        if <void*>self.__canvas != NULL:
+            with nogil:
+                self.__canvas.Stop()
+            del self.__canvas
+            self.__canvas = NULL
+
+    cdef cppinc.Canvas* _getCanvas(self) except *:
+        return self.__canvas
+
+    def Fill(self, uint8_t red, uint8_t green, uint8_t blue):
+        self.__canvas.Fill(red, green, blue)
+
+    def Clear(self):
+        self.__canvas.Clear()
+
+    def SetPixel(self, int x, int y, uint8_t red, uint8_t green, uint8_t blue):
+        self.__canvas.SetPixel(x, y, red, green, blue)
+
+    # Show what is drawn now; returns once it is on the matrix.
+    def Show(self):
+        with nogil:
+            self.__canvas.Show()
+
+    # The last sub-frame stays on the matrix.
+    def Stop(self):
+        with nogil:
+            self.__canvas.Stop()
+
+    property width:
+        def __get__(self): return self.__canvas.width()
+
+    property height:
+        def __get__(self): return self.__canvas.height()
+
+    # Extra bits in use; fewer than asked for if the refresh rate is too low
+    # for min_cycle_hz.
+    property extra_bits:
+        def __get__(self): return self.__canvas.extra_bits()
+
 cdef __createFrameCanvas(cppinc.FrameCanvas* newCanvas):
     canvas = FrameCanvas()
     canvas.__canvas = newCanvas
@@ -1,4 +1,5 @@
 from libcpp cimport bool
+from libc.stddef cimport size_t
 from libc.stdint cimport uint8_t, uint32_t
 
 ########################
@@ -22,13 +23,15 @@ cdef extern from "led-matrix.h" namespace "rgb_matrix":
         void SetBrightness(uint8_t)
         uint8_t brightness()
         FrameCanvas *CreateFrameCanvas()
-        FrameCanvas *SwapOnVSync(FrameCanvas*, uint8_t)
+        FrameCanvas *SwapOnVSync(FrameCanvas*, uint8_t) nogil
 
     cdef cppclass FrameCanvas(Canvas):
         bool SetPWMBits(uint8_t)
         uint8_t pwmbits()
         void SetBrightness(uint8_t)
         uint8_t brightness()
+        void Serialize(const char **, size_t *)
+        bool Deserialize(const char *, size_t)
 
     struct RuntimeOptions:
       RuntimeOptions() except +
@@ -70,6 +73,53 @@ cdef extern from "led-matrix.h" namespace "rgb_matrix::RGBMatrix":
         const char *pixel_mapper_config
         const char *panel_type
 
+cdef extern from "content-streamer.h" namespace "rgb_matrix":
+    cdef cppclass StreamIO:
+        void Rewind()
+
+    cdef cppclass FileStreamIO(StreamIO):
+        FileStreamIO(int) except +
+
+    cdef cppclass MemMapViewInput(StreamIO):
+        MemMapViewInput(int) except +
+        bool IsInitialized()
+
+    cdef cppclass StreamWriter:
+        StreamWriter(StreamIO*) except +
+        bool Stream(const FrameCanvas&, uint32_t)
+
+    cdef cppclass StreamReader:
+        StreamReader(StreamIO*) except +
+        void Rewind() nogil
+        bool GetNext(FrameCanvas*, uint32_t*) nogil
+
+cdef extern from "animation-player.h" namespace "rgb_matrix":
+    cdef enum AnimationMode "rgb_matrix::AnimationPlayer::Mode":
+        ANIMATION_LOOP "rgb_matrix::AnimationPlayer::LOOP"
+        ANIMATION_PING_PONG "rgb_matrix::AnimationPlayer::PING_PONG"
+        ANIMATION_ONCE "rgb_matrix::AnimationPlayer::ONCE"
+
+    cdef cppclass AnimationPlayer:
+        AnimationPlayer(RGBMatrix*) except +
+        FrameCanvas *AddFrame(uint32_t)
+        int frame_count()
+        void SetMode(AnimationMode)
+        bool Start()
+        void Stop() nogil
+        bool IsPlaying()
+
+cdef extern from "temporal-dither.h" namespace "rgb_matrix::DitherCanvas":
+    cdef struct DitherOptions "rgb_matrix::DitherCanvas::Options":
+        int extra_bits
+        int min_cycle_hz
+
+cdef extern from "temporal-dither.h" namespace "rgb_matrix":
+    cdef cppclass DitherCanvas(Canvas):
+        DitherCanvas(RGBMatrix*, const DitherOptions&) nogil except +
+        void Show() nogil
+        void Stop() nogil
+        int extra_bits()
+
 cdef extern from "graphics.h" namespace "rgb_matrix":
     cdef struct Color:
         Color(uint8_t, uint8_t, uint8_t) except +
@@ -86,5 +136,14 @@ cdef extern from "graphics.h" namespace "rgb_matrix":
         int DrawGlyph(Canvas*, int, int, const Color, uint32_t);
 
     cdef int DrawText(Canvas*, const Font, int, int, const Color, const char*)
+    cdef int MeasureText(const Font, const char*, int)
+    cdef int DrawTextOutlined(Canvas*, const Font, int, int, const Color, const Color, const char*, int)
+    cdef cppclass TextRunCache:
+        TextRunCache(int) except +
+        int MeasureText(const Font, const char*, int)
+        int DrawText(Canvas*, const Font, int, int, const Color, const Color*, const char*, int)
+        int DrawTextOutlined(Canvas*, const Font, int, int, const Color, const Color, const char*, int)
+        void Clear()
+        int size()
     cdef void DrawCircle(Canvas*, int, int, int, const Color)
     cdef void DrawLine(Canvas*, int, int, int, int, const Color)
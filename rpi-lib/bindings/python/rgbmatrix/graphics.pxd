@@ -7,6 +7,9 @@ cdef class Color:
 cdef class Font:
     cdef cppinc.Font __font
 
+cdef class TextRunCache:
+    cdef cppinc.TextRunCache *__cache
+
 # Local Variables:
 # mode: python
 # End:
@@ -43,6 +43,37 @@ cdef class Font:
 def DrawText(core.Canvas c, Font f, int x, int y, Color color, text):
     return cppinc.DrawText(c._getCanvas(), f.__font, x, y, color.__color, text.encode('utf-8'))
 
+def DrawTextOutlined(core.Canvas c, Font f, int x, int y, Color color, Color outline, text, int kerning = 0):
+    return cppinc.DrawTextOutlined(c._getCanvas(), f.__font, x, y, color.__color, outline.__color, text.encode('utf-8'), kerning)
+
+def MeasureText(Font f, text, int kerning = 0):
+    return cppinc.MeasureText(f.__font, text.encode('utf-8'), kerning)
+
+# Remembers the layout of recently drawn texts, so that drawing the same
+# text again is just copying pixels. Fonts used with the cache have to stay
+# alive as long as the cache is used.
+cdef class TextRunCache:
+    def __cinit__(self, int max_runs = 32):
+        self.__cache = new cppinc.TextRunCache(max_runs)
+
+    def __dealloc__(self):
+        del self.__cache
+
+    def MeasureText(self, Font f, text, int kerning = 0):
+        return self.__cache.MeasureText(f.__font, text.encode('utf-8'), kerning)
+
+    def DrawText(self, core.Canvas c, Font f, int x, int y, Color color, text, int kerning = 0):
+        return self.__cache.DrawText(c._getCanvas(), f.__font, x, y, color.__color, NULL, text.encode('utf-8'), kerning)
+
+    def DrawTextOutlined(self, core.Canvas c, Font f, int x, int y, Color color, Color outline, text, int kerning = 0):
+        return self.__cache.DrawTextOutlined(c._getCanvas(), f.__font, x, y, color.__color, outline.__color, text.encode('utf-8'), kerning)
+
+    def Clear(self):
+        self.__cache.Clear()
+
+    def __len__(self):
+        return self.__cache.size()
+
 def DrawCircle(core.Canvas c, int x, int y, int r, Color color):
     cppinc.DrawCircle(c._getCanvas(), x, y, r, color.__color)
 
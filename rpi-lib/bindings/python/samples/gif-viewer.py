@@ -2,7 +2,7 @@
 import time
 import sys
 
-from rgbmatrix import RGBMatrix, RGBMatrixOptions
+from rgbmatrix import RGBMatrix, RGBMatrixOptions, AnimationPlayer
 from PIL import Image
 
 
@@ -29,17 +29,17 @@ options.hardware_mapping = 'regular'  # If you have an Adafruit HAT: 'adafruit-h
 
 matrix = RGBMatrix(options = options)
 
-# Preprocess the gifs frames into canvases to improve playback performance
-canvases = []
+# Preprocess the gifs frames into the canvases of an animation player, which
+# then loops through them on its own with the delays of the gif.
+player = AnimationPlayer(matrix)
 print("Preprocessing gif, this may take a moment depending on the size of the gif...")
 for frame_index in range(0, num_frames):
     gif.seek(frame_index)
+    delay_ms = gif.info.get("duration") or 100
     # must copy the frame out of the gif, since thumbnail() modifies the image in-place
     frame = gif.copy()
     frame.thumbnail((matrix.width, matrix.height), Image.LANCZOS)
-    canvas = matrix.CreateFrameCanvas()
-    canvas.SetImage(frame.convert("RGB"))
-    canvases.append(canvas)
+    player.AddFrame(int(delay_ms * 1000)).SetImage(frame.convert("RGB"))
 # Close the gif file to save memory now that we have copied out all of the frames
 gif.close()
 
@@ -48,13 +48,8 @@ print("Completed Preprocessing, displaying gif")
 try:
     print("Press CTRL-C to stop.")
 
-    # Infinitely loop through the gif
-    cur_frame = 0
+    player.Start()
     while(True):
-        matrix.SwapOnVSync(canvases[cur_frame], framerate_fraction=10)
-        if cur_frame == num_frames - 1:
-            cur_frame = 0
-        else:
-            cur_frame += 1
+        time.sleep(100)
 except KeyboardInterrupt:
     sys.exit(0)
@@ -0,0 +1,40 @@
+#!/usr/bin/env python
+# Render a runtext once into a stream file, then play it back from the
+# file without drawing anything in Python.
+from samplebase import SampleBase
+from rgbmatrix import graphics, FileStreamIO, StreamReader, StreamWriter
+
+
+class PrerenderedRunText(SampleBase):
+    def __init__(self, *args, **kwargs):
+        super(PrerenderedRunText, self).__init__(*args, **kwargs)
+        self.parser.add_argument("-t", "--text", help="The text to scroll on the RGB LED panel", default="Hello world!")
+        self.parser.add_argument("-o", "--stream", help="Stream file to create", default="/tmp/runtext.stream")
+
+    def run(self):
+        offscreen_canvas = self.matrix.CreateFrameCanvas()
+        font = graphics.Font()
+        font.LoadFont("../../../fonts/7x13.bdf")
+        textColor = graphics.Color(255, 255, 0)
+
+        # Render one pass of the text, each frame shown for 50ms.
+        writer = StreamWriter(FileStreamIO(self.args.stream, write=True))
+        pos = offscreen_canvas.width
+        while True:
+            offscreen_canvas.Clear()
+            len = graphics.DrawText(offscreen_canvas, font, pos, 10, textColor, self.args.text)
+            writer.Stream(offscreen_canvas, 50000)
+            pos -= 1
+            if (pos + len < 0):
+                break
+        del writer  # Closes the file.
+
+        reader = StreamReader(FileStreamIO(self.args.stream))
+        self.matrix.PlayStream(reader, offscreen_canvas, loops=-1)
+
+
+# Main function
+if __name__ == "__main__":
+    run_text = PrerenderedRunText()
+    if (not run_text.process()):
+        run_text.print_help()
@@ -7,7 +7,14 @@
 
 #include "led-matrix.h"
 #include "graphics.h"
-
+#include "event-loop.h"
+#include "event-loop-curl.h"
+#include "content-streamer.h"
+#include "metrics.h"
+#include "handoff.h"
+
+#include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <signal.h>
 #include <stdio.h>
@@ -19,45 +26,19 @@
 #include <fstream>
 #include <curl/curl.h>
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <map>
-
-#ifndef TIMER_ABSTIME
-#define TIMER_ABSTIME 1
-#endif
-
-#ifdef __APPLE__
-#include <sys/time.h>
-static int clock_nanosleep(clockid_t clock_id, int flags,
-                           const struct timespec *request,
-                           struct timespec *remain) {
-  (void)clock_id;
-  if (flags == TIMER_ABSTIME) {
-    struct timeval now_tv;
-    gettimeofday(&now_tv, NULL);
-    struct timespec now;
-    now.tv_sec = now_tv.tv_sec;
-    now.tv_nsec = now_tv.tv_usec * 1000;
-    struct timespec diff;
-    diff.tv_sec = request->tv_sec - now.tv_sec;
-    diff.tv_nsec = request->tv_nsec - now.tv_nsec;
-    if (diff.tv_nsec < 0) {
-      diff.tv_sec--;
-      diff.tv_nsec += 1000000000;
-    }
-    if (diff.tv_sec < 0) return 0;
-    return nanosleep(&diff, remain);
-  }
-  return nanosleep(request, remain);
-}
-#endif
+#include <memory>
 
 using namespace rgb_matrix;
 
 volatile bool interrupt_received = false;
+static rgb_matrix::EventLoop *event_loop = NULL;
 static void InterruptHandler(int signo) {
   interrupt_received = true;
+  if (event_loop) event_loop->Stop();
 }
 
 // Weather data structure
@@ -160,46 +141,57 @@ static std::string extractJsonValue(const std::string &json, const std::string &
   return value;
 }
 
-// Fetch weather from OpenWeather API
-static WeatherData fetchWeather(const std::string &api_key, double lat, double lon, 
-                                 const std::string &units, const std::string &lang) {
+// What is exported with --metrics.
+struct ClockWeatherMetrics {
+  explicit ClockWeatherMetrics(rgb_matrix::Metrics *m)
+    : fetches(m->AddCounter("clock_weather_fetches_total",
+                            "Weather fetches started.")),
+      fetch_errors(m->AddCounter("clock_weather_fetch_errors_total",
+                                 "Failed transfers or non-200 responses.")),
+      parse_errors(m->AddCounter("clock_weather_parse_errors_total",
+                                 "Responses without a temperature.")),
+      fetch_seconds(m->AddHistogram("clock_weather_fetch_seconds",
+                                    "Duration of weather fetches.",
+                                    {0.1, 0.25, 0.5, 1, 2.5, 5, 10})),
+      weather_age(m->AddGauge("clock_weather_weather_age_seconds",
+                              "Seconds since the last successful fetch.")),
+      frames(m->AddCounter("rgbmatrix_frames_total", "Frames shown.")),
+      missed_ticks(m->AddCounter("clock_weather_missed_ticks_total",
+                                 "Seconds shown late.")),
+      render_seconds(m->AddHistogram("rgbmatrix_frame_render_seconds",
+                                     "Time to draw a frame.",
+                                     {0.0001, 0.00025, 0.0005, 0.001,
+                                      0.0025, 0.005, 0.01, 0.025})),
+      swap_wait_seconds(m->AddHistogram("rgbmatrix_swap_wait_seconds",
+                                        "Time waiting in SwapOnVSync().",
+                                        {0.001, 0.0025, 0.005, 0.01, 0.02,
+                                         0.05, 0.1})),
+      last_success(0) {}
+
+  Counter *const fetches;
+  Counter *const fetch_errors;
+  Counter *const parse_errors;
+  Histogram *const fetch_seconds;
+  Gauge *const weather_age;
+  Counter *const frames;
+  Counter *const missed_ticks;
+  Histogram *const render_seconds;
+  Histogram *const swap_wait_seconds;
+  time_t last_success;
+};
+
+static int64_t NanosSince(const struct timespec &start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start.tv_sec) * 1000000000LL
+    + (now.tv_nsec - start.tv_nsec);
+}
+
+// Parse the OpenWeather API response. Without a temperature, the
+// result is not valid.
+static WeatherData parseWeather(const std::string &response_data) {
   WeatherData weather;
-  
-  CURL *curl = curl_easy_init();
-  if (!curl) {
-    fprintf(stderr, "Failed to initialize curl\n");
-    return weather;
-  }
-  
-  std::string url = "https://api.openweathermap.org/data/2.5/weather";
-  std::stringstream url_params;
-  url_params << url << "?lat=" << lat << "&lon=" << lon 
-             << "&appid=" << api_key << "&units=" << units << "&lang=" << lang;
-  
-  std::string response_data;
-  
-  curl_easy_setopt(curl, CURLOPT_URL, url_params.str().c_str());
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_data);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
-  
-  CURLcode res = curl_easy_perform(curl);
-  
-  if (res != CURLE_OK) {
-    fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
-    curl_easy_cleanup(curl);
-    return weather;
-  }
-  
-  long response_code;
-  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-  curl_easy_cleanup(curl);
-  
-  if (response_code != 200) {
-    fprintf(stderr, "API returned status code: %ld\n", response_code);
-    return weather;
-  }
-  
+
   // Parse JSON response - use nested key notation
   std::string temp_str = extractJsonValue(response_data, "main.temp");
   std::string feels_str = extractJsonValue(response_data, "main.feels_like");
@@ -245,10 +237,82 @@ static WeatherData fetchWeather(const std::string &api_key, double lat, double l
   if (!wind_str.empty()) weather.wind_speed = atof(wind_str.c_str());
   if (!dt_str.empty()) weather.timestamp = (time_t)atol(dt_str.c_str());
   
-  weather.valid = true;
+  weather.valid = !temp_str.empty();
   return weather;
 }
 
+// Fetch weather from OpenWeather API every "refresh_seconds". The transfer
+// runs on the event loop, so the clock keeps ticking while the server takes
+// its time.
+static rgb_matrix::Task updateWeather(rgb_matrix::EventLoop *loop,
+                                      rgb_matrix::CurlMulti *multi,
+                                      const std::string &api_key,
+                                      double lat, double lon,
+                                      const std::string &units,
+                                      const std::string &lang,
+                                      int refresh_seconds,
+                                      WeatherData *current,
+                                      ClockWeatherMetrics *metrics) {
+  std::unique_ptr<CURL, void (*)(CURL*)> curl(curl_easy_init(),
+                                               curl_easy_cleanup);
+  if (!curl) {
+    fprintf(stderr, "Failed to initialize curl\n");
+    co_return;
+  }
+  
+  std::string url = "https://api.openweathermap.org/data/2.5/weather";
+  std::stringstream url_params;
+  url_params << url << "?lat=" << lat << "&lon=" << lon 
+             << "&appid=" << api_key << "&units=" << units << "&lang=" << lang;
+  
+  std::string response_data;
+  
+  curl_easy_setopt(curl.get(), CURLOPT_URL, url_params.str().c_str());
+  curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, WriteCallback);
+  curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &response_data);
+  curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT, 10L);
+
+  struct timespec next_fetch;
+  clock_gettime(CLOCK_MONOTONIC, &next_fetch);
+  if (current->valid && metrics->last_success) {
+    // Taken over from a predecessor: its data is good until due.
+    next_fetch.tv_sec += std::max<time_t>(
+      0, metrics->last_success + refresh_seconds - time(NULL));
+    co_await loop->SleepUntil(CLOCK_MONOTONIC, next_fetch);
+  }
+  for (;;) {
+    response_data.clear();
+    metrics->fetches->Increment();
+    CURLcode res = co_await multi->Perform(curl.get());
+    curl_off_t fetch_us = 0;
+    curl_easy_getinfo(curl.get(), CURLINFO_TOTAL_TIME_T, &fetch_us);
+    metrics->fetch_seconds->ObserveNanos(fetch_us * 1000);
+
+    long response_code = 0;
+    if (res != CURLE_OK) {
+      fprintf(stderr, "curl transfer failed: %s\n", curl_easy_strerror(res));
+    } else {
+      curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &response_code);
+      if (response_code != 200) {
+        fprintf(stderr, "API returned status code: %ld\n", response_code);
+      }
+    }
+    *current = (response_code == 200)
+      ? parseWeather(response_data) : WeatherData();
+    if (response_code != 200) {
+      metrics->fetch_errors->Increment();
+    } else if (!current->valid) {
+      fprintf(stderr, "Could not parse weather response\n");
+      metrics->parse_errors->Increment();
+    } else {
+      metrics->last_success = time(NULL);
+    }
+
+    next_fetch.tv_sec += refresh_seconds;
+    co_await loop->SleepUntil(CLOCK_MONOTONIC, next_fetch);
+  }
+}
+
 // Load environment variables from .env file or system env
 static void loadEnv(std::map<std::string, std::string> &env_map) {
   // Try to read .env file first
@@ -282,6 +346,35 @@ static void loadEnv(std::map<std::string, std::string> &env_map) {
   if (lang) env_map["WEATHER_LANG"] = lang;
 }
 
+// Weather data passed on to the next version in a --handoff.
+static std::string SaveWeather(const WeatherData &w, time_t fetched) {
+  std::stringstream out;
+  out << "weather1\n" << fetched << ' ' << w.valid << ' ' << w.temp << ' '
+      << w.feels_like << ' ' << w.humidity << ' ' << w.wind_speed << ' '
+      << w.timestamp << '\n' << w.condition_main << '\n'
+      << w.condition_description << '\n';
+  return out.str();
+}
+
+static bool RestoreWeather(const std::string &state, WeatherData *w,
+                           time_t *fetched) {
+  std::stringstream in(state);
+  std::string version;
+  WeatherData result;
+  time_t fetched_at;
+  if (!std::getline(in, version) || version != "weather1") return false;
+  in >> fetched_at >> result.valid >> result.temp >> result.feels_like
+     >> result.humidity >> result.wind_speed >> result.timestamp;
+  in.ignore(1);
+  if (!in || !std::getline(in, result.condition_main)
+      || !std::getline(in, result.condition_description)) {
+    return false;
+  }
+  *w = result;
+  *fetched = fetched_at;
+  return true;
+}
+
 static int usage(const char *progname) {
   fprintf(stderr, "usage: %s [options]\n", progname);
   fprintf(stderr, "Displays clock and current weather on RGB matrix.\n");
@@ -299,6 +392,17 @@ static int usage(const char *progname) {
           "\t-O <r,g,b>        : Outline-Color, e.g. to increase contrast.\n"
           "\t--weather-refresh <sec> : Weather refresh interval (Default: 600)\n"
           "\t--units <unit>    : Temperature units: metric, imperial, standard (Default: imperial)\n"
+          "\t--lazy-font <max> : Only load glyphs of the font when needed, keep\n"
+          "\t                    at most <max> of them (0: no limit). For large fonts.\n"
+          "\t--record <file>   : Don't fetch weather or show anything; write\n"
+          "\t                    frames with sample data to stream-file.\n"
+          "\t--frames <count>  : Number of frames to record (Default: 100).\n"
+          "\t--metrics <addr>  : Serve Prometheus metrics at http://<addr>/metrics\n"
+          "\t                    <addr>: [host:]port or unix:<socket-path>\n"
+          "\t--handoff <socket> : Take the panel over from a running instance\n"
+          "\t                    listening on this Unix socket, then listen\n"
+          "\t                    there for the next one. For upgrades without\n"
+          "\t                    the panel going dark.\n"
           "\n"
           );
   rgb_matrix::PrintMatrixFlags(stderr);
@@ -309,6 +413,35 @@ static bool parseColor(Color *c, const char *str) {
   return sscanf(str, "%hhu,%hhu,%hhu", &c->r, &c->g, &c->b) == 3;
 }
 
+// Draw a line of text, with an outline if "outline_color" is set.
+// If "lazy_font" is set, it is used instead of "font" and loads the glyphs
+// needed for this text first. Text that changes every time is drawn with
+// "cache_run" false, as the cache would only miss.
+static void DrawTextLine(rgb_matrix::TextRunCache *cache, Canvas *c,
+                         const rgb_matrix::Font &regular_font,
+                         rgb_matrix::LazyFont *lazy_font, int x, int y,
+                         const Color &color, const Color *outline_color,
+                         const char *text, int letter_spacing,
+                         bool cache_run) {
+  if (lazy_font && lazy_font->Prepare(text)) {
+    cache->Clear();  // The font got replaced.
+  }
+  const rgb_matrix::Font &font = lazy_font ? lazy_font->font() : regular_font;
+  if (!cache_run) {
+    if (outline_color) {
+      rgb_matrix::DrawTextOutlined(c, font, x, y, color, *outline_color,
+                                   text, letter_spacing);
+    } else {
+      rgb_matrix::DrawText(c, font, x, y, color, NULL, text, letter_spacing);
+    }
+  } else if (outline_color) {
+    cache->DrawTextOutlined(c, font, x, y, color, *outline_color,
+                            text, letter_spacing);
+  } else {
+    cache->DrawText(c, font, x, y, color, NULL, text, letter_spacing);
+  }
+}
+
 static bool FullSaturation(const Color &c) {
   return (c.r == 0 || c.r == 255)
     && (c.g == 0 || c.g == 255)
@@ -337,16 +470,26 @@ int main(int argc, char *argv[]) {
   int line_spacing = 2;
   int weather_refresh = 600;  // 10 minutes default
   std::string units = "imperial";
+  int lazy_font_max_glyphs = -1;  // -1: load full font.
+  const char *record_file = NULL;
+  int record_frames = 100;
+  const char *metrics_address = NULL;
+  const char *handoff_socket = NULL;
 
   int opt;
   int option_index = 0;
   static struct option long_options[] = {
     {"weather-refresh", required_argument, 0, 'r'},
     {"units", required_argument, 0, 'u'},
+    {"lazy-font", required_argument, 0, 'L'},
+    {"record", required_argument, 0, 'R'},
+    {"frames", required_argument, 0, 'n'},
+    {"metrics", required_argument, 0, 'M'},
+    {"handoff", required_argument, 0, 'H'},
     {0, 0, 0, 0}
   };
 
-  while ((opt = getopt_long(argc, argv, "x:y:f:C:W:B:O:s:S:d:r:u:", long_options, &option_index)) != -1) {
+  while ((opt = getopt_long(argc, argv, "x:y:f:C:W:B:O:s:S:d:r:u:L:", long_options, &option_index)) != -1) {
     switch (opt) {
     case 'd': format_lines.push_back(optarg); break;
     case 'x': x_orig = atoi(optarg); break;
@@ -381,6 +524,11 @@ int main(int argc, char *argv[]) {
       break;
     case 'r': weather_refresh = atoi(optarg); break;
     case 'u': units = optarg; break;
+    case 'L': lazy_font_max_glyphs = atoi(optarg); break;
+    case 'R': record_file = strdup(optarg); break;
+    case 'n': record_frames = atoi(optarg); break;
+    case 'M': metrics_address = strdup(optarg); break;
+    case 'H': handoff_socket = strdup(optarg); break;
     default:
       return usage(argv[0]);
     }
@@ -404,7 +552,8 @@ int main(int argc, char *argv[]) {
   std::string lon_str = env_map["WEATHER_LON"];
   std::string lang = env_map.count("WEATHER_LANG") ? env_map["WEATHER_LANG"] : "en";
   
-  if (api_key.empty() || lat_str.empty() || lon_str.empty()) {
+  if (!record_file
+      && (api_key.empty() || lat_str.empty() || lon_str.empty())) {
     fprintf(stderr, "Missing required environment variables: WEATHER_API_KEY, WEATHER_LAT, WEATHER_LON\n");
     fprintf(stderr, "Set them in .env file or environment\n");
     return 1;
@@ -420,22 +569,80 @@ int main(int argc, char *argv[]) {
    * Load font. This needs to be a filename with a bdf bitmap font.
    */
   rgb_matrix::Font font;
-  if (!font.LoadFont(bdf_font_file)) {
+  rgb_matrix::LazyFont *lazy_font = NULL;
+  if (lazy_font_max_glyphs >= 0) {
+    lazy_font = new rgb_matrix::LazyFont(lazy_font_max_glyphs);
+    if (!lazy_font->Open(bdf_font_file)) {
+      fprintf(stderr, "Couldn't load font '%s'\n", bdf_font_file);
+      curl_global_cleanup();
+      return 1;
+    }
+  } else if (!font.LoadFont(bdf_font_file)) {
     fprintf(stderr, "Couldn't load font '%s'\n", bdf_font_file);
     curl_global_cleanup();
     return 1;
   }
-  rgb_matrix::Font *outline_font = NULL;
-  if (with_outline) {
-    outline_font = font.CreateOutlineFont();
+  const rgb_matrix::Font &layout_font = lazy_font ? lazy_font->font() : font;
+  const int font_baseline = layout_font.baseline();
+  const int font_height = layout_font.height();
+
+  // The weather lines stay the same for minutes, so keep them laid out.
+  rgb_matrix::TextRunCache text_cache;
+
+  rgb_matrix::Metrics metrics;
+  ClockWeatherMetrics stats(&metrics);
+  WeatherData current_weather;
+
+  // A running instance keeps the panel lit until we are ready for it.
+  rgb_matrix::HandoffClient handoff;
+  const bool take_over = handoff_socket && !record_file
+    && handoff.Receive(handoff_socket, 1000);
+  if (take_over) {
+    RestoreWeather(handoff.app_state(), &current_weather,
+                   &stats.last_success);
+    if (!handoff.Release(5000)) {
+      fprintf(stderr, "Previous instance on %s did not exit\n",
+              handoff_socket);
+      curl_global_cleanup();
+      return 1;
+    }
   }
 
+  runtime_opt.do_gpio_init = (record_file == NULL);
   RGBMatrix *matrix = RGBMatrix::CreateFromOptions(matrix_options, runtime_opt);
   if (matrix == NULL) {
     curl_global_cleanup();
     return 1;
   }
 
+  // The frame the panel shows; handed over to the next instance.
+  FrameCanvas *shown = NULL;
+  FrameCanvas *offscreen = matrix->CreateFrameCanvas();
+  if (take_over && handoff.Restore(offscreen)) {
+    shown = offscreen;
+    offscreen = matrix->SwapOnVSync(offscreen);
+    fprintf(stderr, "Took over the panel; it was dark for %.2fms\n",
+            handoff.NanosSinceRelease() / 1e6);
+  }
+
+  // After creating the matrix, which might have forked into a daemon.
+  if (metrics_address && !record_file && !metrics.Serve(metrics_address)) {
+    fprintf(stderr, "Can't serve metrics on %s: %s\n", metrics_address,
+            strerror(errno));
+    delete matrix;
+    curl_global_cleanup();
+    return 1;
+  }
+  rgb_matrix::HandoffServer handoff_server;
+  if (handoff_socket && !record_file
+      && !handoff_server.Listen(handoff_socket)) {
+    fprintf(stderr, "Can't listen for handoff on %s: %s\n", handoff_socket,
+            strerror(errno));
+    delete matrix;
+    curl_global_cleanup();
+    return 1;
+  }
+
   const bool all_extreme_colors = (matrix_options.brightness == 100)
     && FullSaturation(clock_color)
     && FullSaturation(weather_color)
@@ -447,114 +654,174 @@ int main(int argc, char *argv[]) {
   const int x = x_orig;
   int y = y_orig;
 
-  FrameCanvas *offscreen = matrix->CreateFrameCanvas();
-
   char text_buffer[256];
   char weather_buffer[128];
-  struct timespec next_time;
-  next_time.tv_sec = time(NULL);
-  next_time.tv_nsec = 0;
-  struct tm tm;
-  
-  time_t last_weather_fetch = 0;
-  WeatherData current_weather;
 
-  signal(SIGTERM, InterruptHandler);
-  signal(SIGINT, InterruptHandler);
-
-  while (!interrupt_received) {
-    offscreen->Fill(bg_color.r, bg_color.g, bg_color.b);
-    localtime_r(&next_time.tv_sec, &tm);
-
-    // Fetch weather if needed
-    if (next_time.tv_sec - last_weather_fetch >= weather_refresh) {
-      current_weather = fetchWeather(api_key, lat, lon, units, lang);
-      last_weather_fetch = next_time.tv_sec;
-    }
+  // Draw the display for time "t" into "canvas".
+  auto draw_frame = [&](FrameCanvas *canvas, time_t t,
+                        const WeatherData &weather) {
+    struct tm tm;
+    canvas->Fill(bg_color.r, bg_color.g, bg_color.b);
+    localtime_r(&t, &tm);
 
     int line_offset = 0;
-    
-    // Draw clock line(s)
+  
+    // Draw clock line(s). They change with the time, so they aren't cached.
     for (const std::string &line : format_lines) {
       strftime(text_buffer, sizeof(text_buffer), line.c_str(), &tm);
-      if (outline_font) {
-        rgb_matrix::DrawText(offscreen, *outline_font,
-                             x - 1, y + font.baseline() + line_offset,
-                             outline_color, NULL, text_buffer,
-                             letter_spacing - 2);
-      }
-      rgb_matrix::DrawText(offscreen, font,
-                           x, y + font.baseline() + line_offset,
-                           clock_color, NULL, text_buffer,
-                           letter_spacing);
-      line_offset += font.height() + line_spacing;
+      DrawTextLine(&text_cache, canvas, font, lazy_font,
+                   x, y + font_baseline + line_offset,
+                   clock_color, with_outline ? &outline_color : NULL,
+                   text_buffer, letter_spacing, false);
+      line_offset += font_height + line_spacing;
     }
-    
+  
     // Draw weather line
-    if (current_weather.valid) {
+    if (weather.valid) {
       char temp_unit = (units == "imperial") ? 'F' : 'C';
       const char *wind_unit = (units == "imperial") ? "mph" : "m/s";
-      
+    
       // First line: temp and condition
       snprintf(weather_buffer, sizeof(weather_buffer), "%.0f%c %s",
-               current_weather.feels_like, temp_unit, 
-               current_weather.condition_main.c_str());
-      
-      if (outline_font) {
-        rgb_matrix::DrawText(offscreen, *outline_font,
-                             x - 1, y + font.baseline() + line_offset,
-                             outline_color, NULL, weather_buffer,
-                             letter_spacing - 2);
-      }
-      rgb_matrix::DrawText(offscreen, font,
-                           x, y + font.baseline() + line_offset,
-                           weather_color, NULL, weather_buffer,
-                           letter_spacing);
-      
-      line_offset += font.height() + line_spacing;
-      
+               weather.feels_like, temp_unit, 
+               weather.condition_main.c_str());
+    
+      DrawTextLine(&text_cache, canvas, font, lazy_font,
+                   x, y + font_baseline + line_offset,
+                   weather_color, with_outline ? &outline_color : NULL,
+                   weather_buffer, letter_spacing, true);
+    
+      line_offset += font_height + line_spacing;
+    
       // Second line: humidity and wind speed
       snprintf(weather_buffer, sizeof(weather_buffer), "H:%.0f%% W:%.0f%s",
-               current_weather.humidity, 
-               current_weather.wind_speed, wind_unit);
-      
-      if (outline_font) {
-        rgb_matrix::DrawText(offscreen, *outline_font,
-                             x - 1, y + font.baseline() + line_offset,
-                             outline_color, NULL, weather_buffer,
-                             letter_spacing - 2);
-      }
-      rgb_matrix::DrawText(offscreen, font,
-                           x, y + font.baseline() + line_offset,
-                           weather_color, NULL, weather_buffer,
-                           letter_spacing);
+               weather.humidity, 
+               weather.wind_speed, wind_unit);
+    
+      DrawTextLine(&text_cache, canvas, font, lazy_font,
+                   x, y + font_baseline + line_offset,
+                   weather_color, with_outline ? &outline_color : NULL,
+                   weather_buffer, letter_spacing, true);
     } else {
       // Show error or loading state
       const char *status = "Loading...";
-      if (outline_font) {
-        rgb_matrix::DrawText(offscreen, *outline_font,
-                             x - 1, y + font.baseline() + line_offset,
-                             outline_color, NULL, status,
-                             letter_spacing - 2);
-      }
-      rgb_matrix::DrawText(offscreen, font,
-                           x, y + font.baseline() + line_offset,
-                           weather_color, NULL, status,
-                           letter_spacing);
+      DrawTextLine(&text_cache, canvas, font, lazy_font,
+                   x, y + font_baseline + line_offset,
+                   weather_color, with_outline ? &outline_color : NULL,
+                   status, letter_spacing, true);
     }
+  };
 
-    // Wait until we're ready to show it.
-    clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &next_time, NULL);
+  if (record_file) {
+    // Layout check (see ../golden-test): sample weather and a fixed time.
+    int fd = open(record_file, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+    if (fd < 0) {
+      perror("Couldn't open output stream");
+      return 1;
+    }
+    rgb_matrix::FileStreamIO record_io(fd);
+    rgb_matrix::StreamWriter recorder(&record_io);
+    WeatherData sample;
+    sample.temp = 71.6;
+    sample.feels_like = 72.4;
+    sample.humidity = 40;
+    sample.wind_speed = 5.2;
+    sample.condition_main = "Clouds";
+    sample.valid = true;
+    const WeatherData loading;
+    int64_t render_ns = 0;
+    for (int i = 0; i < record_frames; ++i) {
+      struct timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      draw_frame(offscreen, 1700000000 + i, i == 0 ? loading : sample);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      render_ns += (end.tv_sec - start.tv_sec) * 1000000000LL
+        + (end.tv_nsec - start.tv_nsec);
+      recorder.Stream(*offscreen, 1000000);
+    }
+    fprintf(stderr, "Recorded %d frames to %s; render time %.3fms\n",
+            record_frames, record_file, render_ns / 1e6);
+    delete matrix;
+    delete lazy_font;
+    curl_global_cleanup();
+    return 0;
+  }
 
-    // Atomic swap with double buffer
-    offscreen = matrix->SwapOnVSync(offscreen);
+  // Nothing in here blocks: fetching the weather and waiting for the next
+  // second or the vsync all happen on the event loop.
+  rgb_matrix::EventLoop *loop = new rgb_matrix::EventLoop();
+  rgb_matrix::CurlMulti *curl_multi = new rgb_matrix::CurlMulti(loop);
+  event_loop = loop;
 
-    next_time.tv_sec += 1;
-  }
+  signal(SIGTERM, InterruptHandler);
+  signal(SIGINT, InterruptHandler);
+
+  updateWeather(loop, curl_multi, api_key, lat, lon, units, lang,
+                weather_refresh, &current_weather, &stats);
+
+  // Coroutine lambda: all locals of main() outlive the event loop.
+  auto render_clock = [&]() -> rgb_matrix::Task {
+    struct timespec next_time;
+    next_time.tv_sec = time(NULL);
+    next_time.tv_nsec = 0;
+
+    while (!interrupt_received) {
+      struct timespec start;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      draw_frame(offscreen, next_time.tv_sec, current_weather);
+      stats.render_seconds->ObserveNanos(NanosSince(start));
+
+      // Wait until we're ready to show it.
+      co_await loop->SleepUntil(CLOCK_REALTIME, next_time);
+      const time_t now = time(NULL);
+      if (now > next_time.tv_sec) {
+        // Too late for this second; show the current one instead.
+        stats.missed_ticks->Increment(now - next_time.tv_sec);
+        next_time.tv_sec = now;
+        continue;
+      }
+      if (stats.last_success) {
+        stats.weather_age->Set(now - stats.last_success);
+      }
+
+      // Atomic swap with double buffer
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      FrameCanvas *next = offscreen;
+      offscreen = co_await loop->SwapOnVSync(matrix, offscreen);
+      shown = next;
+      stats.swap_wait_seconds->ObserveNanos(NanosSince(start));
+      stats.frames->Increment();
+
+      next_time.tv_sec += 1;
+    }
+  };
+  render_clock();
+
+  // A new instance connected: give it the panel. Doesn't return if the
+  // handoff succeeds.
+  auto serve_handoff = [&]() -> rgb_matrix::Task {
+    while (shown == NULL)
+      co_await loop->SleepFor(100 * 1000000LL);
+    while (!interrupt_received) {
+      co_await loop->Readable(handoff_server.fd());
+      if (!handoff_server.HandOver(shown, SaveWeather(current_weather,
+                                                      stats.last_success))) {
+        fprintf(stderr, "Handoff to new instance failed\n");
+      }
+    }
+  };
+  if (handoff_server.fd() >= 0) serve_handoff();
+
+  loop->Run();
+
+  // Finished. The loop might still be waiting for a swap, so goes first.
+  event_loop = NULL;
+  delete curl_multi;
+  delete loop;
 
-  // Finished. Shut down the RGB matrix.
+  // Shut down the RGB matrix.
   delete matrix;
-  if (outline_font) delete outline_font;
+  delete lazy_font;
   curl_global_cleanup();
 
   std::cout << std::endl;  // Create a fresh new line after ^C on screen
@@ -7,10 +7,15 @@
 // This is a grab-bag of various demos and not very readable.
 #include "led-matrix.h"
 
+#include "content-streamer.h"
 #include "pixel-mapper.h"
 #include "graphics.h"
+#include "rgb-buffer.h"
+#include "sprite.h"
+#include "transitions.h"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <limits.h>
 #include <math.h>
@@ -18,9 +23,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <vector>
 
 using std::min;
 using std::max;
@@ -35,6 +42,49 @@ static void InterruptHandler(int signo) {
   interrupt_received = true;
 }
 
+// Seed for the demos that use rand(). Fixed when recording, so that the
+// output can be compared between runs.
+static unsigned int random_seed = 0;
+
+// With --record, frames are written to a stream instead of being shown
+// (see ../golden-test).
+static rgb_matrix::StreamWriter *frame_recorder = NULL;
+static int frames_to_record = 0;
+static int64_t record_render_ns = 0;
+static struct timespec record_frame_start;
+
+static int64_t NanosSince(const struct timespec &start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start.tv_sec) * 1000000000LL
+    + (now.tv_nsec - start.tv_nsec);
+}
+
+// Called by the demos when a frame is complete instead of sleeping.
+// When recording, writes the frame and stops the demo after enough frames.
+static void FrameDone(const Canvas *frame, int64_t delay_us) {
+  if (frame_recorder == NULL) {
+    usleep(delay_us);
+    return;
+  }
+  record_render_ns += NanosSince(record_frame_start);
+  const FrameCanvas *recorded = dynamic_cast<const FrameCanvas*>(frame);
+  if (recorded) {
+    frame_recorder->Stream(*recorded, delay_us);
+  }
+  if (--frames_to_record <= 0) interrupt_received = true;
+  clock_gettime(CLOCK_MONOTONIC, &record_frame_start);
+}
+
+// Same for double-buffering demos: returns the canvas to draw the next
+// frame on. There is nothing to swap with when recording.
+static FrameCanvas *SwapFrame(RGBMatrix *matrix, FrameCanvas *frame,
+                              int64_t delay_us) {
+  FrameDone(frame, delay_us);
+  if (frame_recorder) return frame;
+  return matrix->SwapOnVSync(frame);
+}
+
 class DemoRunner {
 protected:
   DemoRunner(Canvas *canvas) : canvas_(canvas) {}
@@ -62,7 +112,6 @@ public:
   void Run() override {
     uint32_t continuum = 0;
     while (!interrupt_received) {
-      usleep(5 * 1000);
       continuum += 1;
       continuum %= 3 * 255;
       int r = 0, g = 0, b = 0;
@@ -80,7 +129,7 @@ public:
         b = c;
       }
       off_screen_canvas_->Fill(r, g, b);
-      off_screen_canvas_ = matrix_->SwapOnVSync(off_screen_canvas_);
+      off_screen_canvas_ = SwapFrame(matrix_, off_screen_canvas_, 5 * 1000);
     }
   }
 
@@ -93,33 +142,103 @@ private:
 class BrightnessPulseGenerator : public DemoRunner {
 public:
   BrightnessPulseGenerator(RGBMatrix *m)
-    : DemoRunner(m), matrix_(m) {}
+    : DemoRunner(m), matrix_(m), recorded_canvas_(NULL) {
+    if (frame_recorder) recorded_canvas_ = m->CreateFrameCanvas();
+  }
   void Run() override {
     const uint8_t max_brightness = matrix_->brightness();
     const uint8_t c = 255;
+    uint8_t brightness = max_brightness;
     uint8_t count = 0;
 
     while (!interrupt_received) {
-      if (matrix_->brightness() < 1) {
-        matrix_->SetBrightness(max_brightness);
+      if (brightness < 1) {
+        brightness = max_brightness;
         count++;
       } else {
-        matrix_->SetBrightness(matrix_->brightness() - 1);
+        brightness--;
       }
 
+      // The whole matrix pulses; a recording only sees the brightness of
+      // the frame, so it gets a frame of its own.
+      Canvas *target = matrix_;
+      if (recorded_canvas_) {
+        recorded_canvas_->SetBrightness(brightness);
+        target = recorded_canvas_;
+      } else {
+        matrix_->SetBrightness(brightness);
+      }
       switch (count % 4) {
-      case 0: matrix_->Fill(c, 0, 0); break;
-      case 1: matrix_->Fill(0, c, 0); break;
-      case 2: matrix_->Fill(0, 0, c); break;
-      case 3: matrix_->Fill(c, c, c); break;
+      case 0: target->Fill(c, 0, 0); break;
+      case 1: target->Fill(0, c, 0); break;
+      case 2: target->Fill(0, 0, c); break;
+      case 3: target->Fill(c, c, c); break;
+      }
+
+      FrameDone(target, 20 * 1000);
+    }
+  }
+
+private:
+  RGBMatrix *const matrix_;
+  FrameCanvas *recorded_canvas_;
+};
+
+// Goes through all transitions between three screens.
+class TransitionDemo : public DemoRunner {
+public:
+  TransitionDemo(RGBMatrix *m) : DemoRunner(m), matrix_(m) {
+    off_screen_canvas_ = m->CreateFrameCanvas();
+    const int width = m->width(), height = m->height();
+    for (int i = 0; i < 3; ++i)
+      screens_[i] = new RGBBuffer(width, height);
+
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        screens_[0]->SetPixel(x, y, 255 * x / width, 255 * y / height, 128);
       }
+    }
+
+    static const Color kBars[] = {
+      Color(255, 255, 255), Color(255, 255, 0), Color(0, 255, 255),
+      Color(0, 255, 0), Color(255, 0, 255), Color(255, 0, 0), Color(0, 0, 255)
+    };
+    for (int x = 0; x < width; ++x) {
+      const Color &c = kBars[x * 7 / width];
+      DrawLine(screens_[1], x, 0, x, height - 1, c);
+    }
+
+    for (int r = 2; r < width; r += 4) {
+      DrawCircle(screens_[2], width / 2, height / 2, r,
+                 Color(255 - 4 * r % 256, 64, 4 * r % 256));
+    }
+  }
+
+  ~TransitionDemo() override {
+    for (int i = 0; i < 3; ++i) delete screens_[i];
+  }
 
-      usleep(20 * 1000);
+  void Run() override {
+    const int kTransitionFrames = 60;
+    const int kHoldFrames = 30;
+    const int64_t kFrameUs = 1000000 / 60;
+    for (int i = 0; !interrupt_received; ++i) {
+      const Transition::Type type
+        = (Transition::Type)(i % (Transition::DISSOLVE + 1));
+      Transition transition(type, *screens_[i % 3], *screens_[(i + 1) % 3]);
+      for (int f = 1; f <= kTransitionFrames + kHoldFrames; ++f) {
+        if (interrupt_received) return;
+        transition.Render(min(1.0f, (float)f / kTransitionFrames),
+                          off_screen_canvas_);
+        off_screen_canvas_ = SwapFrame(matrix_, off_screen_canvas_, kFrameUs);
+      }
     }
   }
 
 private:
   RGBMatrix *const matrix_;
+  FrameCanvas *off_screen_canvas_;
+  RGBBuffer *screens_[3];
 };
 
 class SimpleSquare : public DemoRunner {
@@ -137,6 +256,7 @@ public:
     // Diagonals.
     DrawLine(canvas(), 0, 0,        width, height, Color(255, 255, 255));
     DrawLine(canvas(), 0, height, width, 0,        Color(255,   0, 255));
+    FrameDone(canvas(), 0);
   }
 };
 
@@ -163,7 +283,7 @@ public:
         }
       }
       count++;
-      sleep(2);
+      FrameDone(canvas(), 2 * 1000 * 1000);
     }
   }
 };
@@ -187,46 +307,36 @@ public:
     // whole area, even if diagonal. Thus, when rotating, the outer pixels from
     // the previous frame are cleared.
     const int rotate_square = min(canvas()->width(), canvas()->height()) * 1.41;
-    const int min_rotate = cent_x - rotate_square / 2;
-    const int max_rotate = cent_x + rotate_square / 2;
 
     // The square to display is within the visible area.
     const int display_square = min(canvas()->width(), canvas()->height()) * 0.7;
-    const int min_display = cent_x - display_square / 2;
-    const int max_display = cent_x + display_square / 2;
+    const int min_display = (rotate_square - display_square) / 2;
+    const int max_display = min_display + display_square;
+
+    std::vector<uint8_t> pixels(3 * rotate_square * rotate_square, 0);
+    for (int y = min_display; y < max_display; ++y) {
+      for (int x = min_display; x < max_display; ++x) {
+        uint8_t *pixel = &pixels[3 * (y * rotate_square + x)];
+        pixel[0] = scale_col(x, min_display, max_display);
+        pixel[1] = 255 - scale_col(y, min_display, max_display);
+        pixel[2] = scale_col(y, min_display, max_display);
+      }
+    }
+    const Sprite block(pixels.data(), rotate_square, rotate_square);
 
     const float deg_to_rad = 2 * 3.14159265 / 360;
     int rotation = 0;
     while (!interrupt_received) {
       ++rotation;
-      usleep(15 * 1000);
       rotation %= 360;
-      for (int x = min_rotate; x < max_rotate; ++x) {
-        for (int y = min_rotate; y < max_rotate; ++y) {
-          float rot_x, rot_y;
-          Rotate(x - cent_x, y - cent_x,
-                 deg_to_rad * rotation, &rot_x, &rot_y);
-          if (x >= min_display && x < max_display &&
-              y >= min_display && y < max_display) { // within display square
-            canvas()->SetPixel(rot_x + cent_x, rot_y + cent_y,
-                               scale_col(x, min_display, max_display),
-                               255 - scale_col(y, min_display, max_display),
-                               scale_col(y, min_display, max_display));
-          } else {
-            // black frame.
-            canvas()->SetPixel(rot_x + cent_x, rot_y + cent_y, 0, 0, 0);
-          }
-        }
-      }
+      AffineTransform transform;
+      transform.Translate(-rotate_square / 2.0f, -rotate_square / 2.0f)
+        .Rotate(deg_to_rad * rotation)
+        .Translate(cent_x, cent_y);
+      DrawSprite(canvas(), block, transform, SAMPLE_NEAREST);
+      FrameDone(canvas(), 15 * 1000);
     }
   }
-
-private:
-  void Rotate(int x, int y, float angle,
-              float *new_x, float *new_y) {
-    *new_x = x * cosf(angle) - y * sinf(angle);
-    *new_y = x * sinf(angle) + y * cosf(angle);
-  }
 };
 
 class ImageScroller : public DemoRunner {
@@ -310,14 +420,14 @@ public:
           offscreen_->SetPixel(x, y, p.red, p.green, p.blue);
         }
       }
-      offscreen_ = matrix_->SwapOnVSync(offscreen_);
+      offscreen_ = SwapFrame(matrix_, offscreen_,
+                             std::max(scroll_ms_, 0) * 1000);
       horizontal_position_ += scroll_jumps_;
       if (horizontal_position_ < 0) horizontal_position_ = current_image_.width;
       if (scroll_ms_ <= 0) {
         // No scrolling. We don't need the image anymore.
         current_image_.Delete();
-      } else {
-        usleep(scroll_ms_ * 1000);
+        if (frame_recorder) return;  // Nothing more to record.
       }
     }
   }
@@ -393,7 +503,7 @@ public:
     }
 
     // Init values
-    srand(time(NULL));
+    srand(random_seed);
     for (int x=0; x<width_; ++x) {
       for (int y=0; y<height_; ++y) {
         values_[x][y] = 0;
@@ -438,7 +548,7 @@ public:
           }
         }
       }
-      usleep(delay_ms_ * 1000); // ms
+      FrameDone(canvas(), delay_ms_ * 1000);
     }
   }
 
@@ -504,7 +614,7 @@ public:
     }
 
     // Init values randomly
-    srand(time(NULL));
+    srand(random_seed);
     for (int x=0; x<width_; ++x) {
       for (int y=0; y<height_; ++y) {
         values_[x][y]=rand()%2;
@@ -554,7 +664,7 @@ public:
             canvas()->SetPixel(x, y, 0, 0, 0);
         }
       }
-      usleep(delay_ms_ * 1000); // ms
+      FrameDone(canvas(), delay_ms_ * 1000);
     }
   }
 
@@ -705,7 +815,7 @@ public:
       if (antX_ < 0 || antX_ >= width_ || antY_ < 0 || antY_ >= height_)
         return;
       updatePixel(antX_, antY_);
-      usleep(delay_ms_ * 1000);
+      FrameDone(canvas(), delay_ms_ * 1000);
     }
   }
 
@@ -776,7 +886,7 @@ public:
       means[i] = height_ - means[i]*height_/8;
     }
     // Initialize bar means randomly
-    srand(time(NULL));
+    srand(random_seed);
     for (int i=0; i<numBars_; ++i) {
       barMeans_[i] = rand()%numMeans;
       barFreqs_[i] = 1<<(rand()%3);
@@ -825,7 +935,7 @@ public:
           drawBarRow(i, y, 0, 0, 0);
         }
       }
-      usleep(delay_ms_ * 1000);
+      FrameDone(canvas(), delay_ms_ * 1000);
     }
   }
 
@@ -864,7 +974,7 @@ public:
     // Allocate memory
     children_ = new citizen[popSize_];
     parents_ = new citizen[popSize_];
-    srand(time(NULL));
+    srand(random_seed);
   }
 
   ~GeneticColors() {
@@ -907,7 +1017,7 @@ public:
           mutate(children_[i]);
         }
       }
-      usleep(delay_ms_ * 1000);
+      FrameDone(canvas(), delay_ms_ * 1000);
     }
   }
 
@@ -1032,6 +1142,14 @@ static int usage(const char *progname) {
   fprintf(stderr, "Options:\n");
   fprintf(stderr,
           "\t-D <demo-nr>              : Always needs to be set\n"
+          "\t--record=<streamfile>     : Write frames to stream-file instead "
+          "of matrix\n"
+          "\t                            (Don't need to be root).\n"
+          "\t--frames=<count>          : Number of frames to record "
+          "(Default: 100).\n"
+          "\t--seed=<seed>             : Seed for random demos. Default: "
+          "current time,\n"
+          "\t                            or 0 when recording.\n"
           );
 
 
@@ -1049,7 +1167,8 @@ static int usage(const char *progname) {
           "\t8  - Langton's ant (-m <time-step-ms>)\n"
           "\t9  - Volume bars (-m <time-step-ms>)\n"
           "\t10 - Evolution of color (-m <time-step-ms>)\n"
-          "\t11 - Brightness pulse generator\n");
+          "\t11 - Brightness pulse generator\n"
+          "\t12 - Transitions between screens\n");
   fprintf(stderr, "Example:\n\t%s -D 1 runtext.ppm\n"
           "Scrolls the runtext until Ctrl-C is pressed\n", progname);
   return 1;
@@ -1058,6 +1177,9 @@ static int usage(const char *progname) {
 int main(int argc, char *argv[]) {
   int demo = -1;
   int scroll_ms = 30;
+  const char *record_file = NULL;
+  int record_frames = 100;
+  bool seed_given = false;
 
   const char *demo_parameter = NULL;
   RGBMatrix::Options matrix_options;
@@ -1074,13 +1196,34 @@ int main(int argc, char *argv[]) {
     return usage(argv[0]);
   }
 
+  static struct option long_options[] = {
+    {"record", required_argument, 0, 'O'},
+    {"frames", required_argument, 0, 'n'},
+    {"seed", required_argument, 0, 'S'},
+    {0, 0, 0, 0}
+  };
+
   int opt;
-  while ((opt = getopt(argc, argv, "dD:r:P:c:p:b:m:LR:")) != -1) {
+  while ((opt = getopt_long(argc, argv, "dD:r:P:c:p:b:m:LR:",
+                            long_options, NULL)) != -1) {
     switch (opt) {
     case 'D':
       demo = atoi(optarg);
       break;
 
+    case 'O':
+      record_file = optarg;
+      break;
+
+    case 'n':
+      record_frames = atoi(optarg);
+      break;
+
+    case 'S':
+      random_seed = strtoul(optarg, NULL, 0);
+      seed_given = true;
+      break;
+
     case 'm':
       scroll_ms = atoi(optarg);
       break;
@@ -1099,6 +1242,11 @@ int main(int argc, char *argv[]) {
     return usage(argv[0]);
   }
 
+  if (!seed_given) {
+    random_seed = record_file ? 0 : time(NULL);
+  }
+
+  runtime_opt.do_gpio_init = (record_file == NULL);
   RGBMatrix *matrix = RGBMatrix::CreateFromOptions(matrix_options, runtime_opt);
   if (matrix == NULL)
     return 1;
@@ -1108,6 +1256,20 @@ int main(int argc, char *argv[]) {
 
   Canvas *canvas = matrix;
 
+  rgb_matrix::StreamIO *record_io = NULL;
+  if (record_file) {
+    int fd = open(record_file, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+    if (fd < 0) {
+      perror("Couldn't open output stream");
+      return 1;
+    }
+    record_io = new rgb_matrix::FileStreamIO(fd);
+    frame_recorder = new rgb_matrix::StreamWriter(record_io);
+    frames_to_record = record_frames;
+    // Demos drawing directly on the canvas draw into a frame we can record.
+    canvas = matrix->CreateFrameCanvas();
+  }
+
   // The DemoRunner objects are filling
   // the matrix continuously.
   DemoRunner *demo_runner = NULL;
@@ -1166,6 +1328,10 @@ int main(int argc, char *argv[]) {
   case 11:
     demo_runner = new BrightnessPulseGenerator(matrix);
     break;
+
+  case 12:
+    demo_runner = new TransitionDemo(matrix);
+    break;
   }
 
   if (demo_runner == NULL)
@@ -1180,10 +1346,18 @@ int main(int argc, char *argv[]) {
   printf("Press <CTRL-C> to exit and reset LEDs\n");
 
   // Now, run our particular demo; it will exit when it sees interrupt_received.
+  clock_gettime(CLOCK_MONOTONIC, &record_frame_start);
   demo_runner->Run();
 
   delete demo_runner;
-  delete canvas;
+  if (frame_recorder) {
+    fprintf(stderr, "Recorded %d frames to %s; render time %.3fms\n",
+            record_frames - frames_to_record, record_file,
+            record_render_ns / 1e6);
+    delete frame_recorder;
+    delete record_io;
+  }
+  delete matrix;
 
   printf("Received CTRL-C. Exiting.\n");
   return 0;
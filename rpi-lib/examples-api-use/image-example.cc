@@ -17,6 +17,7 @@
 //   make image-example
 
 #include "led-matrix.h"
+#include "animation-player.h"
 
 #include <math.h>
 #include <signal.h>
@@ -97,16 +98,16 @@ void CopyImageToCanvas(const Magick::Image &image, Canvas *canvas) {
 
 // An animated image has to constantly swap to the next frame.
 // We're using double-buffering and fill an offscreen buffer first, then show.
+// Each frame is copied only once; the AnimationPlayer then swaps through
+// them on its own thread.
 void ShowAnimatedImage(const ImageVector &images, RGBMatrix *matrix) {
-  FrameCanvas *offscreen_canvas = matrix->CreateFrameCanvas();
-  while (!interrupt_received) {
-    for (const auto &image : images) {
-      if (interrupt_received) break;
-      CopyImageToCanvas(image, offscreen_canvas);
-      offscreen_canvas = matrix->SwapOnVSync(offscreen_canvas);
-      usleep(image.animationDelay() * 10000);  // 1/100s converted to usec
-    }
+  rgb_matrix::AnimationPlayer player(matrix);
+  for (const auto &image : images) {
+    // 1/100s converted to usec
+    CopyImageToCanvas(image, player.AddFrame(image.animationDelay() * 10000));
   }
+  player.Start();
+  while (!interrupt_received) sleep(1);  // Until Ctrl-C is pressed
 }
 
 int usage(const char *progname) {
@@ -2,81 +2,265 @@
 // A program that reads frames form STDIN as RGB24, much like
 // https://github.com/polyfloyd/ledcat does.
 //
+// Frames are either raw RGB24 of exactly the size of the matrix, or each
+// is preceded by a 24 byte header, all numbers little endian:
+//
+//   offset size
+//        0    4  "LEDC"
+//        4    2  width
+//        6    2  height
+//        8    1  format: 0 = RGB24, 1 = BGR24
+//        9    3  reserved, 0
+//       12    8  timestamp in microseconds, on any clock of the producer
+//       20    4  size of the pixel data that follows: width * height * 3
+//
+// Frames with a header are shown at the time given by their timestamp
+// relative to the first frame; the producer can send them ahead of time.
+// Raw frames are shown as they come, or at the rate given with -f.
+// Either way, frames are shown with a swap on vsync, so they don't tear.
+//
 // This code is public domain
 // (but note, that the led-matrix library this depends on is GPL v2)
 
 #include "led-matrix.h"
+#include "graphics.h"
 
-#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
 #include <time.h>
 #include <unistd.h>
 
-#define FPS 60
+#include <vector>
 
 using rgb_matrix::RGBMatrix;
-using rgb_matrix::Canvas;
+using rgb_matrix::FrameCanvas;
 
 volatile bool interrupt_received = false;
 static void InterruptHandler(int signo) {
   interrupt_received = true;
 }
 
+static const char kMagic[4] = { 'L', 'E', 'D', 'C' };
+static const int kHeaderSize = 24;
+static const int kMaxDimension = 8192;
+
+static int usage(const char *progname) {
+  fprintf(stderr, "usage: %s [options] < frames\n", progname);
+  fprintf(stderr, "Reads RGB24 frames from stdin and shows them. Frames are "
+          "raw, of the size\nof the matrix, or each has a header with size, "
+          "format and timestamp\n(see ledcat.cc).\n");
+  fprintf(stderr, "Options:\n"
+          "\t-r        : Frames are raw, without header, even if the first "
+          "bytes look\n"
+          "\t            like one.\n"
+          "\t-f <fps>  : Show raw frames at this rate (Default: as they "
+          "come).\n"
+          "\t-D        : Drop late frames if the next one is already "
+          "waiting.\n"
+          "\t-v        : Print frames shown and dropped once a second.\n\n");
+  rgb_matrix::PrintMatrixFlags(stderr);
+  return 1;
+}
+
+static int64_t NowMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void SleepUntilMicros(int64_t t) {
+  struct timespec ts;
+  ts.tv_sec = t / 1000000;
+  ts.tv_nsec = (t % 1000000) * 1000;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR
+         && !interrupt_received) {
+  }
+}
+
+static uint64_t LittleEndian(const uint8_t *p, int bytes) {
+  uint64_t v = 0;
+  for (int i = bytes - 1; i >= 0; --i) v = (v << 8) | p[i];
+  return v;
+}
+
+// Reads frames from a file descriptor into a buffer that is reused.
+class FrameInput {
+public:
+  FrameInput(int fd, int raw_width, int raw_height, bool force_raw,
+             int raw_fps)
+    : width(0), height(0), is_bgr(false), timestamp_us(0),
+      fd_(fd), raw_width_(raw_width), raw_height_(raw_height),
+      mode_(force_raw ? RAW : UNKNOWN), raw_fps_(raw_fps), raw_count_(0) {}
+
+  bool Next() {
+    uint8_t header[kHeaderSize];
+    size_t have = 0;  // Bytes of a raw frame already read.
+    if (mode_ != RAW) {
+      if (!ReadFully(header, sizeof(kMagic))) return false;
+      if (memcmp(header, kMagic, sizeof(kMagic)) == 0) {
+        mode_ = HEADER;
+      } else if (mode_ == UNKNOWN) {
+        mode_ = RAW;  // These were the first pixels.
+        have = sizeof(kMagic);
+      } else {
+        fprintf(stderr, "Lost frame sync\n");
+        return false;
+      }
+    }
+
+    if (mode_ == RAW) {
+      width = raw_width_;
+      height = raw_height_;
+      is_bgr = false;
+      timestamp_us = raw_fps_ > 0 ? raw_count_++ * 1000000LL / raw_fps_ : 0;
+      pixels.resize((size_t)width * height * 3);
+      memcpy(&pixels[0], header, have);
+      return ReadFully(&pixels[have], pixels.size() - have);
+    }
+
+    if (!ReadFully(header + sizeof(kMagic), kHeaderSize - sizeof(kMagic)))
+      return false;
+    width = LittleEndian(header + 4, 2);
+    height = LittleEndian(header + 6, 2);
+    const int format = header[8];
+    timestamp_us = LittleEndian(header + 12, 8);
+    const uint64_t size = LittleEndian(header + 20, 4);
+    if (format > 1 || width > kMaxDimension || height > kMaxDimension
+        || size != (uint64_t)width * height * 3) {
+      fprintf(stderr, "Invalid frame header: %dx%d, format %d, %llu bytes\n",
+              width, height, format, (unsigned long long)size);
+      return false;
+    }
+    is_bgr = (format == 1);
+    pixels.resize(size);
+    return ReadFully(pixels.data(), size);
+  }
+
+  // Is there at least "bytes" more data waiting to be read?
+  bool Waiting(size_t bytes) const {
+    int available = 0;
+    return ioctl(fd_, FIONREAD, &available) == 0
+      && (size_t)available >= bytes;
+  }
+
+  int width, height;
+  bool is_bgr;
+  int64_t timestamp_us;
+  std::vector<uint8_t> pixels;
+
+private:
+  enum Mode { UNKNOWN, RAW, HEADER };
+
+  bool ReadFully(void *buf, size_t count) {
+    uint8_t *pos = (uint8_t*)buf;
+    while (count > 0 && !interrupt_received) {
+      const ssize_t r = read(fd_, pos, count);
+      if (r == 0) return false;
+      if (r < 0) {
+        if (errno == EINTR) continue;
+        perror("read");
+        return false;
+      }
+      pos += r;
+      count -= r;
+    }
+    return count == 0;
+  }
+
+  const int fd_;
+  const int raw_width_, raw_height_;
+  Mode mode_;
+  const int raw_fps_;
+  int64_t raw_count_;
+};
+
 int main(int argc, char *argv[]) {
-  RGBMatrix::Options defaults;
-  defaults.hardware_mapping = "regular"; // or e.g. "adafruit-hat"
-  defaults.rows = 32;
-  defaults.chain_length = 1;
-  defaults.parallel = 1;
-  Canvas *canvas = RGBMatrix::CreateFromFlags(&argc, &argv, &defaults);
-  if (canvas == NULL) {
+  RGBMatrix::Options matrix_options;
+  rgb_matrix::RuntimeOptions runtime_opt;
+  matrix_options.rows = 32;
+  if (!rgb_matrix::ParseOptionsFromFlags(&argc, &argv,
+                                         &matrix_options, &runtime_opt)) {
+    return usage(argv[0]);
+  }
+
+  bool force_raw = false;
+  int raw_fps = 0;
+  bool drop_late = false;
+  bool verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "rf:Dv")) != -1) {
+    switch (opt) {
+    case 'r': force_raw = true; break;
+    case 'f': raw_fps = atoi(optarg); break;
+    case 'D': drop_late = true; break;
+    case 'v': verbose = true; break;
+    default:
+      return usage(argv[0]);
+    }
+  }
+
+  RGBMatrix *matrix = RGBMatrix::CreateFromOptions(matrix_options,
+                                                   runtime_opt);
+  if (matrix == NULL) {
     return 1;
   }
+  FrameCanvas *offscreen = matrix->CreateFrameCanvas();
 
-  // It is always good to set up a signal handler to cleanly exit when we
-  // receive a CTRL-C for instance. The DrawOnCanvas() routine is looking
-  // for that.
   signal(SIGTERM, InterruptHandler);
   signal(SIGINT, InterruptHandler);
 
-  ssize_t frame_size = (ssize_t)canvas->width() * (ssize_t)canvas->height() * 3;
-  uint8_t buf[frame_size];
+  // A pipe that holds a few frames lets the producer run ahead without
+  // waiting for every single read.
+  const int frame_bytes = kHeaderSize + matrix->width() * matrix->height() * 3;
+  fcntl(STDIN_FILENO, F_SETPIPE_SZ, 4 * frame_bytes);
 
-  while (1) {
-    struct timespec start;
-    timespec_get(&start, TIME_UTC);
-
-    ssize_t nread;
-    ssize_t total_nread = 0;
-    while ((nread = read(STDIN_FILENO, &buf[total_nread], frame_size - total_nread)) > 0) {
-      if (interrupt_received) {
-        return 1;
-      }
-      total_nread += nread;
-    }
-    if (total_nread < frame_size){
-      break;
+  FrameInput input(STDIN_FILENO, matrix->width(), matrix->height(),
+                   force_raw, raw_fps);
+  int64_t clock_offset = 0;  // Our clock minus the producer's.
+  bool have_offset = false;
+  int shown = 0, dropped = 0;
+  int64_t next_report = NowMicros() + 1000000;
+  while (!interrupt_received && input.Next()) {
+    int64_t now = NowMicros();
+    int64_t present_at = input.timestamp_us + clock_offset;
+    // First frame, or the producer's clock jumped: start over from now.
+    if (!have_offset || present_at < now - 1000000
+        || present_at > now + 10000000) {
+      clock_offset = now - input.timestamp_us;
+      present_at = now;
+      have_offset = true;
     }
 
-    for (int y = 0; y < canvas->height(); y++) {
-      for (int x = 0; x < canvas->width(); x++) {
-        uint8_t *p = &buf[(y * canvas->width() + x) * 3];
-        uint8_t r = *(p+0), g = *(p+1), b = *(p+2);
-        canvas->SetPixel(x, y, r, g, b);
-      }
+    if (drop_late && present_at <= now
+        && input.Waiting(kHeaderSize + input.pixels.size())) {
+      ++dropped;
+      continue;
     }
 
-    struct timespec end;
-    timespec_get(&end, TIME_UTC);
-    long tudiff = (end.tv_nsec / 1000 + end.tv_sec * 1000000) - (start.tv_nsec / 1000 + start.tv_sec * 1000000);
-    if (tudiff < 1000000l / FPS) {
-      usleep(1000000l / FPS - tudiff);
+    if (input.width < offscreen->width() || input.height < offscreen->height())
+      offscreen->Clear();
+    rgb_matrix::SetImage(offscreen, 0, 0, input.pixels.data(),
+                         input.pixels.size(), input.width, input.height,
+                         input.is_bgr);
+    if (present_at > now) SleepUntilMicros(present_at);
+    offscreen = matrix->SwapOnVSync(offscreen);
+    ++shown;
+
+    if (verbose && (now = NowMicros()) >= next_report) {
+      fprintf(stderr, "%d frames shown, %d dropped\n", shown, dropped);
+      shown = dropped = 0;
+      next_report += 1000000;
+      if (next_report < now) next_report = now + 1000000;
     }
   }
 
   // Animation finished. Shut down the RGB matrix.
-  canvas->Clear();
-  delete canvas;
+  delete matrix;
   return 0;
 }
@@ -0,0 +1,147 @@
+#!/usr/bin/env bash
+# Record each scenario to a stream and compare it with the golden stream
+# recorded before; also compare the render time with the recorded baseline.
+#
+#   run-golden.sh check   Fail on any pixel difference or a slowdown of more
+#                         than MAX_SLOWDOWN_PERCENT (default 25) that is
+#                         also more than MIN_SLOWDOWN_MS (default 1).
+#                         A scenario without a golden stream fails, too.
+#   run-golden.sh update  Re-record golden/*.stream and golden/timings.txt
+#
+# Render times are the best of RUNS (default 5) recordings, so that a single
+# unlucky scheduling hiccup does not fail the check. Scenarios that render in
+# well below a millisecond are too noisy for a percentage alone, hence the
+# absolute minimum.
+
+set -u
+
+cd "$(dirname "$0")"
+
+MODE=${1:-check}
+RUNS=${RUNS:-5}
+MAX_SLOWDOWN_PERCENT=${MAX_SLOWDOWN_PERCENT:-25}
+MIN_SLOWDOWN_MS=${MIN_SLOWDOWN_MS:-1}
+GOLDEN_DIR=golden
+OUT_DIR=out
+TIMINGS=$GOLDEN_DIR/timings.txt
+
+# All scenarios share the same geometry, so that the streams can be compared.
+LED_OPTS="--led-rows=32 --led-cols=64 --led-chain=1 --led-parallel=1"
+
+DEMO=../examples-api-use/demo
+CLOCK_WEATHER=../examples-api-use/clock-weather
+TEXT_SCROLLER=../utils/text-scroller
+FONT=../fonts/6x10.bdf
+IMAGE=../examples-api-use/runtext.ppm
+
+# name|command; the command gets "--record=<file>" and LED_OPTS appended.
+SCENARIOS=(
+  "clock-weather|$CLOCK_WEATHER -f $FONT --frames 10"
+  "text-scroller|$TEXT_SCROLLER -f $FONT -s 20 --frames=200 Hello golden"
+  "demo-0|$DEMO -D 0 --frames=100"
+  "demo-1|$DEMO -D 1 -m 10 --frames=100 $IMAGE"
+  "demo-2|$DEMO -D 2 -m 10 --frames=100 $IMAGE"
+  "demo-3|$DEMO -D 3 --frames=10"
+  "demo-4|$DEMO -D 4 --frames=100"
+  "demo-5|$DEMO -D 5 --frames=10"
+  "demo-6|$DEMO -D 6 --frames=100"
+  "demo-7|$DEMO -D 7 --frames=100"
+  "demo-8|$DEMO -D 8 --frames=100"
+  "demo-9|$DEMO -D 9 --frames=100"
+  "demo-10|$DEMO -D 10 --frames=50"
+  "demo-11|$DEMO -D 11 --frames=100"
+  "demo-12|$DEMO -D 12 --frames=900"
+)
+
+# Clock and text layout must not depend on where this runs.
+export TZ=UTC
+export LC_ALL=C
+
+# Prints the render time in milliseconds reported by the recording.
+record() {
+  local cmd=$1 stream=$2
+  $cmd --record="$stream" $LED_OPTS 2>&1 >/dev/null \
+    | sed -n 's/^Recorded .*render time \([0-9.]*\)ms$/\1/p'
+}
+
+baseline_ms() {
+  [ -r "$TIMINGS" ] && awk -v n="$1" '$1 == n { print $2 }' "$TIMINGS"
+}
+
+mkdir -p "$OUT_DIR" "$GOLDEN_DIR"
+if [ "$MODE" = "update" ]; then
+  : > "$TIMINGS.new"
+fi
+
+failures=0
+for scenario in "${SCENARIOS[@]}"; do
+  name=${scenario%%|*}
+  cmd=${scenario#*|}
+  stream=$OUT_DIR/$name.stream
+
+  best=""
+  for ((run = 0; run < RUNS; ++run)); do
+    ms=$(record "$cmd" "$stream")
+    if [ -z "$ms" ]; then
+      break
+    fi
+    if [ -z "$best" ] || awk -v a="$ms" -v b="$best" 'BEGIN{exit !(a < b)}'
+    then
+      best=$ms
+    fi
+  done
+  if [ -z "$best" ]; then
+    printf "%-16s FAIL (could not record: %s)\n" "$name" "$cmd"
+    failures=$((failures + 1))
+    continue
+  fi
+
+  if [ "$MODE" = "update" ]; then
+    cp "$stream" "$GOLDEN_DIR/$name.stream"
+    echo "$name $best" >> "$TIMINGS.new"
+    printf "%-16s updated (%sms)\n" "$name" "$best"
+    continue
+  fi
+
+  if [ ! -r "$GOLDEN_DIR/$name.stream" ]; then
+    printf "%-16s FAIL (no golden recorded; make golden)\n" "$name"
+    failures=$((failures + 1))
+    continue
+  fi
+
+  status=ok
+  if ! ./stream-diff $LED_OPTS "$GOLDEN_DIR/$name.stream" "$stream"; then
+    status="FAIL (frames differ)"
+  fi
+  baseline=$(baseline_ms "$name")
+  timing="${best}ms"
+  if [ -n "$baseline" ]; then
+    timing="${best}ms, baseline ${baseline}ms"
+    if awk -v t="$best" -v b="$baseline" -v p="$MAX_SLOWDOWN_PERCENT" \
+        -v m="$MIN_SLOWDOWN_MS" \
+        'BEGIN{exit !(t > b * (1 + p / 100.0) && t > b + m)}'; then
+      if [ "$status" = ok ]; then
+        status="FAIL (slower than +${MAX_SLOWDOWN_PERCENT}%)"
+      fi
+    fi
+  fi
+  [ "$status" = ok ] || failures=$((failures + 1))
+  printf "%-16s %s (%s)\n" "$name" "$status" "$timing"
+done
+
+if [ "$MODE" = "update" ]; then
+  # A partial list would silently drop the baseline of failed scenarios.
+  if [ $failures -gt 0 ]; then
+    rm -f "$TIMINGS.new"
+    echo "$failures scenario(s) failed; $TIMINGS not updated."
+    exit 1
+  fi
+  mv "$TIMINGS.new" "$TIMINGS"
+  exit 0
+fi
+
+if [ $failures -gt 0 ]; then
+  echo "$failures scenario(s) failed."
+  exit 1
+fi
+echo "All ${#SCENARIOS[@]} scenarios match."
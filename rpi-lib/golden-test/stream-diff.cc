@@ -0,0 +1,118 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Compare two streams recorded with StreamWriter frame by frame.
+// Exit code 0: identical, 1: different, 2: could not read.
+
+#include "led-matrix.h"
+#include "content-streamer.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+using rgb_matrix::FrameCanvas;
+using rgb_matrix::RGBMatrix;
+
+static int usage(const char *progname) {
+  fprintf(stderr, "usage: %s [led-options] <expected.stream> "
+          "<actual.stream>\n", progname);
+  fprintf(stderr, "The led-options must match the geometry the streams "
+          "were recorded with.\n");
+  rgb_matrix::PrintMatrixFlags(stderr);
+  return 2;
+}
+
+int main(int argc, char *argv[]) {
+  RGBMatrix::Options matrix_options;
+  rgb_matrix::RuntimeOptions runtime_opt;
+  if (!rgb_matrix::ParseOptionsFromFlags(&argc, &argv,
+                                         &matrix_options, &runtime_opt)) {
+    return usage(argv[0]);
+  }
+  if (argc != 3) return usage(argv[0]);
+
+  const int expected_fd = open(argv[1], O_RDONLY);
+  if (expected_fd < 0) {
+    perror(argv[1]);
+    return 2;
+  }
+  const int actual_fd = open(argv[2], O_RDONLY);
+  if (actual_fd < 0) {
+    perror(argv[2]);
+    return 2;
+  }
+
+  runtime_opt.do_gpio_init = false;
+  RGBMatrix *matrix = RGBMatrix::CreateFromOptions(matrix_options,
+                                                   runtime_opt);
+  if (matrix == NULL) return 2;
+
+  rgb_matrix::FileStreamIO expected_io(expected_fd);
+  rgb_matrix::FileStreamIO actual_io(actual_fd);
+  rgb_matrix::StreamReader expected_reader(&expected_io);
+  rgb_matrix::StreamReader actual_reader(&actual_io);
+  FrameCanvas *expected = matrix->CreateFrameCanvas();
+  FrameCanvas *actual = matrix->CreateFrameCanvas();
+
+  int frame = 0;
+  int first_difference = -1;
+  int differences = 0;
+  for (;;) {
+    uint32_t expected_hold, actual_hold;
+    const bool have_expected = expected_reader.GetNext(expected,
+                                                       &expected_hold);
+    const bool have_actual = actual_reader.GetNext(actual, &actual_hold);
+    if (!have_expected || !have_actual) {
+      if (have_expected != have_actual) {
+        fprintf(stderr, "%s ends after %d frames\n",
+                have_expected ? argv[2] : argv[1], frame);
+        if (first_difference < 0) first_difference = frame;
+        ++differences;
+      }
+      break;
+    }
+    const char *expected_data, *actual_data;
+    size_t expected_len, actual_len;
+    expected->Serialize(&expected_data, &expected_len);
+    actual->Serialize(&actual_data, &actual_len);
+    if (expected_hold != actual_hold || expected_len != actual_len
+        || memcmp(expected_data, actual_data, expected_len) != 0) {
+      if (first_difference < 0) {
+        first_difference = frame;
+        if (expected_hold != actual_hold) {
+          fprintf(stderr, "frame %d: hold time %uus, expected %uus\n",
+                  frame, actual_hold, expected_hold);
+        }
+      }
+      ++differences;
+    }
+    ++frame;
+  }
+
+  delete matrix;
+  if (frame == 0 && first_difference < 0) {
+    fprintf(stderr, "No frames in %s\n", argv[1]);
+    return 2;
+  }
+  if (first_difference >= 0) {
+    fprintf(stderr, "%d of %d frames differ, first at frame %d\n",
+            differences, frame, first_difference);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Plays an animation of pre-rendered frames on its own thread.
+//
+// Each frame is drawn once into a FrameCanvas of the player. While
+// playing, the player only swaps these canvases on vsync, each after the
+// hold time of the previous one, so an animation that loops costs next to
+// no CPU once it is loaded:
+//
+//   rgb_matrix::AnimationPlayer player(matrix);
+//   for (...each frame of a GIF...) {
+//     rgb_matrix::FrameCanvas *frame = player.AddFrame(delay_us);
+//     SetImage(frame, 0, 0, pixels, ...);   // or any drawing.
+//   }
+//   player.Start();
+//   ...
+//   player.Stop();   // The current frame stays on the panel.
+
+#ifndef RPI_ANIMATION_PLAYER_H
+#define RPI_ANIMATION_PLAYER_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "led-matrix.h"
+
+namespace rgb_matrix {
+class AnimationPlayer {
+public:
+  enum Mode {
+    LOOP,       // 0, 1, ... n-1, 0, 1, ...
+    PING_PONG,  // 0, 1, ... n-1, n-2, ... 1, 0, 1, ...
+    ONCE,       // 0, 1, ... n-1, then the last frame stays.
+  };
+
+  // Does not take ownership of the matrix, which has to outlive the player.
+  explicit AnimationPlayer(RGBMatrix *matrix);
+  ~AnimationPlayer();  // Stops playing.
+
+  // Add a frame to be shown for "hold_time_us" and return the canvas to
+  // draw it on. Like all canvases created by the matrix, it lives as long
+  // as the matrix. Only while not playing.
+  FrameCanvas *AddFrame(uint32_t hold_time_us);
+
+  int frame_count() const { return (int)frames_.size(); }
+
+  // Default is LOOP. Takes effect with the next Start().
+  void SetMode(Mode mode) { mode_ = mode; }
+
+  // Start playing from the first frame. Returns false if there are no
+  // frames or it is already playing.
+  bool Start();
+
+  // Stop playing; returns once the player doesn't swap anymore. The frame
+  // shown last stays on the panel, copied into the canvas that was there
+  // before Start(). So the caller's canvases are as before; its offscreen
+  // canvas stays valid, and the next SwapOnVSync() hands back its own
+  // canvas, never one of the frames.
+  void Stop();
+
+  // False once stopped, or after the last frame in ONCE mode.
+  bool IsPlaying() const;
+
+private:
+  class Timer;
+
+  RGBMatrix *const matrix_;
+  Mode mode_;
+  std::vector<FrameCanvas*> frames_;
+  std::vector<uint32_t> hold_times_us_;
+  Timer *timer_;
+};
+}  // namespace rgb_matrix
+
+#endif  // RPI_ANIMATION_PLAYER_H
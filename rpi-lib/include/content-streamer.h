@@ -20,6 +20,7 @@
 #include <sys/types.h>
 
 #include <string>
+#include <vector>
 
 namespace rgb_matrix {
 class FrameCanvas;
@@ -56,6 +57,42 @@ private:
   const int fd_;
 };
 
+// Writing to a file in a background thread, so that a slow disk (such as
+// an SD card) does not hold up producing frames. Append() copies into a
+// bounded queue of page-aligned buffers and only waits if the queue is
+// full. The writer thread writes several buffers at once with pwritev() at
+// aligned offsets and calls fdatasync() every "checkpoint_bytes" and in
+// Checkpoint(). Write-only; Append() is to be called from one thread.
+class AsyncFileStreamIO : public StreamIO {
+public:
+  struct Stats {
+    int64_t bytes_written;
+    int64_t elapsed_nanos;    // From first Append() to the last write.
+    int64_t stall_nanos;      // Total time Append() waited for the queue.
+    int64_t max_stall_nanos;  // Longest of these waits.
+    int checkpoints;          // Number of fdatasync() calls.
+  };
+
+  // Takes ownership of "fd" and writes from its current position.
+  explicit AsyncFileStreamIO(int fd, size_t max_queue_bytes = 32 << 20,
+                             size_t checkpoint_bytes = 64 << 20);
+  ~AsyncFileStreamIO();  // Writes and syncs what is left, closes fd.
+
+  // Wait until everything appended is written and synced. Returns false
+  // if there was a write error.
+  bool Checkpoint();
+
+  Stats GetStats() const;
+
+  void Rewind() final {}
+  ssize_t Read(void *buf, size_t count) final { return -1; }
+  ssize_t Append(const void *buf, size_t count) final;
+
+private:
+  class Writer;
+  Writer *const writer_;
+};
+
 // Storing a stream in memory. Owns the memory.
 class MemStreamIO : public StreamIO {
 public:
@@ -68,6 +105,42 @@ private:
   size_t pos_;
 };
 
+// Storing a stream in memory in fixed size chunks. Appending never moves
+// what is stored already, so it takes constant time for long recordings.
+// With "shareable", the chunks are mappings of a memfd, which then holds
+// the stream as a file that can be mapped or passed to another process.
+class ChunkedMemStreamIO : public StreamIO {
+public:
+  explicit ChunkedMemStreamIO(size_t chunk_size = 1 << 20,
+                              bool shareable = false);
+  ~ChunkedMemStreamIO();
+
+  void Rewind() final;
+  ssize_t Read(void *buf, size_t count) final;
+  ssize_t Append(const void *buf, size_t count) final;
+
+  // Like Read(), but points "data" at the stored bytes instead of copying
+  // them. Returns fewer than "count" bytes at the end of a chunk.
+  ssize_t ReadInPlace(const char **data, size_t count);
+
+  size_t size() const { return size_; }
+
+  // With "shareable", the memfd with the stream, size() bytes long, e.g.
+  // for MemMapViewInput(dup(fd())) or to send to another process. Stays
+  // owned by this object. Otherwise -1.
+  int fd();
+
+private:
+  bool AddChunk();
+
+  const size_t chunk_size_;
+  const int fd_;
+  std::vector<char*> chunks_;
+  size_t size_;
+  size_t pos_;
+  size_t file_size_;  // Of the memfd.
+};
+
 // Just a view around the memory, possibly a memory mapped file.
 class MemMapViewInput : public StreamIO {
 public:
@@ -132,6 +205,37 @@ private:
 
   char *header_frame_buffer_;
 };
+
+// A StreamReader that reads ahead in a background thread, so that a slow
+// disk doesn't hold up the next frame. The frames read ahead are kept in
+// the "lookahead" canvases, one frame each.
+class PrefetchingStreamReader {
+public:
+  // Does not take ownership of "io" nor the "lookahead" canvases. Needs at
+  // least one canvas, created by the same RGBMatrix as the frames passed
+  // to GetNext().
+  PrefetchingStreamReader(StreamIO *io,
+                          const std::vector<FrameCanvas*> &lookahead);
+  ~PrefetchingStreamReader();
+
+  void Rewind();
+
+  // Like StreamReader::GetNext(); copies the next prefetched frame into
+  // "frame".
+  bool GetNext(FrameCanvas *frame, uint32_t *hold_time_us);
+
+  // Number of times GetNext() had to wait for a frame not read yet; the
+  // first frame after construction or Rewind() doesn't count.
+  int underruns() const;
+
+private:
+  class Prefetcher;
+  Prefetcher *const prefetcher_;
+};
+
+// Tell the kernel that "fd" is read sequentially and to start reading
+// ahead now. Good before playing a stream from it.
+void AdviseSequentialRead(int fd);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,187 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Run curl transfers on an EventLoop through the curl_multi socket
+// interface, so that a slow server does not hold up anything else.
+// Programs using this need to link -lcurl.
+//
+//   rgb_matrix::CurlMulti curl(&loop);
+//   ...
+//   CURL *easy = curl_easy_init();
+//   ... curl_easy_setopt() as usual ...
+//   CURLcode result = co_await curl.Perform(easy);
+//
+// Name resolution only is asynchronous if libcurl is built with the
+// threaded or c-ares resolver, which is the default on Raspberry Pi OS.
+
+#ifndef RPI_EVENT_LOOP_CURL_H
+#define RPI_EVENT_LOOP_CURL_H
+
+#include "event-loop.h"
+
+#include <curl/curl.h>
+
+namespace rgb_matrix {
+
+class CurlMulti {
+public:
+  explicit CurlMulti(EventLoop *loop)
+    : loop_(loop), multi_(curl_multi_init()),
+      timer_fd_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      timer_watched_(false) {
+    curl_multi_setopt(multi_, CURLMOPT_SOCKETFUNCTION, &SocketCallback);
+    curl_multi_setopt(multi_, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(multi_, CURLMOPT_TIMERFUNCTION, &TimerCallback);
+    curl_multi_setopt(multi_, CURLMOPT_TIMERDATA, this);
+  }
+
+  // Transfers still running are aborted; their coroutines will not resume
+  // and are destroyed with the loop. Destroy this before the loop.
+  ~CurlMulti() {
+    for (TransferAwaiter *transfer : transfers_) {
+      curl_multi_remove_handle(multi_, transfer->easy_);
+      transfer->multi_ = NULL;
+    }
+    transfers_.clear();
+    if (timer_watched_) loop_->Unwatch(timer_fd_);
+    curl_multi_cleanup(multi_);
+    close(timer_fd_);
+  }
+
+  // co_await curl->Perform(easy) runs the transfer and returns the result
+  // curl_easy_perform() would. The easy handle stays owned by the caller.
+  class TransferAwaiter {
+  public:
+    TransferAwaiter(CurlMulti *multi, CURL *easy)
+      : multi_(multi), easy_(easy), result_(CURLE_OK) {}
+    TransferAwaiter(const TransferAwaiter &) = delete;
+    // The coroutine was destroyed mid-transfer, e.g. with the loop.
+    ~TransferAwaiter() { if (handle_ && multi_) multi_->Abort(this); }
+
+    bool await_ready() const { return false; }
+    bool await_suspend(std::coroutine_handle<> h) {
+      curl_easy_setopt(easy_, CURLOPT_PRIVATE, this);
+      const CURLMcode added = curl_multi_add_handle(multi_->multi_, easy_);
+      if (added != CURLM_OK) {
+        result_ = CURLE_FAILED_INIT;
+        return false;
+      }
+      handle_ = h;
+      multi_->transfers_.insert(this);
+      multi_->loop_->waiting_.insert(h);
+      multi_->Watching(true);
+      return true;
+    }
+    CURLcode await_resume() const { return result_; }
+
+  private:
+    friend class CurlMulti;
+    CurlMulti *multi_;   // NULL once the CurlMulti is gone.
+    CURL *const easy_;
+    CURLcode result_;
+    std::coroutine_handle<> handle_;
+  };
+
+  TransferAwaiter Perform(CURL *easy) { return TransferAwaiter(this, easy); }
+
+private:
+  static int SocketCallback(CURL *easy, curl_socket_t fd, int what,
+                            void *userp, void *socketp) {
+    CurlMulti *self = reinterpret_cast<CurlMulti*>(userp);
+    if (what == CURL_POLL_REMOVE) {
+      self->loop_->Unwatch(fd);
+      return 0;
+    }
+    uint32_t events = 0;
+    if (what & CURL_POLL_IN) events |= EPOLLIN;
+    if (what & CURL_POLL_OUT) events |= EPOLLOUT;
+    self->loop_->Watch(fd, events, [self, fd](uint32_t fired) {
+        int action = 0;
+        if (fired & EPOLLIN) action |= CURL_CSELECT_IN;
+        if (fired & EPOLLOUT) action |= CURL_CSELECT_OUT;
+        if (fired & (EPOLLERR | EPOLLHUP)) action |= CURL_CSELECT_ERR;
+        self->Drive(fd, action);
+      });
+    return 0;
+  }
+
+  static int TimerCallback(CURLM *multi, long timeout_ms, void *userp) {
+    CurlMulti *self = reinterpret_cast<CurlMulti*>(userp);
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));   // -1: delete timer.
+    if (timeout_ms >= 0) {
+      spec.it_value.tv_sec = timeout_ms / 1000;
+      spec.it_value.tv_nsec = (timeout_ms % 1000) * 1000000;
+      if (timeout_ms == 0) spec.it_value.tv_nsec = 1;  // Right away.
+    }
+    timerfd_settime(self->timer_fd_, 0, &spec, NULL);
+    return 0;
+  }
+
+  void Abort(TransferAwaiter *transfer) {
+    curl_multi_remove_handle(multi_, transfer->easy_);
+    transfers_.erase(transfer);
+    loop_->waiting_.erase(transfer->handle_);
+    Watching(!transfers_.empty());
+  }
+
+  // Keep the timer watched while transfers are running, so that the
+  // loop does not consider itself idle.
+  void Watching(bool on) {
+    if (on == timer_watched_) return;
+    timer_watched_ = on;
+    if (!on) {
+      loop_->Unwatch(timer_fd_);
+      return;
+    }
+    loop_->Watch(timer_fd_, EPOLLIN, [this](uint32_t) {
+        uint64_t expirations;
+        if (read(timer_fd_, &expirations, sizeof(expirations)) < 0) {}
+        Drive(CURL_SOCKET_TIMEOUT, 0);
+      });
+  }
+
+  void Drive(curl_socket_t fd, int action) {
+    int running;
+    curl_multi_socket_action(multi_, fd, action, &running);
+    CURLMsg *msg;
+    int pending;
+    while ((msg = curl_multi_info_read(multi_, &pending)) != NULL) {
+      if (msg->msg != CURLMSG_DONE) continue;
+      CURL *const easy = msg->easy_handle;
+      const CURLcode result = msg->data.result;
+      TransferAwaiter *awaiter = NULL;
+      curl_easy_getinfo(easy, CURLINFO_PRIVATE, &awaiter);
+      curl_multi_remove_handle(multi_, easy);
+      if (awaiter == NULL || transfers_.erase(awaiter) == 0) continue;
+      loop_->waiting_.erase(awaiter->handle_);
+      awaiter->result_ = result;
+      std::coroutine_handle<> resume = awaiter->handle_;
+      awaiter->handle_ = nullptr;
+      resume.resume();
+    }
+    // Resumed coroutines might have started new transfers meanwhile.
+    Watching(!transfers_.empty());
+  }
+
+  EventLoop *const loop_;
+  CURLM *const multi_;
+  const int timer_fd_;
+  std::set<TransferAwaiter*> transfers_;
+  bool timer_watched_;
+};
+
+}  // namespace rgb_matrix
+
+#endif  // RPI_EVENT_LOOP_CURL_H
@@ -0,0 +1,377 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// A small single-threaded epoll event loop with C++20 coroutine awaitables
+// for timers, file descriptor readiness and SwapOnVSync() completion.
+// Lets the utilities wait for several things at once without blocking
+// their render path. See event-loop-curl.h for curl transfers.
+//
+// Header-only, so the library itself stays C++11; programs using this
+// need to be compiled with -std=c++20.
+//
+//   rgb_matrix::Task Blink(rgb_matrix::EventLoop *loop, ...) {
+//     for (;;) {
+//       ... draw into offscreen ...
+//       offscreen = co_await loop->SwapOnVSync(matrix, offscreen);
+//       co_await loop->SleepFor(500 * 1000000LL);
+//     }
+//   }
+//   ...
+//   Blink(&loop, ...);   // Runs until the first co_await.
+//   loop.Run();          // Until Stop() or nothing is left to wait for.
+
+#ifndef RPI_EVENT_LOOP_H
+#define RPI_EVENT_LOOP_H
+
+#if __cplusplus < 202002L
+#  error "event-loop.h needs C++20 (-std=c++20)"
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <map>
+#include <set>
+
+#include "led-matrix.h"
+#include "thread.h"
+#include "trace-probes.h"
+
+namespace rgb_matrix {
+class CurlMulti;
+
+// Return type of a coroutine started on the event loop. It starts running
+// right away when called, and is owned by itself from then on: the frame
+// goes away when the coroutine returns. Exceptions are not supported.
+class Task {
+public:
+  struct promise_type {
+    Task get_return_object() { return Task(); }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+class EventLoop {
+public:
+  // Called with the epoll events that fired on a watched file descriptor.
+  typedef std::function<void(uint32_t events)> Handler;
+
+  EventLoop()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wakeup_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      stop_requested_(0), swapper_(NULL) {
+    Watch(wakeup_fd_, EPOLLIN, [this](uint32_t) {
+        uint64_t value;
+        while (read(wakeup_fd_, &value, sizeof(value)) > 0) {}
+      });
+  }
+
+  // Coroutines still waiting on this loop are destroyed, so their locals
+  // are cleaned up.
+  ~EventLoop() {
+    delete swapper_;
+    while (!waiting_.empty()) {
+      std::coroutine_handle<> h = *waiting_.begin();
+      waiting_.erase(waiting_.begin());
+      h.destroy();
+    }
+    close(wakeup_fd_);
+    close(epoll_fd_);
+  }
+
+  // Call "handler" whenever any of the epoll "events" is pending on "fd",
+  // until Unwatch(). Watching the same fd again replaces the previous
+  // handler; there can only be one per fd.
+  bool Watch(int fd, uint32_t events, Handler handler) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    const bool known = handlers_.find(fd) != handlers_.end();
+    if (epoll_ctl(epoll_fd_, known ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                  fd, &ev) < 0) {
+      perror("epoll_ctl()");
+      return false;
+    }
+    handlers_[fd] = handler;
+    return true;
+  }
+
+  void Unwatch(int fd) {
+    if (handlers_.erase(fd) == 0) return;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, NULL);
+  }
+
+  // Dispatch events until Stop() is called or no file descriptors are
+  // watched anymore. Returns right away if Stop() was called before.
+  void Run() {
+    struct epoll_event events[16];
+    while (!stop_requested_ && handlers_.size() > 1) {
+      const int n = epoll_wait(epoll_fd_, events, 16, -1);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        perror("epoll_wait()");
+        break;
+      }
+      for (int i = 0; i < n && !stop_requested_; ++i) {
+        std::map<int, Handler>::const_iterator found
+          = handlers_.find(events[i].data.fd);
+        if (found == handlers_.end()) continue;  // Unwatched meanwhile.
+        // Copy, as the handler is free to Unwatch() itself.
+        const Handler handler = found->second;
+        handler(events[i].events);
+      }
+    }
+    stop_requested_ = 0;  // Each Stop() ends one Run().
+  }
+
+  // Make Run() return. Async-signal-safe, so can be called from a
+  // signal handler.
+  void Stop() {
+    stop_requested_ = 1;
+    const uint64_t one = 1;
+    if (write(wakeup_fd_, &one, sizeof(one)) < 0) {}
+  }
+
+  // -- Awaitables. Only one coroutine can wait on a particular fd.
+
+  // co_await loop->WaitFor(fd, EPOLLIN) returns the events that fired.
+  class FdAwaiter {
+  public:
+    FdAwaiter(EventLoop *loop, int fd, uint32_t events)
+      : loop_(loop), fd_(fd), events_(events), fired_(0) {}
+    FdAwaiter(const FdAwaiter &) = delete;
+    ~FdAwaiter() { if (handle_) Cancel(); }
+
+    bool await_ready() const { return false; }
+    bool await_suspend(std::coroutine_handle<> h) {
+      if (!loop_->Watch(fd_, events_, [this](uint32_t fired) {
+            fired_ = fired;
+            Cancel();
+            std::coroutine_handle<> resume = handle_;
+            handle_ = nullptr;
+            resume.resume();
+          })) {
+        fired_ = EPOLLERR;
+        return false;
+      }
+      handle_ = h;
+      loop_->waiting_.insert(h);
+      return true;
+    }
+    uint32_t await_resume() const { return fired_; }
+
+  private:
+    void Cancel() {
+      loop_->Unwatch(fd_);
+      loop_->waiting_.erase(handle_);
+    }
+
+    EventLoop *const loop_;
+    const int fd_;
+    const uint32_t events_;
+    uint32_t fired_;
+    std::coroutine_handle<> handle_;
+  };
+
+  FdAwaiter WaitFor(int fd, uint32_t events) {
+    return FdAwaiter(this, fd, events);
+  }
+  FdAwaiter Readable(int fd) { return FdAwaiter(this, fd, EPOLLIN); }
+  FdAwaiter Writable(int fd) { return FdAwaiter(this, fd, EPOLLOUT); }
+
+  // co_await loop->SleepUntil(CLOCK_REALTIME, deadline). Each sleep is
+  // backed by its own timerfd, so it has the full resolution of the clock.
+  class TimerAwaiter {
+  public:
+    TimerAwaiter(EventLoop *loop, clockid_t clock,
+                 const struct timespec &when, bool absolute)
+      : timer_fd_(timerfd_create(clock, TFD_NONBLOCK | TFD_CLOEXEC)),
+        waiter_(loop, timer_fd_, EPOLLIN) {
+      struct itimerspec spec;
+      memset(&spec, 0, sizeof(spec));
+      spec.it_value = when;
+      if (!absolute && when.tv_sec == 0 && when.tv_nsec == 0)
+        spec.it_value.tv_nsec = 1;   // Zero would disarm the timer.
+      timerfd_settime(timer_fd_, absolute ? TFD_TIMER_ABSTIME : 0,
+                      &spec, NULL);
+    }
+    ~TimerAwaiter() { close(timer_fd_); }
+
+    bool await_ready() const { return timer_fd_ < 0; }
+    bool await_suspend(std::coroutine_handle<> h) {
+      return waiter_.await_suspend(h);
+    }
+    void await_resume() const {}
+
+  private:
+    const int timer_fd_;
+    FdAwaiter waiter_;
+  };
+
+  TimerAwaiter SleepUntil(clockid_t clock, const struct timespec &deadline) {
+    return TimerAwaiter(this, clock, deadline, true);
+  }
+  TimerAwaiter SleepFor(int64_t nanoseconds) {
+    struct timespec delay;
+    delay.tv_sec = nanoseconds > 0 ? nanoseconds / 1000000000 : 0;
+    delay.tv_nsec = nanoseconds > 0 ? nanoseconds % 1000000000 : 0;
+    return TimerAwaiter(this, CLOCK_MONOTONIC, delay, false);
+  }
+
+  // co_await loop->SwapOnVSync(matrix, canvas) works like
+  // RGBMatrix::SwapOnVSync() and returns the previous canvas, but the wait
+  // for the vertical sync happens in a helper thread so that other
+  // coroutines keep running meanwhile. Only one swap at a time.
+  class SwapAwaiter {
+  public:
+    SwapAwaiter(EventLoop *loop, RGBMatrix *matrix, FrameCanvas *canvas,
+                unsigned framerate_fraction)
+      : loop_(loop), matrix_(matrix), canvas_(canvas),
+        framerate_fraction_(framerate_fraction),
+        waiter_(loop, loop->swapper_->fd(), EPOLLIN) {}
+
+    bool await_ready() const { return false; }
+    bool await_suspend(std::coroutine_handle<> h) {
+      loop_->swapper_->Request(matrix_, canvas_, framerate_fraction_);
+      return waiter_.await_suspend(h);
+    }
+    FrameCanvas *await_resume() { return loop_->swapper_->Collect(); }
+
+  private:
+    EventLoop *const loop_;
+    RGBMatrix *const matrix_;
+    FrameCanvas *const canvas_;
+    const unsigned framerate_fraction_;
+    FdAwaiter waiter_;
+  };
+
+  // The loop has to be destroyed before the matrix, as a swap might
+  // still be in progress.
+  SwapAwaiter SwapOnVSync(RGBMatrix *matrix, FrameCanvas *canvas,
+                          unsigned framerate_fraction = 1) {
+    if (swapper_ == NULL) swapper_ = new Swapper();
+    return SwapAwaiter(this, matrix, canvas, framerate_fraction);
+  }
+
+private:
+  // Thread that does the blocking RGBMatrix::SwapOnVSync() and signals
+  // an eventfd when done.
+  class Swapper : public Thread {
+  public:
+    Swapper()
+      : done_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), running_(true),
+        matrix_(NULL), canvas_(NULL), framerate_fraction_(1), result_(NULL),
+        frames_(0) {
+      pthread_cond_init(&request_, NULL);
+      // Signals go to the event loop thread, not to us.
+      sigset_t all, old;
+      sigfillset(&all);
+      pthread_sigmask(SIG_BLOCK, &all, &old);
+      Start();
+      pthread_sigmask(SIG_SETMASK, &old, NULL);
+    }
+    ~Swapper() {
+      {
+        MutexLock l(&mutex_);
+        running_ = false;
+        pthread_cond_signal(&request_);
+      }
+      WaitStopped();
+      pthread_cond_destroy(&request_);
+      close(done_fd_);
+    }
+
+    int fd() const { return done_fd_; }
+
+    void Request(RGBMatrix *matrix, FrameCanvas *canvas,
+                 unsigned framerate_fraction) {
+      MutexLock l(&mutex_);
+      matrix_ = matrix;
+      canvas_ = canvas;
+      framerate_fraction_ = framerate_fraction;
+      pthread_cond_signal(&request_);
+    }
+
+    FrameCanvas *Collect() {
+      uint64_t value;
+      if (read(done_fd_, &value, sizeof(value)) < 0) {}
+      MutexLock l(&mutex_);
+      return result_;
+    }
+
+    virtual void Run() {
+      MutexLock l(&mutex_);
+      for (;;) {
+        while (running_ && matrix_ == NULL) mutex_.WaitOn(&request_);
+        if (!running_) return;
+        RGBMatrix *const matrix = matrix_;
+        FrameCanvas *const canvas = canvas_;
+        const unsigned framerate_fraction = framerate_fraction_;
+        const uint64_t frame = ++frames_;
+        matrix_ = NULL;
+        mutex_.Unlock();
+        RGB_MATRIX_PROBE2(swap_start, frame, framerate_fraction);
+        const int64_t start_ns = RGB_MATRIX_PROBE_START_NS(swap_done);
+        FrameCanvas *const previous
+          = matrix->SwapOnVSync(canvas, framerate_fraction);
+        if (start_ns != 0) {
+          RGB_MATRIX_PROBE2(swap_done, frame, probes::NowNs() - start_ns);
+        }
+        mutex_.Lock();
+        result_ = previous;
+        const uint64_t one = 1;
+        if (write(done_fd_, &one, sizeof(one)) < 0) {}
+      }
+    }
+
+  private:
+    const int done_fd_;
+    Mutex mutex_;
+    pthread_cond_t request_;
+    bool running_;
+    RGBMatrix *matrix_;
+    FrameCanvas *canvas_;
+    unsigned framerate_fraction_;
+    FrameCanvas *result_;
+    uint64_t frames_;
+  };
+
+  const int epoll_fd_;
+  const int wakeup_fd_;
+  volatile sig_atomic_t stop_requested_;
+  std::map<int, Handler> handlers_;
+  // Coroutines suspended on the loop; CurlMulti adds its transfers.
+  friend class CurlMulti;
+  std::set<std::coroutine_handle<> > waiting_;
+  Swapper *swapper_;
+};
+
+}  // namespace rgb_matrix
+
+#endif  // RPI_EVENT_LOOP_H
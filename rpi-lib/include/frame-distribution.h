@@ -0,0 +1,170 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Render frames on one host and show them on many display nodes.
+//
+// The render host draws into an RGBBuffer (or has RGB24 data, e.g. from a
+// video decoder) and hands it to a FrameSender. Each node shows one
+// rectangle of the frame. Per node, only the 8x8 tiles that differ from
+// the last frame the node acknowledged are sent over UDP, unicast or to a
+// multicast group. On the node, a FrameReceiver puts the frame together
+// and draws the changed tiles into the back buffer:
+//
+//   rgb_matrix::FrameReceiver receiver(node_id, matrix->width(),
+//                                      matrix->height());
+//   receiver.Open("7740");
+//   for (;;) {
+//     if (!receiver.Receive(1000)) continue;
+//     receiver.Apply(offscreen);
+//     offscreen = matrix->SwapOnVSync(offscreen);
+//   }
+//
+// Lost packets only delay a node: deltas are always relative to a frame
+// the node confirmed to have. When the sender restarts, nodes start over
+// with its first frame.
+
+#ifndef RPI_FRAME_DISTRIBUTION_H
+#define RPI_FRAME_DISTRIBUTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "canvas.h"
+#include "rgb-buffer.h"
+
+namespace rgb_matrix {
+// Counters since the last FrameSender::TakeStats().
+struct FrameSenderStats {
+  int64_t bytes;           // UDP payload sent.
+  int frames_sent;         // Frames with changes for this node.
+  int frames_acked;
+  int64_t ack_latency_ns;  // Mean time from SendFrame() to acknowledge.
+};
+
+class FrameSender {
+public:
+  FrameSender();
+  ~FrameSender();
+
+  // Node "node_id" shows the rectangle at "x","y" of "width" x "height"
+  // pixels and listens at "address" ("host:port" or "[ipv6-host]:port",
+  // can be a multicast group). Returns false and sets errno if the address
+  // is not usable.
+  bool AddNode(int node_id, const char *address,
+               int x, int y, int width, int height);
+
+  // Send the changes of this frame to all nodes. "rgb" has "width" x
+  // "height" pixels, rows "stride" bytes apart. Parts of node rectangles
+  // outside the frame are black. A node that did not acknowledge the
+  // last update gets it again after a while, even if nothing changed.
+  void SendFrame(const uint8_t *rgb, int width, int height, int stride);
+  void SendFrame(const RGBBuffer &frame) {
+    SendFrame(frame.data(), frame.width(), frame.height(), 3*frame.width());
+  }
+
+  // Handle acknowledgements of nodes for up to "timeout_ms". Call this
+  // while waiting for the next frame, so that the next deltas can be
+  // based on recent frames and the latency is measured exactly.
+  void WaitForAcks(int timeout_ms);
+
+  // Statistics of the i-th node added.
+  int node_count() const { return (int)nodes_.size(); }
+  FrameSenderStats TakeStats(int i);
+
+private:
+  struct Node;
+  void ReadAck(int fd);
+  void SendUpdate(Node *node, const std::string &image);
+
+  int sockets_[2];  // IPv4, IPv6; created when needed.
+  std::vector<Node*> nodes_;
+  const uint32_t session_;
+  uint32_t sequence_;
+  int64_t now_ns_;
+};
+
+class FrameReceiver {
+public:
+  // The node's rectangle has "width" x "height" pixels; updates for other
+  // sizes are ignored.
+  FrameReceiver(int node_id, int width, int height);
+  ~FrameReceiver();
+
+  // Listen on "port", "host:port" or "multicast-group:port"; IPv6 hosts
+  // go in brackets, "[::1]:port". Returns false and sets errno on failure,
+  // also EINVAL for an unusable size.
+  bool Open(const char *address);
+
+  // Wait up to "timeout_ms" for the next complete frame. Returns true if
+  // there is a new frame to Apply().
+  bool Receive(int timeout_ms);
+
+  // Bring "canvas" up to date with the latest frame. Only the tiles that
+  // changed since this canvas was last passed here are drawn, so with
+  // double buffering, each swap only costs the tiles that changed.
+  void Apply(Canvas *canvas);
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  // Time from SendFrame() to the frame being complete here. Only
+  // meaningful if both run on the same machine or have synced clocks.
+  int64_t latency_ns() const { return latency_ns_; }
+  int64_t bytes_received() const { return bytes_received_; }
+
+private:
+  struct Frame {
+    uint32_t sequence;
+    std::string image;
+  };
+  void HandlePacket();
+  void CompleteFrame();
+  const Frame *FindFrame(uint32_t sequence) const;
+  void SendToSender(uint8_t type, uint32_t sequence, int64_t sent_ns);
+
+  const int node_id_;
+  int fd_;
+  uint32_t session_;  // Of the sender the frames are from.
+  const int width_, height_;
+  std::deque<Frame> frames_;  // Latest complete frames, newest last.
+
+  // Frame being received.
+  uint32_t pending_sequence_, pending_base_;
+  int64_t pending_sent_ns_;
+  std::vector<bool> pending_packets_;
+  int pending_missing_;
+  std::vector<std::pair<int, std::string> > pending_tiles_;
+
+  // Which frame generation last changed each tile, and which generation
+  // each canvas passed to Apply() has.
+  uint32_t generation_;
+  std::vector<uint32_t> tile_generation_;
+  std::vector<std::pair<Canvas*, uint32_t> > canvases_;
+  bool new_frame_;
+
+  int64_t latency_ns_;
+  int64_t bytes_received_;
+  struct sockaddr_storage sender_addr_;
+  socklen_t sender_addr_len_;
+};
+
+}  // namespace rgb_matrix
+
+#endif  // RPI_FRAME_DISTRIBUTION_H
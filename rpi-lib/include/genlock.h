@@ -0,0 +1,157 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Swap frames at the same moment on several Raspberry Pis that together
+// form one video wall.
+//
+// A coordinator announces "present frame N at time T" over UDP to every
+// node that talks to it. Each node keeps its clock offset to the
+// coordinator with NTP-style round trips, loads frame N ahead of time and
+// swaps at T translated to its own clock:
+//
+//   rgb_matrix::GenlockNode node(node_id);
+//   node.Open("wall-master:7733");
+//   uint32_t frame;
+//   int64_t present_at;
+//   while (node.NextPresent(1000, &frame, &present_at)) {
+//     ...draw or load frame into offscreen...
+//     node.SleepUntil(present_at);
+//     offscreen = matrix->SwapOnVSync(offscreen);
+//     node.Presented(present_at);
+//   }
+//
+// All times are CLOCK_MONOTONIC nanoseconds of the respective machine.
+
+#ifndef RPI_GENLOCK_H
+#define RPI_GENLOCK_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace rgb_matrix {
+// What a node tells the coordinator about once a second.
+struct GenlockReport {
+  int node_id;
+  uint32_t frame;          // Last frame presented.
+  int64_t offset_ns;       // Coordinator clock minus node clock.
+  int64_t rtt_ns;          // Round trip time of the best recent sync.
+  int64_t swap_error_ns;   // Mean of (swap done - present time).
+  int64_t swap_jitter_ns;  // Standard deviation of the same.
+};
+
+class GenlockCoordinator {
+public:
+  typedef std::function<void(const GenlockReport &)> ReportHandler;
+
+  GenlockCoordinator();
+  ~GenlockCoordinator();
+
+  // Listen on "port", "host:port" or "[ipv6-host]:port". Returns false
+  // and sets errno on failure.
+  bool Open(const char *address);
+
+  // Called with every report a node sends.
+  void SetReportHandler(const ReportHandler &handler) { handler_ = handler; }
+
+  // Tell all nodes heard from in the last few seconds to present "frame"
+  // at "present_ns" on the coordinator clock. Send this early enough for
+  // the nodes to prepare the frame.
+  void Announce(uint32_t frame, int64_t present_ns);
+
+  // Answer clock sync requests and collect reports until "deadline_ns".
+  void ServeUntil(int64_t deadline_ns);
+
+  // Number of nodes heard from recently.
+  int node_count() const { return (int)nodes_.size(); }
+
+private:
+  struct Node {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int64_t last_seen_ns;
+  };
+  void HandlePacket();
+  void Remember(const struct sockaddr_storage &addr, socklen_t len);
+
+  int fd_;
+  std::vector<Node> nodes_;
+  ReportHandler handler_;
+};
+
+class GenlockNode {
+public:
+  explicit GenlockNode(int node_id);
+  ~GenlockNode();
+
+  // Connect to the coordinator at "host:port" or "[ipv6-host]:port".
+  // Returns false and sets errno on failure.
+  bool Open(const char *coordinator);
+
+  // Wait up to "timeout_ms" for the next frame to present, keeping the
+  // clock in sync meanwhile. Returns the frame number and when to present
+  // it on the local clock. Frames are only handed out once the clock is
+  // synchronized; if several are overdue, only the latest one is returned.
+  bool NextPresent(int timeout_ms, uint32_t *frame, int64_t *local_present_ns);
+
+  // Sleep until "local_ns", keeping the clock in sync meanwhile.
+  void SleepUntil(int64_t local_ns);
+
+  // Call right after the swap of the frame due at "local_present_ns".
+  // Keeps swap statistics and sends a report once a second.
+  void Presented(int64_t local_present_ns);
+
+  bool synced() const { return synced_; }
+  int64_t offset_ns() const { return offset_ns_; }
+  const GenlockReport &last_report() const { return report_; }
+
+private:
+  struct Present {
+    uint32_t frame;
+    int64_t coordinator_ns;
+  };
+  struct Sample {
+    int64_t offset_ns;
+    int64_t rtt_ns;
+  };
+  void Pump(int timeout_ms);
+  void HandlePacket();
+  void MaybeRequestSync(int64_t now);
+  void AddSample(const Sample &sample);
+
+  const int node_id_;
+  int fd_;
+  bool synced_;
+  int64_t offset_ns_;
+  int64_t next_sync_ns_;
+  std::vector<Sample> samples_;  // Most recent clock sync round trips.
+  size_t sample_count_;
+  std::deque<Present> pending_;
+
+  uint32_t last_frame_;
+  int swaps_;
+  double error_sum_, error_square_sum_;
+  int64_t next_report_ns_;
+  GenlockReport report_;
+};
+
+// CLOCK_MONOTONIC in nanoseconds.
+int64_t GenlockNowNanos();
+
+}  // namespace rgb_matrix
+
+#endif  // RPI_GENLOCK_H
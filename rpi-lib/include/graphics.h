@@ -12,7 +12,10 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include <list>
 #include <map>
+#include <string>
+#include <vector>
 
 namespace rgb_matrix {
 struct Color {
@@ -80,6 +83,83 @@ private:
   CodepointGlyphMap glyphs_;
 };
 
+// A font for very large BDF files of which only a few glyphs are ever used.
+//
+// Instead of decoding every glyph like Font::LoadFont() does, Open() scans
+// the file once and only remembers where each glyph is. Prepare() then
+// decodes glyphs the first time some text needs them.
+//
+// Glyphs are not added one by one: when some are missing, Prepare() loads a
+// new Font from the header and all glyphs kept, written to an in-memory BDF
+// file (read through /proc/self/fd, or a temporary file without /proc).
+// This costs time in proportion to the glyphs kept, so it pays off for
+// fonts with thousands of glyphs of which a few dozen are shown. Prepare()
+// has to be called with each text before drawing it.
+//
+// Optionally, the number of glyphs kept can be limited; the least recently
+// used glyphs are dropped to make room for new ones. Only the glyphs of the
+// text given to the latest Prepare() can go beyond the limit. Texts that
+// together need more glyphs than the limit rebuild the font on every switch.
+//
+// Example:
+//   LazyFont lazy;
+//   lazy.Open("fonts/unifont.bdf");
+//   lazy.Prepare(text);
+//   DrawText(canvas, lazy.font(), x, y, color, NULL, text);
+//
+// Glyph loading happens in Prepare(), so the font reference is only good
+// until the next call to Prepare() that returns 'true'. If you keep laid out
+// text in a TextRunCache, Clear() it then.
+class LazyFont {
+public:
+  // "max_glyphs" is the maximum number of glyphs to keep decoded or 0 for
+  // no limit.
+  explicit LazyFont(int max_glyphs = 0);
+  ~LazyFont();
+
+  // Build the index of the given BDF font file. Returns 'false' if the file
+  // can not be read or does not look like a BDF font.
+  bool Open(const char *path);
+
+  // Make sure that all characters of "utf8_text" are decoded. Characters that
+  // are not in the font are replaced by the replacement character by
+  // DrawText() as usual.
+  // Returns 'true' if the set of decoded glyphs changed and with it the
+  // Font returned by font().
+  bool Prepare(const char *utf8_text);
+
+  // The font containing at least the glyphs for the text given in the last
+  // call to Prepare().
+  const Font &font() const { return *font_; }
+
+  // Number of glyphs in the file and number of glyphs currently decoded.
+  int glyph_count() const { return (int)index_.size(); }
+  int loaded_glyph_count() const { return (int)loaded_.size(); }
+
+private:
+  LazyFont(const LazyFont&);  // No copy.
+
+  struct IndexEntry {
+    uint32_t codepoint;
+    uint32_t offset;   // Start of STARTCHAR line in file.
+    uint32_t length;   // Up to and including ENDCHAR line.
+    bool operator<(const IndexEntry &other) const {
+      return codepoint < other.codepoint;
+    }
+  };
+
+  const IndexEntry *FindEntry(uint32_t codepoint) const;
+  bool Rebuild();
+
+  const size_t max_glyphs_;
+  int fd_;
+  std::string header_;             // Everything before the first glyph.
+  std::vector<IndexEntry> index_;  // Sorted by codepoint.
+  std::map<uint32_t, uint64_t> loaded_;  // codepoint -> last use.
+  uint64_t use_counter_;
+  Font *font_;
+};
+
 // -- Some utility functions.
 
 // Utility function: set an image from the given buffer containting pixels.
@@ -121,6 +201,85 @@ int DrawText(Canvas *c, const Font &font, int x, int y,
 int DrawText(Canvas *c, const Font &font, int x, int y, const Color &color,
              const char *utf8_text);
 
+// Return how many pixels DrawText() would advance on the screen for the
+// given "utf8_text" with "font" and "kerning_offset", without drawing
+// anything. Useful to center or right-align text, or to place the next field
+// after it.
+int MeasureText(const Font &font, const char *utf8_text,
+                int kerning_offset = 0);
+
+// A small least-recently-used cache of laid-out text runs.
+//
+// Layouts typically draw the same handful of strings over and over
+// ("72°F Clouds", the current time). DrawText() decodes the UTF-8 and looks
+// up each glyph in the font every time. The TextRunCache does that once per
+// (font, text, kerning) and keeps the x-advance of each character together
+// with the resulting pixel mask, so drawing a cached run is a plain loop over
+// pixels.
+//
+// Fonts are identified by their address, so call Clear() if you delete
+// a font and create another one that might end up at the same address.
+// Not thread-safe; use one cache per drawing thread.
+class TextRunCache {
+public:
+  // Create cache that keeps at most "max_runs" runs.
+  explicit TextRunCache(int max_runs = 32);
+  ~TextRunCache();
+
+  // Same as the free function MeasureText(), but remembers the result.
+  int MeasureText(const Font &font, const char *utf8_text,
+                  int kerning_offset = 0);
+
+  // Same as the free function DrawText() with identical output on the
+  // canvas. The first call for a particular text lays it out, subsequent
+  // calls only copy pixels.
+  // Returns how many pixels we advanced on the screen.
+  int DrawText(Canvas *c, const Font &font, int x, int y,
+               const Color &color, const Color *background_color,
+               const char *utf8_text, int kerning_offset = 0);
+
+  // Same as the free function DrawTextOutlined(). The combined fill and
+  // outline mask is computed once per cached text.
+  int DrawTextOutlined(Canvas *c, const Font &font, int x, int y,
+                       const Color &color, const Color &outline_color,
+                       const char *utf8_text, int kerning_offset = 0);
+
+  // Get x-position of each character relative to the start of the text,
+  // as DrawText() would place them. Returns number of characters.
+  int GetCharacterOffsets(const Font &font, const char *utf8_text,
+                          int kerning_offset, std::vector<int> *offsets);
+
+  // Forget all cached runs.
+  void Clear();
+
+  int size() const { return (int)lru_.size(); }
+
+private:
+  TextRunCache(const TextRunCache&);  // No copy.
+
+  struct Run;
+  typedef std::list<Run*> RunList;
+
+  Run *FindOrCreate(const Font &font, const char *utf8_text,
+                    int kerning_offset);
+
+  const size_t max_runs_;
+  RunList lru_;   // Most recently used first.
+  std::map<std::string, RunList::iterator> index_;
+};
+
+// Draw text like DrawText() with a one pixel "outline_color" frame around
+// each letter, e.g. to increase contrast against a busy background.
+//
+// Produces the same result as first drawing the text with the font returned
+// by CreateOutlineFont() at x-1 with two pixels less kerning, then the regular
+// text on top, but without needing the second font, with a single glyph
+// lookup per character and writing each pixel only once.
+// Returns how many pixels we advanced on the screen.
+int DrawTextOutlined(Canvas *c, const Font &font, int x, int y,
+                     const Color &color, const Color &outline_color,
+                     const char *utf8_text, int kerning_offset = 0);
+
 // Draw text, a standard NUL terminated C-string encoded in UTF-8,
 // with given "font" at "x","y" with "color".
 // Draw text as above, but vertically (top down).
@@ -0,0 +1,111 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Replace a running display program with a new version of it without the
+// panel going dark for more than a few milliseconds.
+//
+// The running program listens on a Unix socket. The new program connects
+// before it touches the GPIO and receives the frame currently shown, its
+// brightness and PWM settings and whatever application state the old
+// program wants to pass on; the frame comes in shared memory handed over
+// with SCM_RIGHTS. While the new program prepares, the old one keeps
+// refreshing the panel. Then the new program releases the old one, which
+// exits without clearing the panel, creates its matrix and shows the
+// received frame until its own first frame is ready:
+//
+//   rgb_matrix::HandoffClient handoff;
+//   const bool upgrade = handoff.Receive("/run/sign.sock", 1000);
+//   ...load fonts, restore state from handoff.app_state()...
+//   if (upgrade && !handoff.Release(5000)) ...
+//   RGBMatrix *matrix = RGBMatrix::CreateFromOptions(...);
+//   if (upgrade && handoff.Restore(offscreen))
+//     offscreen = matrix->SwapOnVSync(offscreen);
+//
+//   rgb_matrix::HandoffServer server;
+//   server.Listen("/run/sign.sock");
+//   ...whenever server.fd() is readable:
+//   server.HandOver(shown_canvas, app_state);  // Only returns on failure.
+
+#ifndef RPI_HANDOFF_H
+#define RPI_HANDOFF_H
+
+#include <stdint.h>
+
+#include <string>
+
+#include "led-matrix.h"
+
+namespace rgb_matrix {
+// Old program: hands the panel over to a successor.
+class HandoffServer {
+public:
+  HandoffServer();
+  ~HandoffServer();  // Removes the socket.
+
+  // Listen on Unix socket "socket_path", replacing a stale socket file.
+  // Returns false and sets errno on failure.
+  bool Listen(const char *socket_path);
+
+  // Becomes readable when a successor connects; for poll() or event loops.
+  int fd() const { return listen_fd_; }
+
+  // Hand "shown", the frame currently on the panel, and "app_state" over
+  // to a connecting successor. Once the successor releases us, this exits
+  // the process right away with _exit(0): no destructors run, so the
+  // panel is not cleared. Returns false if no successor was waiting or it
+  // gave up; the program then simply keeps running.
+  bool HandOver(FrameCanvas *shown, const std::string &app_state);
+
+private:
+  int listen_fd_;
+  std::string path_;
+};
+
+// New program: takes the panel over from a predecessor.
+class HandoffClient {
+public:
+  HandoffClient();
+  ~HandoffClient();
+
+  // Connect to a predecessor at "socket_path" and receive its state.
+  // Returns false if nobody is listening there (first start) or the
+  // predecessor did not answer within "timeout_ms".
+  bool Receive(const char *socket_path, int timeout_ms);
+
+  // State passed to HandoffServer::HandOver().
+  const std::string &app_state() const { return app_state_; }
+
+  // Let the predecessor exit and wait until it is gone, so that the GPIO
+  // is free for our own matrix. Returns false on timeout.
+  bool Release(int timeout_ms);
+
+  // Load the received frame and its settings into "canvas", which has to
+  // be off-screen. Returns false if the matrix geometry is different.
+  bool Restore(FrameCanvas *canvas);
+
+  // Time since the predecessor stopped refreshing. Right after the first
+  // swap, this is how long the panel was dark.
+  int64_t NanosSinceRelease() const;
+
+private:
+  int fd_;
+  std::string frame_;
+  std::string app_state_;
+  int brightness_, pwm_bits_;
+  bool luminance_correct_;
+  int64_t released_ns_;
+};
+}  // namespace rgb_matrix
+
+#endif  // RPI_HANDOFF_H
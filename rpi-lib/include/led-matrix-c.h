@@ -38,6 +38,8 @@ extern "C" {
 struct RGBLedMatrix;
 struct LedCanvas;
 struct LedFont;
+struct LedTextRunCache;
+struct LedAnimation;
 
 /**
  * Parameters to create a new matrix.
@@ -359,6 +361,58 @@ struct LedCanvas *led_matrix_swap_on_vsync(struct RGBLedMatrix *matrix,
 uint8_t led_matrix_get_brightness(struct RGBLedMatrix *matrix);
 void led_matrix_set_brightness(struct RGBLedMatrix *matrix, uint8_t brightness);
 
+/*** Animations of pre-rendered frames, played on their own thread. ***/
+
+enum LedAnimationMode {
+  LED_ANIMATION_LOOP,       /* 0, 1, ... n-1, 0, 1, ... */
+  LED_ANIMATION_PING_PONG,  /* 0, 1, ... n-1, n-2, ... 1, 0, 1, ... */
+  LED_ANIMATION_ONCE        /* 0, 1, ... n-1, then the last frame stays. */
+};
+
+/**
+ * Create an animation player. Draw each frame once into the canvas
+ * returned by led_animation_add_frame(), then led_animation_start(); the
+ * player then swaps the frames on vsync on its own, with no drawing or
+ * sleeping in the caller:
+ *
+ *   struct LedAnimation *anim = led_animation_create(matrix);
+ *   for (...each frame...) {
+ *     struct LedCanvas *frame = led_animation_add_frame(anim, delay_us);
+ *     led_canvas_set_pixels(frame, ...);
+ *   }
+ *   led_animation_start(anim);
+ *
+ * Don't swap canvases yourself while it plays.
+ */
+struct LedAnimation *led_animation_create(struct RGBLedMatrix *matrix);
+
+/** Stop and delete the player. The frame canvases stay with the matrix. */
+void led_animation_delete(struct LedAnimation *animation);
+
+/**
+ * Add a frame to be shown for "hold_time_us" microseconds. Returns the
+ * canvas to draw it on; ownership stays with the matrix. Returns NULL while
+ * playing.
+ */
+struct LedCanvas *led_animation_add_frame(struct LedAnimation *animation,
+                                          uint32_t hold_time_us);
+
+/** Default is LED_ANIMATION_LOOP. Takes effect with the next start. */
+void led_animation_set_mode(struct LedAnimation *animation,
+                            enum LedAnimationMode mode);
+
+/** Start from the first frame. False if there are no frames or playing. */
+bool led_animation_start(struct LedAnimation *animation);
+
+/**
+ * Stop playing. The frame shown last stays on the panel, in the canvas
+ * that was there before the start, so your own canvases stay valid.
+ */
+void led_animation_stop(struct LedAnimation *animation);
+
+/** False once stopped or after the last frame in LED_ANIMATION_ONCE. */
+bool led_animation_is_playing(struct LedAnimation *animation);
+
 // Utility function: set an image from the given buffer containting pixels.
 //
 // Draw image of size "image_width" and "image_height" from pixel at
@@ -408,6 +462,38 @@ int vertical_draw_text(struct LedCanvas *c, struct LedFont *font, int x, int y,
                        uint8_t r, uint8_t g, uint8_t b,
                        const char *utf8_text, int kerning_offset);
 
+// Draw text with a one pixel outline in the outline color around each
+// letter. Same result as drawing with create_outline_font() first and the
+// regular font on top, but in a single pass and without the second font.
+int draw_text_outlined(struct LedCanvas *c, struct LedFont *font, int x, int y,
+                       uint8_t r, uint8_t g, uint8_t b,
+                       uint8_t outline_r, uint8_t outline_g, uint8_t outline_b,
+                       const char *utf8_text, int kerning_offset);
+
+// Returns how many pixels draw_text() would advance for the given text,
+// without drawing anything.
+int measure_text(struct LedFont *font, const char *utf8_text,
+                 int kerning_offset);
+
+// Create a cache of laid-out text runs that keeps up to "max_runs" of the
+// most recently drawn texts. Repeatedly drawing the same text through the
+// cache avoids decoding and glyph lookups. Fonts used with the cache need
+// to stay alive as long as the cache is used.
+struct LedTextRunCache *create_text_run_cache(int max_runs);
+
+// Delete a cache created with create_text_run_cache().
+void delete_text_run_cache(struct LedTextRunCache *cache);
+
+// Same as measure_text(), but remembers the result in the cache.
+int measure_text_cached(struct LedTextRunCache *cache, struct LedFont *font,
+                        const char *utf8_text, int kerning_offset);
+
+// Same output as draw_text(), but using the cache.
+int draw_text_cached(struct LedTextRunCache *cache,
+                     struct LedCanvas *c, struct LedFont *font, int x, int y,
+                     uint8_t r, uint8_t g, uint8_t b,
+                     const char *utf8_text, int kerning_offset);
+
 void draw_circle(struct LedCanvas *c, int x, int y, int radius,
                  uint8_t r, uint8_t g, uint8_t b);
 
@@ -236,6 +236,8 @@ public:
   // 28Hz animation, nicely locked to the refresh-rate).
   // If you combine this with Options::limit_refresh_rate_hz you can create
   // time-correct animations.
+  //
+  // To draw the next frame while this one waits, see swap-queue.h
   FrameCanvas *SwapOnVSync(FrameCanvas *other, unsigned framerate_fraction = 1);
 
   // -- Setting shape and behavior of matrix.
@@ -0,0 +1,137 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Counters, gauges and histograms in Prometheus text format, served over
+// HTTP from a background thread.
+//
+//   rgb_matrix::Metrics metrics;
+//   rgb_matrix::Counter *frames = metrics.AddCounter("rgbmatrix_frames_total",
+//                                                    "Frames shown.");
+//   metrics.Serve("9100");   // curl 127.0.0.1:9100/metrics
+//   ...
+//   frames->Increment();
+//
+// Updating a metric is a relaxed atomic operation without locks, so it
+// can be done in the render loop.
+
+#ifndef RPI_METRICS_H
+#define RPI_METRICS_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "thread.h"
+
+namespace rgb_matrix {
+class Metric {
+public:
+  virtual ~Metric() {}
+
+  // Append this metric in Prometheus text format.
+  virtual void AppendTo(std::string *out) const = 0;
+
+protected:
+  Metric(const char *name, const char *help) : name_(name), help_(help) {}
+  void AppendHeader(const char *type, std::string *out) const;
+
+  const std::string name_;
+  const std::string help_;
+};
+
+// Monotonically increasing count. Name should end in _total.
+class Counter : public Metric {
+public:
+  Counter(const char *name, const char *help)
+    : Metric(name, help), value_(0) {}
+
+  void Increment(uint64_t n = 1) {
+    value_.fetch_add(n, std::memory_order_relaxed);
+  }
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+  void AppendTo(std::string *out) const;
+
+private:
+  std::atomic<uint64_t> value_;
+};
+
+// A value that can go up and down, such as a timestamp.
+class Gauge : public Metric {
+public:
+  Gauge(const char *name, const char *help);
+
+  void Set(double value);
+  double value() const;
+
+  void AppendTo(std::string *out) const;
+
+private:
+  std::atomic<uint64_t> bits_;  // double, as std::atomic<double> can't add.
+};
+
+// Distribution of durations, exported in seconds.
+class Histogram : public Metric {
+public:
+  // "bucket_bounds" are the upper bounds of the buckets in seconds, in
+  // increasing order. A final +Inf bucket is implicit.
+  Histogram(const char *name, const char *help,
+            const std::vector<double> &bucket_bounds);
+
+  void ObserveNanos(int64_t nanoseconds);
+
+  void AppendTo(std::string *out) const;
+
+private:
+  std::vector<int64_t> bounds_ns_;
+  std::vector<std::atomic<uint64_t> > buckets_;  // Not cumulative.
+  std::atomic<uint64_t> count_;
+  std::atomic<int64_t> sum_ns_;
+};
+
+// Registry of metrics, which it owns.
+class Metrics {
+public:
+  Metrics();
+  ~Metrics();
+
+  Counter *AddCounter(const char *name, const char *help);
+  Gauge *AddGauge(const char *name, const char *help);
+  Histogram *AddHistogram(const char *name, const char *help,
+                          const std::vector<double> &bucket_bounds);
+
+  // All metrics in Prometheus text format.
+  std::string Format() const;
+
+  // Serve the metrics at "/metrics" on "address", which is a "port",
+  // "host:port", "[ipv6-host]:port" or "unix:/path/to/socket". Without
+  // host, only listens on 127.0.0.1; "0.0.0.0:port" or "[::]:port" listen
+  // on all interfaces. Returns false with errno set if listening failed.
+  bool Serve(const char *address);
+
+private:
+  class Server;
+
+  Metric *Add(Metric *metric);
+
+  mutable Mutex mutex_;
+  std::vector<Metric*> metrics_;
+  Server *server_;
+};
+
+}  // namespace rgb_matrix
+
+#endif  // RPI_METRICS_H
@@ -0,0 +1,52 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+
+// A plain RGB24 image to draw into, e.g. for frames that are sent over the
+// network (frame-distribution.h) or blended (transitions.h) before they go
+// to a FrameCanvas.
+
+#ifndef RPI_RGB_BUFFER_H
+#define RPI_RGB_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "canvas.h"
+
+namespace rgb_matrix {
+class RGBBuffer : public Canvas {
+public:
+  RGBBuffer(int width, int height);
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  void SetPixel(int x, int y, uint8_t red, uint8_t green, uint8_t blue);
+  void Clear();
+  void Fill(uint8_t red, uint8_t green, uint8_t blue);
+
+  // Rows of 3 * width() bytes, top to bottom.
+  const uint8_t *data() const { return &pixels_[0]; }
+  uint8_t *data() { return &pixels_[0]; }
+  size_t size() const { return pixels_.size(); }
+
+private:
+  const int width_, height_;
+  std::vector<uint8_t> pixels_;
+};
+}  // namespace rgb_matrix
+
+#endif  // RPI_RGB_BUFFER_H
@@ -0,0 +1,82 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Drawing images rotated, scaled and moved.
+//
+// The transformation maps sprite coordinates to canvas coordinates. For each
+// canvas pixel it covers, the position in the sprite is stepped in fixed
+// point; only the part of each row inside the sprite is visited. Rows go to
+// a FrameCanvas with SetPixels(), to other canvases pixel by pixel.
+//
+//   // A 32x32 logo, spinning around its center at 40,16.
+//   rgb_matrix::Sprite logo(logo_rgba, 32, 32, rgb_matrix::Sprite::RGBA);
+//   rgb_matrix::AffineTransform t;
+//   t.Translate(-16, -16).Rotate(angle).Translate(40, 16);
+//   rgb_matrix::DrawSprite(canvas, logo, t);
+
+#ifndef RPI_SPRITE_H
+#define RPI_SPRITE_H
+
+#include <stdint.h>
+
+#include "canvas.h"
+
+namespace rgb_matrix {
+// x' = a * x + b * y + tx
+// y' = c * x + d * y + ty
+struct AffineTransform {
+  AffineTransform() : a(1), b(0), c(0), d(1), tx(0), ty(0) {}  // Identity.
+
+  // Each of these is applied after the transformation so far.
+  AffineTransform &Translate(float dx, float dy);
+  AffineTransform &Scale(float sx, float sy);
+  AffineTransform &Rotate(float radians);  // Clockwise, as y points down.
+
+  // Returns false if there is no inverse, e.g. when scaled by 0.
+  bool Invert(AffineTransform *inverse) const;
+
+  float a, b, c, d, tx, ty;
+};
+
+// Pixels of an image, not copied; they have to stay valid while drawing.
+struct Sprite {
+  enum Format {
+    RGB,   // 3 bytes per pixel.
+    RGBA,  // 4 bytes per pixel; pixels less than half opaque are not drawn.
+  };
+
+  // Rows are "stride" bytes apart; 0 is for rows without gaps.
+  Sprite(const uint8_t *pixels, int width, int height,
+         Format format = RGB, int stride = 0)
+    : pixels(pixels), width(width), height(height), format(format),
+      stride(stride ? stride : width * (format == RGBA ? 4 : 3)) {}
+
+  const uint8_t *pixels;
+  int width, height;
+  Format format;
+  int stride;
+};
+
+enum SpriteSampling {
+  SAMPLE_NEAREST,   // Crisp, fastest.
+  SAMPLE_BILINEAR,  // Smooth, for rotating and scaling photos and icons.
+};
+
+// Draw "sprite" transformed by "transform", clipped to the canvas.
+void DrawSprite(Canvas *c, const Sprite &sprite,
+                const AffineTransform &transform,
+                SpriteSampling sampling = SAMPLE_BILINEAR);
+}  // namespace rgb_matrix
+
+#endif  // RPI_SPRITE_H
@@ -0,0 +1,128 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Non-blocking SwapOnVSync().
+//
+// RGBMatrix::SwapOnVSync() returns only after the next vsync, so a program
+// can't draw the next frame while the current one waits to be shown. The
+// SwapQueue does the swapping in its own thread: Submit() queues a frame
+// and returns right away with a fence that tells when it was shown.
+//
+//   rgb_matrix::SwapQueue queue(matrix);   // Triple buffering.
+//   for (;;) {
+//     rgb_matrix::FrameCanvas *frame = queue.Acquire();
+//     ...draw the whole frame...
+//     queue.Submit(frame);
+//   }
+//
+// Frames handed out by Acquire() might contain any earlier frame, so draw
+// all of it.
+
+#ifndef RPI_SWAP_QUEUE_H
+#define RPI_SWAP_QUEUE_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+#include "led-matrix.h"
+
+namespace rgb_matrix {
+class SwapQueue {
+public:
+  enum Policy {
+    BLOCK,        // Acquire() waits until a queued frame was shown.
+    DROP_OLDEST,  // Acquire() takes back the oldest frame not shown yet.
+  };
+
+  enum FenceStatus {
+    PENDING,
+    PRESENTED,
+    DROPPED,      // Taken back by DROP_OLDEST, or never shown on shutdown.
+  };
+
+  typedef uint64_t Fence;
+
+  // "depth" is the number of frames that can wait to be shown, in addition
+  // to the one on the panel and the one being drawn; 1 is triple
+  // buffering. Does not take ownership of the matrix, which has to outlive
+  // the queue; don't call SwapOnVSync() on it while the queue exists.
+  explicit SwapQueue(RGBMatrix *matrix, int depth = 1, Policy policy = BLOCK);
+  ~SwapQueue();  // Frames not shown yet are dropped.
+
+  // A canvas to draw the next frame on. Waits, if there is none free and
+  // the policy is BLOCK or nothing is queued.
+  FrameCanvas *Acquire();
+
+  // Queue a frame from Acquire() to be shown "framerate_fraction" refreshes
+  // after the previous one, as with SwapOnVSync(). If "present_at_nanos"
+  // is set, it is not shown before that time on CLOCK_MONOTONIC.
+  // Returns immediately.
+  Fence Submit(FrameCanvas *frame, unsigned framerate_fraction = 1,
+               int64_t present_at_nanos = 0);
+
+  // Whether the frame was shown. If PRESENTED and "presented_nanos" is not
+  // NULL, it is set to the CLOCK_MONOTONIC time it went on the panel.
+  // Only the latest fences are remembered, older ones report PRESENTED
+  // with a time of 0.
+  FenceStatus Status(Fence fence, int64_t *presented_nanos = NULL);
+
+  // Wait for the fence to leave PENDING, at most "timeout_ms" if >= 0.
+  FenceStatus Wait(Fence fence, long timeout_ms = -1,
+                   int64_t *presented_nanos = NULL);
+
+  // Wait until all submitted frames are shown or dropped.
+  void Flush();
+
+  struct Stats {
+    int presented;
+    int dropped;
+    int64_t acquire_wait_nanos;  // Time the producer waited in Acquire().
+  };
+  // Stats since the last call.
+  Stats TakeStats();
+
+private:
+  class Presenter;
+
+  struct Pending {
+    FrameCanvas *frame;
+    Fence fence;
+    unsigned framerate_fraction;
+    int64_t present_at_nanos;
+  };
+
+  struct Record {
+    Fence fence;
+    FenceStatus status;
+    int64_t presented_nanos;
+  };
+
+  Record *FindRecord(Fence fence);
+  void Complete(Fence fence, FenceStatus status, int64_t presented_nanos);
+
+  const Policy policy_;
+  Presenter *presenter_;
+
+  // All below guarded by the presenter's mutex.
+  std::vector<FrameCanvas*> free_;
+  std::deque<Pending> queue_;
+  std::vector<Record> history_;  // Ring buffer, indexed by fence.
+  Fence last_fence_;
+  Stats stats_;
+};
+}  // namespace rgb_matrix
+
+#endif  // RPI_SWAP_QUEUE_H
@@ -0,0 +1,97 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Temporal dithering: more color depth than the PWM bits give.
+//
+// Fewer --led-pwm-bits give a higher refresh rate, but gradients start to
+// show steps, in particular in the dark. A DitherCanvas is drawn on like
+// any other canvas; Show() renders the image into 2^extra_bits sub-frames
+// and a thread swaps in the next one on every refresh. Each pixel
+// alternates between the two nearest levels the PWM bits can show, in the
+// proportion that averages to the exact brightness: with 7 PWM bits and
+// 3 extra bits, gradients look like 10 bits at the refresh rate of 7.
+//
+//   rgb_matrix::DitherCanvas canvas(matrix);
+//   ...draw on canvas...
+//   canvas.Show();
+//
+// Don't call SwapOnVSync() on the matrix while showing.
+
+#ifndef RPI_TEMPORAL_DITHER_H
+#define RPI_TEMPORAL_DITHER_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "canvas.h"
+#include "led-matrix.h"
+
+namespace rgb_matrix {
+class DitherCanvas : public Canvas {
+public:
+  struct Options {
+    Options();  // Creates a default option set.
+
+    // Perceived depth is the PWM bits (at most 8) plus these. 0..4.
+    // Default 3.
+    int extra_bits;
+
+    // The flicker budget: all sub-frames are shown at least this many
+    // times per second. If the refresh rate is too low for that, fewer
+    // extra bits are used. Default 100.
+    int min_cycle_hz;
+  };
+
+  // Does not take ownership of the matrix, which has to outlive the canvas.
+  // Measures the refresh rate, which takes a few refreshes.
+  explicit DitherCanvas(RGBMatrix *matrix,
+                        const Options &options = Options());
+  ~DitherCanvas();  // Stops showing.
+
+  // Canvas interface. Colors are mapped with the CIE1931 profile and the
+  // brightness of the matrix, like on other canvases.
+  virtual int width() const { return width_; }
+  virtual int height() const { return height_; }
+  virtual void SetPixel(int x, int y,
+                        uint8_t red, uint8_t green, uint8_t blue);
+  virtual void Clear();
+  virtual void Fill(uint8_t red, uint8_t green, uint8_t blue);
+
+  // Show what is drawn right now; it stays until the next Show(). Returns
+  // once the new image is on the panel.
+  void Show();
+
+  // Stop swapping. The panel keeps showing the last sub-frame.
+  void Stop();
+
+  // Extra bits in use after applying the flicker budget.
+  int extra_bits() const { return extra_bits_; }
+
+private:
+  class Cycler;
+
+  void Render();  // Into back_.
+
+  RGBMatrix *const matrix_;
+  const int width_, height_;
+  int extra_bits_;
+  std::vector<uint8_t> pixels_;  // RGB, as drawn.
+  std::vector<FrameCanvas*> back_;   // Sub-frames Show() renders into.
+  std::vector<FrameCanvas*> spare_;  // The other set, while not showing.
+  Cycler *cycler_;
+};
+}  // namespace rgb_matrix
+
+#endif  // RPI_TEMPORAL_DITHER_H
@@ -0,0 +1,84 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Static tracepoints (USDT) in provider "rgbmatrix", for bpftrace or perf
+// on a running program, without rebuilding it. A probe is a nop until a
+// tracer attaches. Durations are only measured while a tracer is attached
+// to the probe, as told by its semaphore.
+//
+// They are compiled in whenever <sys/sdt.h> is available
+// (apt-get install systemtap-sdt-dev); define RGB_MATRIX_NO_PROBES to leave
+// them out. Durations are in nanoseconds.
+//
+//   swap_start(frame, framerate_fraction)    EventLoop, before SwapOnVSync()
+//   swap_done(frame, wait_ns)                ... after SwapOnVSync() returned
+//   draw_text(bytes, advance, duration_ns)   DrawText() and friends
+//
+// List them with
+//   bpftrace -l 'usdt:./clock-weather:rgbmatrix:*'
+// See utils/frame-latency.bt for an example.
+
+#ifndef RPI_TRACE_PROBES_H
+#define RPI_TRACE_PROBES_H
+
+#include <stdint.h>
+#include <time.h>
+
+#if !defined(RGB_MATRIX_NO_PROBES) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    define _SDT_HAS_SEMAPHORES 1
+#    include <sys/sdt.h>
+#    define RGB_MATRIX_PROBES_ENABLED 1
+#  endif
+#endif
+
+// Set by the tracer while it is attached; defined in lib/trace-probes.cc.
+extern volatile unsigned short rgbmatrix_swap_start_semaphore;
+extern volatile unsigned short rgbmatrix_swap_done_semaphore;
+extern volatile unsigned short rgbmatrix_draw_text_semaphore;
+
+#ifdef RGB_MATRIX_PROBES_ENABLED
+#  define RGB_MATRIX_PROBE_ENABLED(name) \
+  __builtin_expect(rgbmatrix_##name##_semaphore != 0, 0)
+#  define RGB_MATRIX_PROBE1(name, a) DTRACE_PROBE1(rgbmatrix, name, a)
+#  define RGB_MATRIX_PROBE2(name, a, b) DTRACE_PROBE2(rgbmatrix, name, a, b)
+#  define RGB_MATRIX_PROBE3(name, a, b, c) \
+  DTRACE_PROBE3(rgbmatrix, name, a, b, c)
+#else
+#  define RGB_MATRIX_PROBE_ENABLED(name) 0
+// Arguments are not evaluated, but count as used.
+#  define RGB_MATRIX_PROBE1(name, a) do { (void)sizeof(a); } while (0)
+#  define RGB_MATRIX_PROBE2(name, a, b) \
+  do { (void)sizeof(a); (void)sizeof(b); } while (0)
+#  define RGB_MATRIX_PROBE3(name, a, b, c) \
+  do { (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); } while (0)
+#endif
+
+// Start of a duration for probe "name"; 0 if no tracer is attached, then
+// the probe is skipped at the end, too.
+#define RGB_MATRIX_PROBE_START_NS(name) \
+  (RGB_MATRIX_PROBE_ENABLED(name) ? rgb_matrix::probes::NowNs() : 0)
+
+namespace rgb_matrix {
+namespace probes {
+// Monotonic timestamp for probe durations.
+inline int64_t NowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+}  // namespace probes
+}  // namespace rgb_matrix
+
+#endif  // RPI_TRACE_PROBES_H
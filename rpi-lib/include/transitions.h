@@ -0,0 +1,87 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Transitions between two images: crossfade, wipe, slide and dissolve.
+//
+// Both images are RGB24, e.g. drawn into an RGBBuffer. Each frame of the
+// transition is blended 16 bytes at a time and written into the
+// FrameCanvas with a single SetPixels():
+//
+//   rgb_matrix::Transition fade(rgb_matrix::Transition::CROSSFADE,
+//                               clock_screen, forecast_screen);
+//   for (int i = 1; i <= 30; ++i) {
+//     fade.Render(i / 30.0f, offscreen);
+//     offscreen = matrix->SwapOnVSync(offscreen);
+//   }
+
+#ifndef RPI_TRANSITIONS_H
+#define RPI_TRANSITIONS_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "graphics.h"
+#include "led-matrix.h"
+#include "rgb-buffer.h"
+
+namespace rgb_matrix {
+class Transition {
+public:
+  enum Type {
+    CROSSFADE,
+    WIPE_LEFT,    // The edge moves to the left, uncovering "to".
+    WIPE_RIGHT,
+    WIPE_UP,
+    WIPE_DOWN,
+    SLIDE_LEFT,   // "to" pushes "from" out to the left.
+    SLIDE_RIGHT,
+    SLIDE_UP,
+    SLIDE_DOWN,
+    DISSOLVE,     // Pixels switch over one by one, in random order.
+  };
+
+  // "from" and "to" are "width" x "height" RGB24 pixels, rows of 3 * width
+  // bytes. They are not copied; they have to stay valid and can change
+  // between frames.
+  Transition(Type type, int width, int height,
+             const uint8_t *from, const uint8_t *to);
+  // Buffers of the same size. If they differ, this is a cut to "to": every
+  // frame is "to".
+  Transition(Type type, const RGBBuffer &from, const RGBBuffer &to);
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  // Blend the frame at "progress" from 0.0 ("from") to 1.0 ("to") and
+  // return it; valid until the next call.
+  const uint8_t *Blend(float progress);
+
+  // Blend and write the frame into "canvas" at "x", "y".
+  void Render(float progress, FrameCanvas *canvas, int x = 0, int y = 0);
+
+private:
+  void Wipe(int edge);
+  void Slide(int offset);
+
+  const Type type_;
+  const int width_, height_;
+  const uint8_t *const from_;
+  const uint8_t *const to_;
+  std::vector<Color> frame_;
+  std::vector<uint8_t> dissolve_order_;  // Per byte, when it switches.
+};
+}  // namespace rgb_matrix
+
+#endif  // RPI_TRANSITIONS_H
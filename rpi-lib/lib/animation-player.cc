@@ -0,0 +1,182 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "animation-player.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#include "led-matrix-c.h"
+#include "thread.h"
+
+namespace rgb_matrix {
+namespace {
+static int64_t NowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+}  // namespace
+
+// Swaps the frames; sleeps in between on a condition, so that Stop()
+// doesn't have to wait for a long hold time to pass.
+class AnimationPlayer::Timer : public Thread {
+public:
+  Timer(RGBMatrix *matrix, Mode mode, const std::vector<FrameCanvas*> &frames,
+        const std::vector<uint32_t> &hold_times_us)
+    : matrix_(matrix), mode_(mode), frames_(frames),
+      hold_times_us_(hold_times_us), before_(NULL), shown_(NULL),
+      stopping_(false), playing_(true) {
+    pthread_cond_init(&wake_, NULL);
+  }
+
+  ~Timer() {
+    {
+      MutexLock l(&mutex_);
+      stopping_ = true;
+      pthread_cond_signal(&wake_);
+    }
+    WaitStopped();
+    pthread_cond_destroy(&wake_);
+
+    // Put the canvas from before Start() back on the panel, with the last
+    // frame copied in. The caller's canvases are then as they were, and
+    // its next SwapOnVSync() doesn't return one of our frames.
+    if (before_ != NULL) {
+      before_->CopyFrom(*shown_);
+      matrix_->SwapOnVSync(before_);
+    }
+  }
+
+  bool playing() {
+    MutexLock l(&mutex_);
+    return playing_;
+  }
+
+  void Run() final {
+    const int n = (int)frames_.size();
+    int i = 0;
+    int step = 1;
+    int64_t due = NowNanos();  // When frame i is to be shown.
+    MutexLock l(&mutex_);
+    while (!stopping_) {
+      mutex_.Unlock();
+      FrameCanvas *const previous = matrix_->SwapOnVSync(frames_[i]);
+      mutex_.Lock();
+      if (before_ == NULL) before_ = previous;
+      shown_ = frames_[i];
+      if (mode_ == ONCE && i == n - 1) break;
+      if (n == 1) {
+        while (!stopping_) mutex_.WaitOn(&wake_);
+        break;
+      }
+
+      // Fixed schedule, so that the vsync wait doesn't add up; but don't
+      // rush through frames to catch up after falling behind.
+      due += hold_times_us_[i] * 1000LL;
+      const int64_t now = NowNanos();
+      if (due < now) due = now;
+      int64_t left;
+      while (!stopping_ && (left = due - NowNanos()) > 0)
+        mutex_.WaitOn(&wake_, (left + 999999) / 1000000);
+
+      if (mode_ == PING_PONG && (i + step < 0 || i + step >= n))
+        step = -step;
+      i = (mode_ == LOOP) ? (i + 1) % n : i + step;
+    }
+    playing_ = false;
+  }
+
+private:
+  RGBMatrix *const matrix_;
+  const Mode mode_;
+  const std::vector<FrameCanvas*> frames_;
+  const std::vector<uint32_t> hold_times_us_;
+  FrameCanvas *before_;  // On the panel before the first swap.
+  FrameCanvas *shown_;
+
+  Mutex mutex_;
+  pthread_cond_t wake_;
+  bool stopping_;
+  bool playing_;
+};
+
+AnimationPlayer::AnimationPlayer(RGBMatrix *matrix)
+  : matrix_(matrix), mode_(LOOP), timer_(NULL) {}
+
+AnimationPlayer::~AnimationPlayer() { Stop(); }
+
+FrameCanvas *AnimationPlayer::AddFrame(uint32_t hold_time_us) {
+  if (IsPlaying()) return NULL;
+  FrameCanvas *frame = matrix_->CreateFrameCanvas();
+  frames_.push_back(frame);
+  hold_times_us_.push_back(hold_time_us);
+  return frame;
+}
+
+bool AnimationPlayer::Start() {
+  if (frames_.empty() || IsPlaying()) return false;
+  Stop();  // Done with ONCE; clean up before starting over.
+  timer_ = new Timer(matrix_, mode_, frames_, hold_times_us_);
+  timer_->Start();
+  return true;
+}
+
+void AnimationPlayer::Stop() {
+  delete timer_;
+  timer_ = NULL;
+}
+
+bool AnimationPlayer::IsPlaying() const {
+  return timer_ != NULL && timer_->playing();
+}
+}  // namespace rgb_matrix
+
+// -- C-API
+static rgb_matrix::AnimationPlayer *to_player(struct LedAnimation *a) {
+  return reinterpret_cast<rgb_matrix::AnimationPlayer*>(a);
+}
+
+struct LedAnimation *led_animation_create(struct RGBLedMatrix *matrix) {
+  return reinterpret_cast<struct LedAnimation*>(
+    new rgb_matrix::AnimationPlayer(
+      reinterpret_cast<rgb_matrix::RGBMatrix*>(matrix)));
+}
+
+void led_animation_delete(struct LedAnimation *animation) {
+  delete to_player(animation);
+}
+
+struct LedCanvas *led_animation_add_frame(struct LedAnimation *animation,
+                                          uint32_t hold_time_us) {
+  return reinterpret_cast<struct LedCanvas*>(
+    to_player(animation)->AddFrame(hold_time_us));
+}
+
+void led_animation_set_mode(struct LedAnimation *animation,
+                            enum LedAnimationMode mode) {
+  to_player(animation)->SetMode((rgb_matrix::AnimationPlayer::Mode)mode);
+}
+
+bool led_animation_start(struct LedAnimation *animation) {
+  return to_player(animation)->Start();
+}
+
+void led_animation_stop(struct LedAnimation *animation) {
+  to_player(animation)->Stop();
+}
+
+bool led_animation_is_playing(struct LedAnimation *animation) {
+  return to_player(animation)->IsPlaying();
+}
@@ -0,0 +1,301 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "content-streamer.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "thread.h"
+
+namespace rgb_matrix {
+namespace {
+static const size_t kBlockSize = 4096;
+static const size_t kChunkSize = 1 << 20;  // Multiple of kBlockSize.
+static const int kMaxBatch = 16;           // Chunks per pwritev().
+
+static int64_t NowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct Chunk {
+  char *data;     // kChunkSize bytes, kBlockSize aligned.
+  size_t fill;
+  off_t offset;   // Where "data" goes in the file; block aligned.
+};
+}  // namespace
+
+// In files, all chunks start at a block boundary. After a Checkpoint()
+// wrote a partially filled chunk, the next one starts with a copy of its
+// last, incomplete block, which is written again.
+class AsyncFileStreamIO::Writer : public Thread {
+public:
+  Writer(int fd, size_t max_queue_bytes, size_t checkpoint_bytes)
+    : fd_(fd), seekable_(true),
+      max_chunks_(std::max<size_t>(2, max_queue_bytes / kChunkSize)),
+      checkpoint_bytes_(checkpoint_bytes), allocated_(0), current_(NULL),
+      next_offset_(0), tail_len_(0), sync_requested_(0), sync_done_(0),
+      unsynced_(0), stopping_(false), error_(0), first_append_ns_(0),
+      last_write_ns_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+    const off_t start = lseek(fd, 0, SEEK_CUR);
+    seekable_ = (start >= 0);
+    if (start > 0) {
+      // Continue unaligned data of an existing file like a tail.
+      next_offset_ = start - start % kBlockSize;
+      tail_len_ = start % kBlockSize;
+      if (pread(fd, tail_, tail_len_, next_offset_) != (ssize_t)tail_len_)
+        error_ = errno ? errno : EIO;
+    }
+    pthread_cond_init(&work_, NULL);
+    pthread_cond_init(&space_, NULL);
+    pthread_cond_init(&synced_, NULL);
+    Start();
+  }
+
+  ~Writer() {
+    Checkpoint();
+    {
+      MutexLock l(&mutex_);
+      stopping_ = true;
+      pthread_cond_signal(&work_);
+    }
+    WaitStopped();
+    if (current_) free_.push_back(current_);
+    for (size_t i = 0; i < free_.size(); ++i) free(free_[i]->data);
+    for (size_t i = 0; i < free_.size(); ++i) delete free_[i];
+    pthread_cond_destroy(&work_);
+    pthread_cond_destroy(&space_);
+    pthread_cond_destroy(&synced_);
+    close(fd_);
+  }
+
+  ssize_t Append(const void *buf, size_t count) {
+    if (first_append_ns_ == 0) first_append_ns_ = NowNanos();
+    const char *pos = (const char*)buf;
+    size_t left = count;
+    while (left > 0) {
+      if (current_ == NULL && !NextChunk()) return -1;
+      const size_t n = std::min(left, kChunkSize - current_->fill);
+      memcpy(current_->data + current_->fill, pos, n);
+      current_->fill += n;
+      pos += n;
+      left -= n;
+      if (current_->fill == kChunkSize) {
+        MutexLock l(&mutex_);
+        full_.push_back(current_);
+        current_ = NULL;
+        pthread_cond_signal(&work_);
+      }
+    }
+    return count;
+  }
+
+  bool Checkpoint() {
+    MutexLock l(&mutex_);
+    if (current_ && current_->fill > 0) {
+      tail_len_ = seekable_ ? current_->fill % kBlockSize : 0;
+      next_offset_ = current_->offset + current_->fill - tail_len_;
+      memcpy(tail_, current_->data + current_->fill - tail_len_, tail_len_);
+      full_.push_back(current_);
+      current_ = NULL;
+    }
+    const int64_t request = ++sync_requested_;
+    pthread_cond_signal(&work_);
+    while (sync_done_ < request) mutex_.WaitOn(&synced_);
+    return error_ == 0;
+  }
+
+  Stats GetStats() {
+    MutexLock l(&mutex_);
+    Stats result = stats_;
+    if (first_append_ns_ && last_write_ns_)
+      result.elapsed_nanos = last_write_ns_ - first_append_ns_;
+    return result;
+  }
+
+  void Run() final {
+    MutexLock l(&mutex_);
+    for (;;) {
+      while (full_.empty() && sync_done_ == sync_requested_ && !stopping_)
+        mutex_.WaitOn(&work_);
+      if (!full_.empty()) {
+        WriteBatch();
+      } else if (sync_done_ < sync_requested_) {
+        Sync(sync_requested_);
+      } else {
+        break;  // Stopping and nothing left to do.
+      }
+      if (checkpoint_bytes_ > 0 && unsynced_ >= (int64_t)checkpoint_bytes_)
+        Sync(sync_done_);
+    }
+  }
+
+private:
+  // Producer: get an empty chunk, waiting if the queue is full.
+  bool NextChunk() {
+    MutexLock l(&mutex_);
+    if (free_.empty() && allocated_ >= max_chunks_) {
+      const int64_t start = NowNanos();
+      while (free_.empty()) mutex_.WaitOn(&space_);
+      const int64_t stall = NowNanos() - start;
+      stats_.stall_nanos += stall;
+      stats_.max_stall_nanos = std::max(stats_.max_stall_nanos, stall);
+    }
+    if (error_) {
+      errno = error_;
+      return false;
+    }
+    if (free_.empty()) {
+      Chunk *chunk = new Chunk();
+      if (posix_memalign((void**)&chunk->data, kBlockSize, kChunkSize) != 0) {
+        delete chunk;
+        errno = ENOMEM;
+        return false;
+      }
+      free_.push_back(chunk);
+      ++allocated_;
+    }
+    current_ = free_.back();
+    free_.pop_back();
+    current_->offset = next_offset_;
+    memcpy(current_->data, tail_, tail_len_);
+    current_->fill = tail_len_;
+    next_offset_ += kChunkSize;
+    tail_len_ = 0;
+    return true;
+  }
+
+  // Writer thread, with mutex_ held: write consecutive chunks at once.
+  void WriteBatch() {
+    std::vector<Chunk*> batch;
+    struct iovec iov[kMaxBatch];
+    size_t total = 0;
+    for (size_t i = 0; i < full_.size() && i < (size_t)kMaxBatch; ++i) {
+      Chunk *c = full_[i];
+      if (i > 0 && c->offset != batch.back()->offset
+          + (off_t)batch.back()->fill) {
+        break;
+      }
+      iov[i].iov_base = c->data;
+      iov[i].iov_len = c->fill;
+      total += c->fill;
+      batch.push_back(c);
+    }
+    const off_t offset = batch[0]->offset;
+    int err = error_;
+
+    mutex_.Unlock();
+    struct iovec *io = iov;
+    int io_count = batch.size();
+    size_t done = 0;
+    while (err == 0 && done < total) {
+      const ssize_t w = seekable_ ? pwritev(fd_, io, io_count, offset + done)
+        : writev(fd_, io, io_count);
+      if (w <= 0) {
+        if (w == 0 || errno != EINTR) err = w ? errno : EIO;
+        continue;
+      }
+      done += w;
+      size_t skip = w;
+      while (io_count > 0 && skip >= io->iov_len) {
+        skip -= io->iov_len;
+        ++io;
+        --io_count;
+      }
+      if (io_count > 0) {
+        io->iov_base = (char*)io->iov_base + skip;
+        io->iov_len -= skip;
+      }
+    }
+    const int64_t now = NowNanos();
+    mutex_.Lock();
+
+    if (err) error_ = err;  // Further chunks are dropped.
+    stats_.bytes_written += done;
+    unsynced_ += done;
+    last_write_ns_ = now;
+    for (size_t i = 0; i < batch.size(); ++i) {
+      full_.pop_front();
+      free_.push_back(batch[i]);
+    }
+    pthread_cond_signal(&space_);
+  }
+
+  // Writer thread, with mutex_ held.
+  void Sync(int64_t request) {
+    mutex_.Unlock();
+    const int r = fdatasync(fd_);
+    const int err = errno;
+    mutex_.Lock();
+    if (r < 0 && err != EINVAL && error_ == 0) error_ = err;
+    stats_.checkpoints++;
+    unsynced_ = 0;
+    sync_done_ = std::max(sync_done_, request);
+    pthread_cond_broadcast(&synced_);
+  }
+
+  const int fd_;
+  bool seekable_;  // Otherwise a pipe: plain writev(), no rewrites.
+  const size_t max_chunks_;
+  const size_t checkpoint_bytes_;
+
+  Mutex mutex_;
+  pthread_cond_t work_, space_, synced_;
+  size_t allocated_;
+  std::deque<Chunk*> full_;   // Waiting to be written, in file order.
+  std::vector<Chunk*> free_;
+  Chunk *current_;            // Being filled by Append().
+
+  // Producer: where the next chunk starts and what it starts with.
+  off_t next_offset_;
+  char tail_[kBlockSize];
+  size_t tail_len_;
+
+  int64_t sync_requested_, sync_done_;
+  int64_t unsynced_;
+  bool stopping_;
+  int error_;
+
+  int64_t first_append_ns_, last_write_ns_;
+  Stats stats_;
+};
+
+AsyncFileStreamIO::AsyncFileStreamIO(int fd, size_t max_queue_bytes,
+                                     size_t checkpoint_bytes)
+  : writer_(new Writer(fd, max_queue_bytes, checkpoint_bytes)) {}
+
+AsyncFileStreamIO::~AsyncFileStreamIO() { delete writer_; }
+
+bool AsyncFileStreamIO::Checkpoint() { return writer_->Checkpoint(); }
+
+AsyncFileStreamIO::Stats AsyncFileStreamIO::GetStats() const {
+  return writer_->GetStats();
+}
+
+ssize_t AsyncFileStreamIO::Append(const void *buf, size_t count) {
+  return writer_->Append(buf, count);
+}
+}  // namespace rgb_matrix
@@ -0,0 +1,122 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "content-streamer.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace rgb_matrix {
+namespace {
+// Mappings of the memfd need page aligned offsets.
+static size_t ChunkSize(size_t requested, bool shareable) {
+  if (requested == 0) requested = 1;
+  if (!shareable) return requested;
+  const size_t page = sysconf(_SC_PAGESIZE);
+  return (requested + page - 1) / page * page;
+}
+}  // namespace
+
+ChunkedMemStreamIO::ChunkedMemStreamIO(size_t chunk_size, bool shareable)
+  : chunk_size_(ChunkSize(chunk_size, shareable)),
+    fd_(shareable ? memfd_create("rgb-matrix-stream", MFD_CLOEXEC) : -1),
+    size_(0), pos_(0), file_size_(0) {
+}
+
+ChunkedMemStreamIO::~ChunkedMemStreamIO() {
+  for (size_t i = 0; i < chunks_.size(); ++i) {
+    if (fd_ >= 0)
+      munmap(chunks_[i], chunk_size_);
+    else
+      free(chunks_[i]);
+  }
+  if (fd_ >= 0) close(fd_);
+}
+
+bool ChunkedMemStreamIO::AddChunk() {
+  char *chunk;
+  if (fd_ >= 0) {
+    const size_t end = (chunks_.size() + 1) * chunk_size_;
+    if (ftruncate(fd_, end) < 0) return false;
+    file_size_ = end;
+    void *mapped = mmap(NULL, chunk_size_, PROT_READ|PROT_WRITE, MAP_SHARED,
+                        fd_, chunks_.size() * chunk_size_);
+    if (mapped == MAP_FAILED) return false;
+    chunk = (char*)mapped;
+  } else {
+    chunk = (char*)malloc(chunk_size_);
+    if (chunk == NULL) {
+      errno = ENOMEM;
+      return false;
+    }
+  }
+  chunks_.push_back(chunk);
+  return true;
+}
+
+void ChunkedMemStreamIO::Rewind() { pos_ = 0; }
+
+ssize_t ChunkedMemStreamIO::Append(const void *buf, size_t count) {
+  const size_t capacity = chunks_.size() * chunk_size_;
+  if (fd_ >= 0 && file_size_ < capacity) {
+    // fd() cut the file to the stream; the last chunk needs it back.
+    if (ftruncate(fd_, capacity) < 0) return -1;
+    file_size_ = capacity;
+  }
+  const char *from = (const char*)buf;
+  size_t done = 0;
+  while (done < count) {
+    if (size_ == chunks_.size() * chunk_size_ && !AddChunk())
+      return done ? (ssize_t)done : -1;
+    const size_t offset = size_ % chunk_size_;
+    const size_t n = std::min(count - done, chunk_size_ - offset);
+    memcpy(chunks_.back() + offset, from + done, n);
+    size_ += n;
+    done += n;
+  }
+  return done;
+}
+
+ssize_t ChunkedMemStreamIO::ReadInPlace(const char **data, size_t count) {
+  if (pos_ >= size_) return 0;
+  const size_t offset = pos_ % chunk_size_;
+  const size_t n = std::min(std::min(count, size_ - pos_),
+                            chunk_size_ - offset);
+  *data = chunks_[pos_ / chunk_size_] + offset;
+  pos_ += n;
+  return n;
+}
+
+ssize_t ChunkedMemStreamIO::Read(void *buf, size_t count) {
+  char *to = (char*)buf;
+  size_t done = 0;
+  const char *data;
+  ssize_t n;
+  while (done < count && (n = ReadInPlace(&data, count - done)) > 0) {
+    memcpy(to + done, data, n);
+    done += n;
+  }
+  return done;
+}
+
+int ChunkedMemStreamIO::fd() {
+  if (fd_ >= 0 && file_size_ != size_ && ftruncate(fd_, size_) == 0)
+    file_size_ = size_;
+  return fd_;
+}
+}  // namespace rgb_matrix
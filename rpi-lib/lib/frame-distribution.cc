@@ -0,0 +1,612 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "frame-distribution.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+
+#include "udp-internal.h"
+
+// Packets start with this header, numbers are big endian:
+//   0  u32 magic          'RGBD'
+//   4  u8  version        2
+//   5  u8  type           PacketType
+//   6  u16 node id
+//   8  u32 sequence       frame number, counting from 1.
+//  12  u32 base           frame the update applies to; 0: black.
+//  16  i64 sent           sender clock at SendFrame().
+//  24  u16 width, height  of the node rectangle.
+//  28  u16 packet index, packet count  of this update.
+//  32  u16 tile count
+//  34  u16 reserved
+//  36  u32 session        random per FrameSender; echoed by the node.
+// An update is followed by "tile count" tiles: a u16 tile index (row by
+// row), then the RGB pixels of the tile. Tiles are kTileSize squares,
+// smaller at the right and bottom edge.
+namespace {
+using rgb_matrix::internal::GetBigEndian;
+using rgb_matrix::internal::MonotonicNanos;
+using rgb_matrix::internal::PutBigEndian;
+using rgb_matrix::internal::TimeoutMillis;
+
+const uint32_t kMagic = 0x52474244;
+const uint8_t kVersion = 2;
+const size_t kHeaderSize = 40;
+// Fits in an ethernet frame without IP fragmentation.
+const size_t kMaxPacketSize = 1472;
+const int kTileSize = 8;
+
+enum PacketType {
+  kUpdate = 1,  // Sender to node: changes since "base".
+  kAck,         // Node to sender: have frame "sequence" now; echoes "sent".
+  kResync,      // Node to sender: don't have "base"; start from black.
+};
+
+// Unacknowledged frames the sender remembers per node.
+const size_t kSenderHistory = 32;
+// An unchanged frame is sent again if the node did not acknowledge it
+// within this time; the update or its acknowledgement was probably lost.
+const int64_t kResendAfterNs = 100 * 1000000LL;
+// Complete frames the receiver keeps as base for further updates.
+const size_t kReceiverHistory = 8;
+
+struct Header {
+  uint8_t type;
+  uint16_t node_id;
+  uint32_t sequence;
+  uint32_t base;
+  int64_t sent_ns;
+  uint16_t width, height;
+  uint16_t packet_index, packet_count;
+  uint16_t tile_count;
+  uint32_t session;
+};
+
+void EncodeHeader(const Header &h, uint8_t *out) {
+  PutBigEndian(kMagic, 4, out);
+  out[4] = kVersion;
+  out[5] = h.type;
+  PutBigEndian(h.node_id, 2, out + 6);
+  PutBigEndian(h.sequence, 4, out + 8);
+  PutBigEndian(h.base, 4, out + 12);
+  PutBigEndian((uint64_t)h.sent_ns, 8, out + 16);
+  PutBigEndian(h.width, 2, out + 24);
+  PutBigEndian(h.height, 2, out + 26);
+  PutBigEndian(h.packet_index, 2, out + 28);
+  PutBigEndian(h.packet_count, 2, out + 30);
+  PutBigEndian(h.tile_count, 2, out + 32);
+  PutBigEndian(0, 2, out + 34);
+  PutBigEndian(h.session, 4, out + 36);
+}
+
+bool DecodeHeader(const uint8_t *in, ssize_t len, Header *h) {
+  if (len < (ssize_t)kHeaderSize || GetBigEndian(in, 4) != kMagic
+      || in[4] != kVersion)
+    return false;
+  h->type = in[5];
+  h->node_id = GetBigEndian(in + 6, 2);
+  h->sequence = GetBigEndian(in + 8, 4);
+  h->base = GetBigEndian(in + 12, 4);
+  h->sent_ns = (int64_t)GetBigEndian(in + 16, 8);
+  h->width = GetBigEndian(in + 24, 2);
+  h->height = GetBigEndian(in + 26, 2);
+  h->packet_index = GetBigEndian(in + 28, 2);
+  h->packet_count = GetBigEndian(in + 30, 2);
+  h->tile_count = GetBigEndian(in + 32, 2);
+  h->session = GetBigEndian(in + 36, 4);
+  return true;
+}
+
+// Geometry of the tiles of a width x height image.
+struct Tiling {
+  Tiling(int w, int h)
+    : width(w), height(h),
+      across((w + kTileSize - 1) / kTileSize),
+      down((h + kTileSize - 1) / kTileSize) {}
+
+  int count() const { return across * down; }
+  int x(int tile) const { return (tile % across) * kTileSize; }
+  int y(int tile) const { return (tile / across) * kTileSize; }
+  int tile_width(int tile) const {
+    return std::min(kTileSize, width - x(tile));
+  }
+  int tile_height(int tile) const {
+    return std::min(kTileSize, height - y(tile));
+  }
+  size_t bytes(int tile) const {
+    return 3 * tile_width(tile) * tile_height(tile);
+  }
+  // Byte offset of the first pixel of row "row" of the tile.
+  size_t offset(int tile, int row) const {
+    return 3 * ((size_t)(y(tile) + row) * width + x(tile));
+  }
+
+  const int width, height, across, down;
+};
+
+// Whether a width x height rectangle fits in the header fields.
+bool ValidGeometry(int width, int height) {
+  return width > 0 && height > 0 && width <= 65535 && height <= 65535
+    && Tiling(width, height).count() <= 65535;
+}
+
+// Whether the tile differs between images "a" and "b"; an empty "b"
+// stands for a black image.
+bool TileDiffers(const Tiling &t, int tile,
+                 const std::string &a, const std::string &b) {
+  const size_t row_bytes = 3 * t.tile_width(tile);
+  for (int row = 0; row < t.tile_height(tile); ++row) {
+    const char *pa = a.data() + t.offset(tile, row);
+    if (b.empty()) {
+      for (size_t i = 0; i < row_bytes; ++i) if (pa[i]) return true;
+    } else if (memcmp(pa, b.data() + t.offset(tile, row), row_bytes) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+namespace rgb_matrix {
+struct FrameSender::Node {
+  struct Sent {
+    uint32_t sequence;
+    int64_t sent_ns;
+    std::string image;
+  };
+
+  Node(int x, int y, int w, int h) : x(x), y(y), tiling(w, h) {}
+
+  int id;
+  struct sockaddr_storage addr;
+  socklen_t addr_len;
+  int fd;
+  const int x, y;
+  const Tiling tiling;
+
+  // Last frame the node acknowledged; 0 and empty: black.
+  uint32_t acked_sequence;
+  std::string acked;
+  // Sent, but not acknowledged yet, oldest first.
+  std::deque<Sent> unacked;
+  std::string last_sent;  // Empty if nothing sent since start or resync.
+  uint32_t last_sent_sequence;
+  int64_t last_sent_ns;
+
+  FrameSenderStats stats;
+  int64_t latency_sum_ns;
+};
+
+FrameSender::FrameSender()
+  : session_(std::random_device()()), sequence_(0), now_ns_(0) {
+  sockets_[0] = sockets_[1] = -1;
+}
+
+FrameSender::~FrameSender() {
+  for (size_t i = 0; i < nodes_.size(); ++i) delete nodes_[i];
+  for (int i = 0; i < 2; ++i) if (sockets_[i] >= 0) close(sockets_[i]);
+}
+
+bool FrameSender::AddNode(int node_id, const char *address,
+                          int x, int y, int width, int height) {
+  if (!ValidGeometry(width, height)) {
+    errno = EINVAL;
+    return false;
+  }
+  struct addrinfo *ai = internal::ResolveUdp(address, false);
+  if (ai == NULL) return false;
+  const int family = (ai->ai_family == AF_INET6) ? 1 : 0;
+  if (sockets_[family] < 0) {
+    sockets_[family] = socket(ai->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sockets_[family] < 0) {
+      freeaddrinfo(ai);
+      return false;
+    }
+  }
+  Node *node = new Node(x, y, width, height);
+  node->id = node_id;
+  memcpy(&node->addr, ai->ai_addr, ai->ai_addrlen);
+  node->addr_len = ai->ai_addrlen;
+  node->fd = sockets_[family];
+  node->acked_sequence = 0;
+  node->last_sent_sequence = 0;
+  node->last_sent_ns = 0;
+  memset(&node->stats, 0, sizeof(node->stats));
+  node->latency_sum_ns = 0;
+  freeaddrinfo(ai);
+  nodes_.push_back(node);
+  return true;
+}
+
+void FrameSender::SendFrame(const uint8_t *rgb, int width, int height,
+                            int stride) {
+  WaitForAcks(0);
+  now_ns_ = MonotonicNanos();
+  ++sequence_;
+  std::string image;
+  for (size_t n = 0; n < nodes_.size(); ++n) {
+    Node *node = nodes_[n];
+    const Tiling &t = node->tiling;
+    image.assign((size_t)3 * t.width * t.height, 0);
+    // Copy the part of the node rectangle that is inside the frame.
+    const int x0 = std::max(node->x, 0);
+    const int x1 = std::min(node->x + t.width, width);
+    for (int row = 0; row < t.height && x0 < x1; ++row) {
+      const int y = node->y + row;
+      if (y < 0 || y >= height) continue;
+      memcpy(&image[3 * (row * t.width + x0 - node->x)],
+             rgb + (size_t)y * stride + 3 * x0, 3 * (x1 - x0));
+    }
+    if (image == node->last_sent
+        && (node->acked_sequence == node->last_sent_sequence
+            || now_ns_ - node->last_sent_ns < kResendAfterNs)) {
+      continue;  // Nothing new for this node, or the ack is still due.
+    }
+    SendUpdate(node, image);
+  }
+}
+
+void FrameSender::SendUpdate(Node *node, const std::string &image) {
+  const Tiling &t = node->tiling;
+  Header h;
+  h.type = kUpdate;
+  h.node_id = node->id;
+  h.sequence = sequence_;
+  h.session = session_;
+  h.base = node->acked_sequence;
+  h.sent_ns = now_ns_;
+  h.width = t.width;
+  h.height = t.height;
+
+  // Collect the changed tiles into packets first; the header needs to
+  // know how many packets there are.
+  std::vector<std::string> packets(1, std::string(kHeaderSize, 0));
+  std::vector<uint16_t> tiles_in_packet(1, 0);
+  for (int tile = 0; tile < t.count(); ++tile) {
+    if (!TileDiffers(t, tile, image, node->acked))
+      continue;
+    if (packets.back().size() + 2 + t.bytes(tile) > kMaxPacketSize) {
+      packets.push_back(std::string(kHeaderSize, 0));
+      tiles_in_packet.push_back(0);
+    }
+    std::string &packet = packets.back();
+    uint8_t index[2];
+    PutBigEndian(tile, 2, index);
+    packet.append((const char*)index, 2);
+    const size_t row_bytes = 3 * t.tile_width(tile);
+    for (int row = 0; row < t.tile_height(tile); ++row)
+      packet.append(image, t.offset(tile, row), row_bytes);
+    ++tiles_in_packet.back();
+  }
+
+  h.packet_count = packets.size();
+  for (size_t i = 0; i < packets.size(); ++i) {
+    h.packet_index = i;
+    h.tile_count = tiles_in_packet[i];
+    EncodeHeader(h, (uint8_t*)&packets[i][0]);
+    sendto(node->fd, packets[i].data(), packets[i].size(), 0,
+           (struct sockaddr*)&node->addr, node->addr_len);
+    node->stats.bytes += packets[i].size();
+  }
+  ++node->stats.frames_sent;
+
+  Node::Sent sent = { sequence_, now_ns_, image };
+  node->unacked.push_back(sent);
+  if (node->unacked.size() > kSenderHistory)
+    node->unacked.pop_front();
+  node->last_sent = image;
+  node->last_sent_sequence = sequence_;
+  node->last_sent_ns = now_ns_;
+}
+
+void FrameSender::WaitForAcks(int timeout_ms) {
+  const int64_t deadline = MonotonicNanos() + timeout_ms * 1000000LL;
+  for (;;) {
+    struct pollfd fds[2];
+    int count = 0;
+    for (int i = 0; i < 2; ++i) {
+      if (sockets_[i] < 0) continue;
+      fds[count].fd = sockets_[i];
+      fds[count].events = POLLIN;
+      fds[count].revents = 0;
+      ++count;
+    }
+    const int timeout = TimeoutMillis(deadline - MonotonicNanos());
+    if (count == 0 || poll(fds, count, timeout) <= 0) {
+      if (timeout == 0 || count == 0) return;
+      continue;
+    }
+    for (int i = 0; i < count; ++i) {
+      if (fds[i].revents) ReadAck(fds[i].fd);
+    }
+  }
+}
+
+void FrameSender::ReadAck(int fd) {
+  uint8_t buffer[kHeaderSize];
+  Header h;
+  if (!DecodeHeader(buffer, recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT),
+                    &h))
+    return;
+  const int64_t received = MonotonicNanos();
+  Node *node = NULL;
+  for (size_t i = 0; i < nodes_.size() && !node; ++i) {
+    if (nodes_[i]->id == h.node_id) node = nodes_[i];
+  }
+  if (node == NULL || h.session != session_)
+    return;  // Unknown node, or answering a previous sender.
+  if (h.type == kResync) {
+    node->acked_sequence = 0;
+    node->acked.clear();
+    node->last_sent.clear();
+    return;
+  }
+  if (h.type != kAck || h.sequence <= node->acked_sequence) return;
+  while (!node->unacked.empty()
+         && node->unacked.front().sequence <= h.sequence) {
+    if (node->unacked.front().sequence == h.sequence) {
+      node->acked_sequence = h.sequence;
+      node->acked.swap(node->unacked.front().image);
+      node->latency_sum_ns += received - node->unacked.front().sent_ns;
+      ++node->stats.frames_acked;
+    }
+    node->unacked.pop_front();
+  }
+}
+
+FrameSenderStats FrameSender::TakeStats(int i) {
+  Node *node = nodes_[i];
+  FrameSenderStats result = node->stats;
+  result.ack_latency_ns = result.frames_acked
+    ? node->latency_sum_ns / result.frames_acked : 0;
+  memset(&node->stats, 0, sizeof(node->stats));
+  node->latency_sum_ns = 0;
+  return result;
+}
+
+FrameReceiver::FrameReceiver(int node_id, int width, int height)
+  : node_id_(node_id), fd_(-1), session_(0), width_(width), height_(height),
+    pending_sequence_(0), pending_base_(0), pending_sent_ns_(0),
+    pending_missing_(0), generation_(0), new_frame_(false),
+    latency_ns_(0), bytes_received_(0), sender_addr_len_(0) {
+  if (ValidGeometry(width_, height_))
+    tile_generation_.assign(Tiling(width_, height_).count(), 0);
+}
+
+FrameReceiver::~FrameReceiver() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool FrameReceiver::Open(const char *address) {
+  if (!ValidGeometry(width_, height_)) {
+    errno = EINVAL;
+    return false;
+  }
+  struct addrinfo *result = internal::ResolveUdp(address, true);
+  if (result == NULL) return false;
+  int err = EADDRNOTAVAIL;
+  for (struct addrinfo *ai = result; ai && fd_ < 0; ai = ai->ai_next) {
+    fd_ = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                 ai->ai_protocol);
+    if (fd_ < 0) continue;
+    // Several receivers on one machine can share a multicast group.
+    const int on = 1;
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    bool ok = (bind(fd_, ai->ai_addr, ai->ai_addrlen) == 0);
+    if (ok && ai->ai_family == AF_INET) {
+      const struct in_addr group
+        = ((struct sockaddr_in*)ai->ai_addr)->sin_addr;
+      if (IN_MULTICAST(ntohl(group.s_addr))) {
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr = group;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        ok = setsockopt(fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                        &mreq, sizeof(mreq)) == 0;
+      }
+    } else if (ok && ai->ai_family == AF_INET6) {
+      const struct in6_addr &group
+        = ((struct sockaddr_in6*)ai->ai_addr)->sin6_addr;
+      if (IN6_IS_ADDR_MULTICAST(&group)) {
+        struct ipv6_mreq mreq;
+        mreq.ipv6mr_multiaddr = group;
+        mreq.ipv6mr_interface = 0;
+        ok = setsockopt(fd_, IPPROTO_IPV6, IPV6_JOIN_GROUP,
+                        &mreq, sizeof(mreq)) == 0;
+      }
+    }
+    if (!ok) {
+      err = errno;
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+  freeaddrinfo(result);
+  if (fd_ < 0) errno = err;
+  return fd_ >= 0;
+}
+
+const FrameReceiver::Frame *FrameReceiver::FindFrame(uint32_t seq) const {
+  for (size_t i = 0; i < frames_.size(); ++i) {
+    if (frames_[i].sequence == seq) return &frames_[i];
+  }
+  return NULL;
+}
+
+void FrameReceiver::SendToSender(uint8_t type, uint32_t sequence,
+                                 int64_t sent_ns) {
+  Header h;
+  memset(&h, 0, sizeof(h));
+  h.type = type;
+  h.node_id = node_id_;
+  h.sequence = sequence;
+  h.sent_ns = sent_ns;
+  h.session = session_;
+  uint8_t buffer[kHeaderSize];
+  EncodeHeader(h, buffer);
+  sendto(fd_, buffer, sizeof(buffer), 0,
+         (struct sockaddr*)&sender_addr_, sender_addr_len_);
+}
+
+void FrameReceiver::HandlePacket() {
+  uint8_t buffer[kMaxPacketSize];
+  struct sockaddr_storage from;
+  socklen_t from_len = sizeof(from);
+  const ssize_t len = recvfrom(fd_, buffer, sizeof(buffer), MSG_DONTWAIT,
+                               (struct sockaddr*)&from, &from_len);
+  Header h;
+  if (!DecodeHeader(buffer, len, &h) || h.type != kUpdate
+      || h.node_id != node_id_ || h.packet_index >= h.packet_count
+      || h.width != width_ || h.height != height_)
+    return;  // Not for us; in a multicast group, most aren't.
+  bytes_received_ += len;
+  memcpy(&sender_addr_, &from, from_len);
+  sender_addr_len_ = from_len;
+
+  if (h.session != session_) {
+    // A new or restarted sender. Its sequence numbers start over and it
+    // knows none of our frames.
+    session_ = h.session;
+    frames_.clear();
+    pending_sequence_ = 0;
+    pending_missing_ = 0;
+  }
+  const uint32_t latest = frames_.empty() ? 0 : frames_.back().sequence;
+  if (h.sequence <= latest)
+    return;  // Late or duplicate.
+  if (h.sequence != pending_sequence_) {
+    if (h.sequence < pending_sequence_)
+      return;  // Older than what we are receiving.
+    // Start a new frame; whatever was pending is incomplete and dropped.
+    pending_sequence_ = h.sequence;
+    pending_base_ = h.base;
+    pending_sent_ns_ = h.sent_ns;
+    pending_packets_.assign(h.packet_count, false);
+    pending_missing_ = h.packet_count;
+    pending_tiles_.clear();
+    if (h.base != 0 && FindFrame(h.base) == NULL) {
+      SendToSender(kResync, h.sequence, h.sent_ns);
+      pending_missing_ = -1;  // Ignore the rest of this frame.
+    }
+  }
+  if (pending_missing_ <= 0 || h.packet_count != pending_packets_.size()
+      || pending_packets_[h.packet_index])
+    return;  // Count first: the index was only checked against it.
+
+  const Tiling t(width_, height_);
+  std::vector<std::pair<int, std::string> > tiles;
+  size_t pos = kHeaderSize;
+  for (int i = 0; i < h.tile_count; ++i) {
+    if (pos + 2 > (size_t)len) return;
+    const int tile = GetBigEndian(buffer + pos, 2);
+    pos += 2;
+    if (tile >= t.count() || pos + t.bytes(tile) > (size_t)len) return;
+    tiles.push_back(std::make_pair(
+                      tile, std::string((const char*)buffer + pos,
+                                        t.bytes(tile))));
+    pos += t.bytes(tile);
+  }
+  pending_tiles_.insert(pending_tiles_.end(), tiles.begin(), tiles.end());
+  pending_packets_[h.packet_index] = true;
+  if (--pending_missing_ == 0)
+    CompleteFrame();
+}
+
+void FrameReceiver::CompleteFrame() {
+  const Tiling t(width_, height_);
+  Frame frame;
+  frame.sequence = pending_sequence_;
+  const Frame *base = FindFrame(pending_base_);
+  if (base)
+    frame.image = base->image;
+  else
+    frame.image.assign((size_t)3 * width_ * height_, 0);
+  for (size_t i = 0; i < pending_tiles_.size(); ++i) {
+    const int tile = pending_tiles_[i].first;
+    const std::string &pixels = pending_tiles_[i].second;
+    const size_t row_bytes = 3 * t.tile_width(tile);
+    for (int row = 0; row < t.tile_height(tile); ++row) {
+      frame.image.replace(t.offset(tile, row), row_bytes,
+                          pixels, row * row_bytes, row_bytes);
+    }
+  }
+  pending_tiles_.clear();
+
+  // Remember which tiles changed compared to what we showed last.
+  ++generation_;
+  const std::string *shown = frames_.empty() ? NULL : &frames_.back().image;
+  for (int tile = 0; tile < t.count(); ++tile) {
+    if (!shown || TileDiffers(t, tile, frame.image, *shown))
+      tile_generation_[tile] = generation_;
+  }
+
+  frames_.push_back(frame);
+  if (frames_.size() > kReceiverHistory)
+    frames_.pop_front();
+  SendToSender(kAck, pending_sequence_, pending_sent_ns_);
+  latency_ns_ = MonotonicNanos() - pending_sent_ns_;
+  new_frame_ = true;
+}
+
+bool FrameReceiver::Receive(int timeout_ms) {
+  const int64_t deadline = MonotonicNanos() + timeout_ms * 1000000LL;
+  for (;;) {
+    if (new_frame_) {
+      new_frame_ = false;
+      return true;
+    }
+    const int timeout = TimeoutMillis(deadline - MonotonicNanos());
+    struct pollfd pfd = { fd_, POLLIN, 0 };
+    if (poll(&pfd, 1, timeout) <= 0) {
+      if (timeout == 0) return false;
+      continue;
+    }
+    while (poll(&pfd, 1, 0) > 0) HandlePacket();
+  }
+}
+
+void FrameReceiver::Apply(Canvas *canvas) {
+  if (frames_.empty()) return;
+  uint32_t *canvas_generation = NULL;
+  for (size_t i = 0; i < canvases_.size(); ++i) {
+    if (canvases_[i].first == canvas) canvas_generation = &canvases_[i].second;
+  }
+  if (canvas_generation == NULL) {
+    canvases_.push_back(std::make_pair(canvas, 0));
+    canvas_generation = &canvases_.back().second;
+  }
+
+  const Tiling t(width_, height_);
+  const std::string &image = frames_.back().image;
+  for (int tile = 0; tile < t.count(); ++tile) {
+    if (tile_generation_[tile] <= *canvas_generation)
+      continue;
+    for (int row = 0; row < t.tile_height(tile); ++row) {
+      const uint8_t *p = (const uint8_t*)image.data() + t.offset(tile, row);
+      const int y = t.y(tile) + row;
+      for (int x = t.x(tile); x < t.x(tile) + t.tile_width(tile); ++x) {
+        canvas->SetPixel(x, y, p[0], p[1], p[2]);
+        p += 3;
+      }
+    }
+  }
+  *canvas_generation = generation_;
+}
+}  // namespace rgb_matrix
@@ -0,0 +1,331 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "genlock.h"
+
+#include <errno.h>
+#include <math.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "udp-internal.h"
+
+// Wire format; all packets have the same size, numbers are big endian.
+//   0  u32 magic       'RGBW'
+//   4  u8  version     1
+//   5  u8  type        PacketType
+//   6  u16 node id
+//   8  u32 frame
+//  12  i64 value[4]    meaning depends on type, see below.
+namespace {
+using rgb_matrix::internal::GetBigEndian;
+using rgb_matrix::internal::OpenUdp;
+using rgb_matrix::internal::PutBigEndian;
+using rgb_matrix::internal::TimeoutMillis;
+
+const uint32_t kMagic = 0x52474257;
+const uint8_t kVersion = 1;
+const size_t kPacketSize = 12 + 4 * 8;
+
+enum PacketType {
+  kPresent = 1,     // frame; value[0]: present time on coordinator clock.
+  kSyncRequest,     // value[0]: node send time.
+  kSyncReply,       // value[0]: as in request; [1] receive; [2] send time.
+  kReport,          // frame; value[]: offset, rtt, swap error, swap jitter.
+};
+
+// Nodes not heard from for this long don't get frames announced anymore.
+const int64_t kNodeTimeoutNanos = 5000000000LL;
+
+// Clock sync: a burst of requests to get started, then a steady trickle.
+const size_t kSyncSamples = 8;
+const size_t kSamplesToStart = 4;
+const int64_t kSyncBurstInterval = 50000000LL;
+const int64_t kSyncInterval = 500000000LL;
+// Offset changes larger than this are applied at once, smaller ones are
+// slewed in to avoid jumps in presentation time.
+const int64_t kStepThresholdNanos = 5000000LL;
+
+// Wake up this long before the present time with poll(), sleep the rest.
+const int64_t kPrecisionSleepNanos = 2000000LL;
+
+struct Packet {
+  uint8_t type;
+  uint16_t node_id;
+  uint32_t frame;
+  int64_t value[4];
+};
+
+void Encode(const Packet &p, uint8_t *out) {
+  PutBigEndian(kMagic, 4, out);
+  out[4] = kVersion;
+  out[5] = p.type;
+  PutBigEndian(p.node_id, 2, out + 6);
+  PutBigEndian(p.frame, 4, out + 8);
+  for (int i = 0; i < 4; ++i)
+    PutBigEndian((uint64_t)p.value[i], 8, out + 12 + 8*i);
+}
+
+bool Decode(const uint8_t *in, ssize_t len, Packet *p) {
+  if (len != (ssize_t)kPacketSize || GetBigEndian(in, 4) != kMagic
+      || in[4] != kVersion)
+    return false;
+  p->type = in[5];
+  p->node_id = GetBigEndian(in + 6, 2);
+  p->frame = GetBigEndian(in + 8, 4);
+  for (int i = 0; i < 4; ++i)
+    p->value[i] = (int64_t)GetBigEndian(in + 12 + 8*i, 8);
+  return true;
+}
+}  // namespace
+
+namespace rgb_matrix {
+int64_t GenlockNowNanos() {
+  return internal::MonotonicNanos();
+}
+
+GenlockCoordinator::GenlockCoordinator() : fd_(-1) {}
+
+GenlockCoordinator::~GenlockCoordinator() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool GenlockCoordinator::Open(const char *address) {
+  fd_ = OpenUdp(address, true);
+  return fd_ >= 0;
+}
+
+void GenlockCoordinator::Remember(const struct sockaddr_storage &addr,
+                                  socklen_t len) {
+  const int64_t now = GenlockNowNanos();
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    if (nodes_[i].addr_len == len && memcmp(&nodes_[i].addr, &addr, len) == 0) {
+      nodes_[i].last_seen_ns = now;
+      return;
+    }
+  }
+  Node node;
+  node.addr = addr;
+  node.addr_len = len;
+  node.last_seen_ns = now;
+  nodes_.push_back(node);
+}
+
+void GenlockCoordinator::HandlePacket() {
+  uint8_t buffer[kPacketSize + 1];
+  struct sockaddr_storage from;
+  socklen_t from_len = sizeof(from);
+  const ssize_t len = recvfrom(fd_, buffer, sizeof(buffer), MSG_DONTWAIT,
+                               (struct sockaddr*)&from, &from_len);
+  const int64_t received = GenlockNowNanos();
+  Packet p;
+  if (!Decode(buffer, len, &p)) return;
+  Remember(from, from_len);
+  if (p.type == kSyncRequest) {
+    p.type = kSyncReply;
+    p.value[1] = received;
+    p.value[2] = GenlockNowNanos();
+    Encode(p, buffer);
+    sendto(fd_, buffer, kPacketSize, 0, (struct sockaddr*)&from, from_len);
+  } else if (p.type == kReport && handler_) {
+    GenlockReport report;
+    report.node_id = p.node_id;
+    report.frame = p.frame;
+    report.offset_ns = p.value[0];
+    report.rtt_ns = p.value[1];
+    report.swap_error_ns = p.value[2];
+    report.swap_jitter_ns = p.value[3];
+    handler_(report);
+  }
+}
+
+void GenlockCoordinator::Announce(uint32_t frame, int64_t present_ns) {
+  const int64_t now = GenlockNowNanos();
+  for (size_t i = 0; i < nodes_.size(); /**/) {
+    if (now - nodes_[i].last_seen_ns > kNodeTimeoutNanos)
+      nodes_.erase(nodes_.begin() + i);
+    else
+      ++i;
+  }
+  Packet p = { kPresent, 0, frame, { present_ns, 0, 0, 0 } };
+  uint8_t buffer[kPacketSize];
+  Encode(p, buffer);
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    sendto(fd_, buffer, kPacketSize, 0,
+           (struct sockaddr*)&nodes_[i].addr, nodes_[i].addr_len);
+  }
+}
+
+void GenlockCoordinator::ServeUntil(int64_t deadline_ns) {
+  for (;;) {
+    const int64_t remaining = deadline_ns - GenlockNowNanos();
+    if (remaining <= 0) return;
+    struct pollfd pfd = { fd_, POLLIN, 0 };
+    if (poll(&pfd, 1, TimeoutMillis(remaining)) > 0)
+      HandlePacket();
+  }
+}
+
+GenlockNode::GenlockNode(int node_id)
+  : node_id_(node_id), fd_(-1), synced_(false), offset_ns_(0),
+    next_sync_ns_(0), sample_count_(0), last_frame_(0), swaps_(0),
+    error_sum_(0), error_square_sum_(0), next_report_ns_(0) {
+  memset(&report_, 0, sizeof(report_));
+  report_.node_id = node_id;
+}
+
+GenlockNode::~GenlockNode() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool GenlockNode::Open(const char *coordinator) {
+  fd_ = OpenUdp(coordinator, false);
+  return fd_ >= 0;
+}
+
+void GenlockNode::MaybeRequestSync(int64_t now) {
+  if (now < next_sync_ns_) return;
+  Packet p = { kSyncRequest, (uint16_t)node_id_, 0, { now, 0, 0, 0 } };
+  uint8_t buffer[kPacketSize];
+  Encode(p, buffer);
+  send(fd_, buffer, kPacketSize, 0);
+  next_sync_ns_ = now + (sample_count_ < kSyncSamples
+                         ? kSyncBurstInterval : kSyncInterval);
+}
+
+void GenlockNode::AddSample(const Sample &sample) {
+  if (samples_.size() < kSyncSamples)
+    samples_.push_back(sample);
+  else
+    samples_[sample_count_ % kSyncSamples] = sample;
+  ++sample_count_;
+
+  // The round trip with the least delay has the least asymmetry, so it is
+  // the best estimate we have.
+  const Sample *best = &samples_[0];
+  for (size_t i = 1; i < samples_.size(); ++i) {
+    if (samples_[i].rtt_ns < best->rtt_ns) best = &samples_[i];
+  }
+  report_.rtt_ns = best->rtt_ns;
+  if (!synced_) {
+    if (sample_count_ < kSamplesToStart) return;
+    offset_ns_ = best->offset_ns;
+    synced_ = true;
+    return;
+  }
+  const int64_t delta = best->offset_ns - offset_ns_;
+  if (delta > kStepThresholdNanos || delta < -kStepThresholdNanos)
+    offset_ns_ = best->offset_ns;
+  else
+    offset_ns_ += delta / 4;
+}
+
+void GenlockNode::HandlePacket() {
+  uint8_t buffer[kPacketSize + 1];
+  const ssize_t len = recv(fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
+  const int64_t received = GenlockNowNanos();
+  Packet p;
+  if (!Decode(buffer, len, &p)) return;
+  if (p.type == kSyncReply) {
+    // t1: we sent, t2: coordinator received, t3: coordinator sent,
+    // t4: we received.
+    const int64_t t1 = p.value[0], t2 = p.value[1], t3 = p.value[2];
+    Sample sample;
+    sample.rtt_ns = (received - t1) - (t3 - t2);
+    sample.offset_ns = ((t2 - t1) + (t3 - received)) / 2;
+    if (sample.rtt_ns >= 0) AddSample(sample);
+  } else if (p.type == kPresent) {
+    Present present = { p.frame, p.value[0] };
+    pending_.push_back(present);
+  }
+}
+
+void GenlockNode::Pump(int timeout_ms) {
+  const int64_t now = GenlockNowNanos();
+  MaybeRequestSync(now);
+  const int until_sync = TimeoutMillis(next_sync_ns_ - now);
+  if (timeout_ms < 0 || until_sync < timeout_ms) timeout_ms = until_sync;
+  struct pollfd pfd = { fd_, POLLIN, 0 };
+  if (poll(&pfd, 1, timeout_ms) <= 0) return;
+  while (poll(&pfd, 1, 0) > 0) HandlePacket();
+}
+
+bool GenlockNode::NextPresent(int timeout_ms, uint32_t *frame,
+                              int64_t *local_present_ns) {
+  const int64_t deadline = GenlockNowNanos() + timeout_ms * 1000000LL;
+  for (;;) {
+    const int64_t now = GenlockNowNanos();
+    if (synced_) {
+      // Skip frames that are overdue already if there is a later one.
+      while (pending_.size() >= 2
+             && pending_[1].coordinator_ns - offset_ns_ <= now) {
+        pending_.pop_front();
+      }
+      if (!pending_.empty()) {
+        last_frame_ = pending_.front().frame;
+        *frame = last_frame_;
+        *local_present_ns = pending_.front().coordinator_ns - offset_ns_;
+        pending_.pop_front();
+        return true;
+      }
+    } else {
+      pending_.clear();  // We wouldn't know when to show them.
+    }
+    if (now >= deadline) return false;
+    Pump(TimeoutMillis(deadline - now));
+  }
+}
+
+void GenlockNode::SleepUntil(int64_t local_ns) {
+  for (;;) {
+    const int64_t remaining = local_ns - kPrecisionSleepNanos
+      - GenlockNowNanos();
+    if (remaining <= 0) break;
+    Pump(TimeoutMillis(remaining));
+  }
+  struct timespec ts;
+  ts.tv_sec = local_ns / 1000000000LL;
+  ts.tv_nsec = local_ns % 1000000000LL;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    ;
+}
+
+void GenlockNode::Presented(int64_t local_present_ns) {
+  const int64_t now = GenlockNowNanos();
+  const double error = now - local_present_ns;
+  error_sum_ += error;
+  error_square_sum_ += error * error;
+  ++swaps_;
+  if (now < next_report_ns_) return;
+
+  const double mean = error_sum_ / swaps_;
+  const double variance = error_square_sum_ / swaps_ - mean * mean;
+  report_.frame = last_frame_;
+  report_.offset_ns = offset_ns_;
+  report_.swap_error_ns = (int64_t)mean;
+  report_.swap_jitter_ns = variance > 0 ? (int64_t)sqrt(variance) : 0;
+  Packet p = { kReport, (uint16_t)node_id_, report_.frame,
+               { report_.offset_ns, report_.rtt_ns,
+                 report_.swap_error_ns, report_.swap_jitter_ns } };
+  uint8_t buffer[kPacketSize];
+  Encode(p, buffer);
+  send(fd_, buffer, kPacketSize, 0);
+
+  swaps_ = 0;
+  error_sum_ = error_square_sum_ = 0;
+  next_report_ns_ = now + 1000000000LL;
+}
+}  // namespace rgb_matrix
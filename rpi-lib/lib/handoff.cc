@@ -0,0 +1,326 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "handoff.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// Protocol on the Unix stream socket:
+//   successor -> predecessor: kRequestMagic
+//   predecessor -> successor: Header, with the memfd holding the serialized
+//                             frame followed by the app state (SCM_RIGHTS)
+//   successor -> predecessor: kRelease
+//   predecessor -> successor: int64 CLOCK_MONOTONIC time it stopped, then
+//                             it exits, which closes the socket.
+
+namespace rgb_matrix {
+namespace {
+static const uint32_t kRequestMagic = 0x48424752;  // "RGBH"
+static const uint32_t kVersion = 1;
+static const char kRelease = 'R';
+
+// How long the predecessor waits for the successor to get ready.
+static const int kReleaseTimeoutMs = 10000;
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t frame_bytes;
+  uint64_t state_bytes;
+  uint8_t brightness;
+  uint8_t pwm_bits;
+  uint8_t luminance_correct;
+  uint8_t reserved;
+};
+
+static int64_t NowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Wait until "fd" is readable or "deadline_ns" passed.
+static bool WaitReadable(int fd, int64_t deadline_ns) {
+  for (;;) {
+    const int64_t left = deadline_ns - NowNanos();
+    if (left < 0) return false;
+    struct pollfd p = { fd, POLLIN, 0 };
+    const int r = poll(&p, 1, (int)((left + 999999) / 1000000));
+    if (r > 0) return true;
+    if (r < 0 && errno != EINTR) return false;
+  }
+}
+
+static bool ReadFully(int fd, void *buf, size_t len, int64_t deadline_ns) {
+  char *pos = (char*)buf;
+  while (len > 0) {
+    if (!WaitReadable(fd, deadline_ns)) return false;
+    const ssize_t r = read(fd, pos, len);
+    if (r == 0) return false;
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    pos += r;
+    len -= r;
+  }
+  return true;
+}
+
+static bool WriteFully(int fd, const void *buf, size_t len) {
+  const char *pos = (const char*)buf;
+  while (len > 0) {
+    const ssize_t r = send(fd, pos, len, MSG_NOSIGNAL);
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    pos += r;
+    len -= r;
+  }
+  return true;
+}
+
+static bool FillAddress(const char *path, struct sockaddr_un *addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path)) {
+    errno = ENAMETOOLONG;
+    return false;
+  }
+  strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+  return true;
+}
+
+// Memory file with the frame, then the state.
+static int CreateStateFile(const char *frame, size_t frame_len,
+                           const std::string &state) {
+  const int fd = memfd_create("rgb-matrix-handoff", MFD_CLOEXEC);
+  if (fd < 0) return -1;
+  if (pwrite(fd, frame, frame_len, 0) != (ssize_t)frame_len
+      || pwrite(fd, state.data(), state.size(), frame_len)
+      != (ssize_t)state.size()) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static bool SendHeader(int sock, const Header &header, int memfd) {
+  struct iovec iov;
+  iov.iov_base = (void*)&header;
+  iov.iov_len = sizeof(header);
+  char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &memfd, sizeof(int));
+  return sendmsg(sock, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(header);
+}
+
+// Returns the received file descriptor or -1.
+static int ReceiveHeader(int sock, Header *header, int64_t deadline_ns) {
+  if (!WaitReadable(sock, deadline_ns)) return -1;
+  struct iovec iov;
+  iov.iov_base = header;
+  iov.iov_len = sizeof(*header);
+  char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(*header))
+    return -1;
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET
+      || cmsg->cmsg_type != SCM_RIGHTS) {
+    return -1;
+  }
+  int fd;
+  memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  return fd;
+}
+}  // namespace
+
+HandoffServer::HandoffServer() : listen_fd_(-1) {}
+
+HandoffServer::~HandoffServer() {
+  if (listen_fd_ < 0) return;
+  close(listen_fd_);
+  unlink(path_.c_str());
+}
+
+bool HandoffServer::Listen(const char *socket_path) {
+  struct sockaddr_un addr;
+  if (!FillAddress(socket_path, &addr)) return false;
+  const int fd = socket(AF_UNIX, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+  if (fd < 0) return false;
+  unlink(socket_path);  // Left behind by a predecessor.
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+      || listen(fd, 1) < 0) {
+    const int err = errno;
+    close(fd);
+    errno = err;
+    return false;
+  }
+  listen_fd_ = fd;
+  path_ = socket_path;
+  return true;
+}
+
+bool HandoffServer::HandOver(FrameCanvas *shown,
+                             const std::string &app_state) {
+  const int sock = accept4(listen_fd_, NULL, NULL, SOCK_CLOEXEC);
+  if (sock < 0) return false;
+  const int64_t deadline = NowNanos() + kReleaseTimeoutMs * 1000000LL;
+  bool released = false;
+  uint32_t request;
+  if (ReadFully(sock, &request, sizeof(request), deadline)
+      && request == kRequestMagic) {
+    const char *frame;
+    size_t frame_len;
+    shown->Serialize(&frame, &frame_len);
+    const int memfd = CreateStateFile(frame, frame_len, app_state);
+    if (memfd >= 0) {
+      Header header;
+      memset(&header, 0, sizeof(header));
+      header.magic = kRequestMagic;
+      header.version = kVersion;
+      header.frame_bytes = frame_len;
+      header.state_bytes = app_state.size();
+      header.brightness = shown->brightness();
+      header.pwm_bits = shown->pwmbits();
+      header.luminance_correct = shown->luminance_correct();
+      char release;
+      released = SendHeader(sock, header, memfd)
+        && ReadFully(sock, &release, 1, deadline) && release == kRelease;
+      close(memfd);
+    }
+  }
+  if (!released) {
+    close(sock);
+    return false;
+  }
+
+  // The socket file now belongs to the successor; don't remove it.
+  fflush(NULL);
+  const int64_t stopped = NowNanos();
+  WriteFully(sock, &stopped, sizeof(stopped));
+  _exit(0);
+}
+
+HandoffClient::HandoffClient()
+  : fd_(-1), brightness_(100), pwm_bits_(11), luminance_correct_(true),
+    released_ns_(0) {}
+
+HandoffClient::~HandoffClient() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool HandoffClient::Receive(const char *socket_path, int timeout_ms) {
+  struct sockaddr_un addr;
+  if (!FillAddress(socket_path, &addr)) return false;
+  fd_ = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0);
+  if (fd_ < 0) return false;
+  if (connect(fd_, (struct sockaddr*)&addr, sizeof(addr)) < 0
+      || !WriteFully(fd_, &kRequestMagic, sizeof(kRequestMagic))) {
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+
+  const int64_t deadline = NowNanos() + timeout_ms * 1000000LL;
+  Header header;
+  const int memfd = ReceiveHeader(fd_, &header, deadline);
+  bool success = false;
+  if (memfd >= 0) {
+    if (header.magic == kRequestMagic && header.version == kVersion) {
+      const size_t len = header.frame_bytes + header.state_bytes;
+      void *data = len ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, memfd, 0)
+        : NULL;
+      if (data != MAP_FAILED) {
+        frame_.assign((const char*)data, header.frame_bytes);
+        app_state_.assign((const char*)data + header.frame_bytes,
+                          header.state_bytes);
+        if (data) munmap(data, len);
+        brightness_ = header.brightness;
+        pwm_bits_ = header.pwm_bits;
+        luminance_correct_ = header.luminance_correct;
+        success = true;
+      }
+    }
+    close(memfd);
+  }
+  if (!success) {
+    close(fd_);  // The predecessor keeps running.
+    fd_ = -1;
+  }
+  return success;
+}
+
+bool HandoffClient::Release(int timeout_ms) {
+  if (fd_ < 0) return false;
+  const int64_t deadline = NowNanos() + timeout_ms * 1000000LL;
+  int64_t stopped;
+  if (!WriteFully(fd_, &kRelease, 1)
+      || !ReadFully(fd_, &stopped, sizeof(stopped), deadline)) {
+    return false;
+  }
+  released_ns_ = stopped;
+
+  // The connection closes once the predecessor has exited.
+  char c;
+  while (WaitReadable(fd_, deadline)) {
+    const ssize_t r = read(fd_, &c, 1);
+    if (r == 0 || (r < 0 && errno != EINTR)) {
+      close(fd_);
+      fd_ = -1;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HandoffClient::Restore(FrameCanvas *canvas) {
+  if (frame_.empty() || !canvas->Deserialize(frame_.data(), frame_.size()))
+    return false;
+  canvas->SetPWMBits(pwm_bits_);
+  canvas->SetBrightness(brightness_);
+  canvas->set_luminance_correct(luminance_correct_);
+  return true;
+}
+
+int64_t HandoffClient::NanosSinceRelease() const {
+  return released_ns_ ? NowNanos() - released_ns_ : 0;
+}
+}  // namespace rgb_matrix
@@ -0,0 +1,226 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// On-demand glyph loading for large BDF fonts.
+//
+// We keep an index of where each glyph is in the file. Whenever new glyphs
+// are needed, the header and the wanted glyph sections are assembled into a
+// small BDF file that is loaded with the regular Font::LoadFont(), so the
+// resulting Font behaves exactly like one loaded the regular way. Font has
+// no way to add a single glyph, so this reloads all glyphs kept.
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE  // memfd_create()
+#endif
+
+#include "graphics.h"
+#include "utf8-internal.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace rgb_matrix {
+static const uint64_t kPinned = ~(uint64_t)0;  // Never evicted.
+
+LazyFont::LazyFont(int max_glyphs)
+  : max_glyphs_(max_glyphs < 0 ? 0 : max_glyphs), fd_(-1),
+    use_counter_(0), font_(new Font()) {
+}
+
+LazyFont::~LazyFont() {
+  if (fd_ >= 0) close(fd_);
+  delete font_;
+}
+
+bool LazyFont::Open(const char *path) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat sb;
+  if (fstat(fd, &sb) < 0 || sb.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  // Scanning through a mapping is a lot cheaper than line-by-line stdio.
+  const size_t file_size = sb.st_size;
+  void *const mapped = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapped == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  madvise(mapped, file_size, MADV_SEQUENTIAL);
+
+  header_.clear();
+  index_.clear();
+  loaded_.clear();
+
+  const char *const begin = (const char*) mapped;
+  const char *const end = begin + file_size;
+  bool in_header = true;
+  IndexEntry current = { 0, 0, 0 };
+  bool have_encoding = false;
+  for (const char *line = begin; line < end; /**/) {
+    const char *eol = (const char*) memchr(line, '\n', end - line);
+    const char *next = eol ? eol + 1 : end;
+    const size_t len = next - line;
+    if (len > 9 && memcmp(line, "STARTCHAR", 9) == 0) {
+      in_header = false;
+      current.offset = line - begin;
+      have_encoding = false;
+    } else if (in_header) {
+      if (!(len > 6 && memcmp(line, "CHARS ", 6) == 0))  // Re-generated.
+        header_.append(line, len);
+    } else if (len > 9 && memcmp(line, "ENCODING ", 9) == 0) {
+      current.codepoint = strtoul(line + 9, NULL, 10);
+      have_encoding = true;
+    } else if (len >= 7 && memcmp(line, "ENDCHAR", 7) == 0 && have_encoding) {
+      current.length = (next - begin) - current.offset;
+      index_.push_back(current);
+    }
+    line = next;
+  }
+  munmap(mapped, file_size);
+
+  if (index_.empty() || header_.find("FONTBOUNDINGBOX") == std::string::npos) {
+    close(fd);
+    return false;
+  }
+  std::vector<IndexEntry>(index_).swap(index_);  // Trim capacity.
+  std::stable_sort(index_.begin(), index_.end());
+
+  if (fd_ >= 0) close(fd_);
+  fd_ = fd;
+
+  // DrawText() falls back to the replacement character, so we always want
+  // it. If the font does not have one, just pick any glyph so that we
+  // have a valid font to start with.
+  const IndexEntry *always = FindEntry(kUnicodeReplacementCodepoint);
+  if (always == NULL) always = &index_[0];
+  loaded_[always->codepoint] = kPinned;
+  return Rebuild();
+}
+
+const LazyFont::IndexEntry *LazyFont::FindEntry(uint32_t codepoint) const {
+  const IndexEntry search = { codepoint, 0, 0 };
+  std::vector<IndexEntry>::const_iterator found
+    = std::upper_bound(index_.begin(), index_.end(), search);
+  // upper_bound() gives us the last one of duplicates, which is what
+  // LoadFont() would use, as later definitions replace earlier ones.
+  if (found == index_.begin()) return NULL;
+  --found;
+  return found->codepoint == codepoint ? &*found : NULL;
+}
+
+// All glyphs missing for "utf8_text" are added with a single Rebuild().
+bool LazyFont::Prepare(const char *utf8_text) {
+  if (fd_ < 0) return false;
+  const uint64_t now = ++use_counter_;
+  std::vector<uint32_t> missing;
+  while (*utf8_text) {
+    const uint32_t cp = utf8_next_codepoint(&utf8_text);
+    std::map<uint32_t, uint64_t>::iterator found = loaded_.find(cp);
+    if (found != loaded_.end()) {
+      if (found->second != kPinned) found->second = now;
+      continue;
+    }
+    if (FindEntry(cp) == NULL) continue;  // Not in font.
+    missing.push_back(cp);
+  }
+  if (missing.empty()) return false;
+
+  const std::map<uint32_t, uint64_t> previous = loaded_;
+  for (size_t i = 0; i < missing.size(); ++i)
+    loaded_[missing[i]] = now;
+
+  if (max_glyphs_ > 0 && loaded_.size() > max_glyphs_) {
+    // Drop least recently used ones, but never what this text needs.
+    std::vector<std::pair<uint64_t, uint32_t> > candidates;
+    for (std::map<uint32_t, uint64_t>::const_iterator it = loaded_.begin();
+         it != loaded_.end(); ++it) {
+      if (it->second != kPinned && it->second != now)
+        candidates.push_back(std::make_pair(it->second, it->first));
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (size_t i = 0;
+         i < candidates.size() && loaded_.size() > max_glyphs_; ++i) {
+      loaded_.erase(candidates[i].second);
+    }
+  }
+  if (!Rebuild()) {
+    loaded_ = previous;  // So that the new glyphs are tried again.
+    return false;
+  }
+  return true;
+}
+
+bool LazyFont::Rebuild() {
+  std::string content = header_;
+  char chars_line[32];
+  snprintf(chars_line, sizeof(chars_line), "CHARS %d\n", (int)loaded_.size());
+  content.append(chars_line);
+  for (std::map<uint32_t, uint64_t>::const_iterator it = loaded_.begin();
+       it != loaded_.end(); ++it) {
+    const IndexEntry *entry = FindEntry(it->first);
+    const size_t pos = content.size();
+    content.resize(pos + entry->length);
+    if (pread(fd_, &content[pos], entry->length, entry->offset)
+        != (ssize_t)entry->length) {
+      return false;
+    }
+  }
+  content.append("ENDFONT\n");
+
+  // Font::LoadFont() wants a filename, so hand it an anonymous memory file.
+  // Without memfd or /proc, use a temporary file instead.
+  std::string path;
+  int tmp_fd = memfd_create("lazy-font", MFD_CLOEXEC);
+  if (tmp_fd >= 0) {
+    char proc_path[64];
+    snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", tmp_fd);
+    path = proc_path;
+    if (access(proc_path, R_OK) != 0) {
+      close(tmp_fd);
+      tmp_fd = -1;
+    }
+  }
+  const bool temporary_file = (tmp_fd < 0);
+  if (temporary_file) {
+    const char *dir = getenv("TMPDIR");
+    path = std::string(dir ? dir : "/tmp") + "/lazy-font-XXXXXX";
+    tmp_fd = mkostemp(&path[0], O_CLOEXEC);
+    if (tmp_fd < 0) return false;
+  }
+  bool success = (write(tmp_fd, content.data(), content.size())
+                  == (ssize_t)content.size());
+  if (success) {
+    Font *font = new Font();
+    success = font->LoadFont(path.c_str());
+    if (success) {
+      delete font_;
+      font_ = font;
+    } else {
+      delete font;
+    }
+  }
+  if (temporary_file) unlink(path.c_str());
+  close(tmp_fd);
+  return success;
+}
+}  // namespace rgb_matrix
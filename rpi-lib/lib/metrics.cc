@@ -0,0 +1,326 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "metrics.h"
+#include "udp-internal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace rgb_matrix {
+static void AppendNumber(double value, std::string *out) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.9g", value);
+  out->append(buffer);
+}
+
+static void AppendNumber(uint64_t value, std::string *out) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)value);
+  out->append(buffer);
+}
+
+void Metric::AppendHeader(const char *type, std::string *out) const {
+  out->append("# HELP ").append(name_).append(" ").append(help_);
+  out->append("\n# TYPE ").append(name_).append(" ").append(type);
+  out->append("\n");
+}
+
+void Counter::AppendTo(std::string *out) const {
+  AppendHeader("counter", out);
+  out->append(name_).append(" ");
+  AppendNumber(value(), out);
+  out->append("\n");
+}
+
+static uint64_t DoubleBits(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+Gauge::Gauge(const char *name, const char *help)
+  : Metric(name, help), bits_(DoubleBits(0.0)) {}
+
+void Gauge::Set(double value) {
+  bits_.store(DoubleBits(value), std::memory_order_relaxed);
+}
+
+double Gauge::value() const {
+  const uint64_t bits = bits_.load(std::memory_order_relaxed);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void Gauge::AppendTo(std::string *out) const {
+  AppendHeader("gauge", out);
+  out->append(name_).append(" ");
+  AppendNumber(value(), out);
+  out->append("\n");
+}
+
+Histogram::Histogram(const char *name, const char *help,
+                     const std::vector<double> &bucket_bounds)
+  : Metric(name, help), buckets_(bucket_bounds.size() + 1),
+    count_(0), sum_ns_(0) {
+  for (size_t i = 0; i < bucket_bounds.size(); ++i) {
+    bounds_ns_.push_back((int64_t)(bucket_bounds[i] * 1e9 + 0.5));
+  }
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::ObserveNanos(int64_t nanoseconds) {
+  size_t b = 0;
+  while (b < bounds_ns_.size() && nanoseconds > bounds_ns_[b]) ++b;
+  buckets_[b].fetch_add(1, std::memory_order_relaxed);
+  sum_ns_.fetch_add(nanoseconds, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Histogram::AppendTo(std::string *out) const {
+  // Scrapes are not atomic across the buckets; a value observed while
+  // formatting might show up in the count but not yet in a bucket. That
+  // is fine for monitoring and keeps ObserveNanos() lock-free.
+  AppendHeader("histogram", out);
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < buckets_.size(); ++i) {
+    cumulative += buckets_[i].load(std::memory_order_relaxed);
+    out->append(name_).append("_bucket{le=\"");
+    if (i < bounds_ns_.size())
+      AppendNumber(bounds_ns_[i] / 1e9, out);
+    else
+      out->append("+Inf");
+    out->append("\"} ");
+    AppendNumber(cumulative, out);
+    out->append("\n");
+  }
+  out->append(name_).append("_sum ");
+  AppendNumber(sum_ns_.load(std::memory_order_relaxed) / 1e9, out);
+  out->append("\n").append(name_).append("_count ");
+  AppendNumber(count_.load(std::memory_order_relaxed), out);
+  out->append("\n");
+}
+
+// Answers one HTTP request at a time; scrapes are rare and small.
+class Metrics::Server : public Thread {
+public:
+  // "socket_path" is removed when done, unless empty.
+  Server(const Metrics *metrics, int listen_fd, const std::string &socket_path)
+    : metrics_(metrics), listen_fd_(listen_fd), socket_path_(socket_path) {
+    if (pipe(stop_pipe_) < 0) stop_pipe_[0] = stop_pipe_[1] = -1;
+    // Signals such as Ctrl-C should go to the main thread.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    Start();
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+  }
+
+  ~Server() {
+    if (write(stop_pipe_[1], "x", 1) < 0) {}
+    WaitStopped();
+    close(stop_pipe_[0]);
+    close(stop_pipe_[1]);
+    close(listen_fd_);
+    if (!socket_path_.empty()) unlink(socket_path_.c_str());
+  }
+
+  virtual void Run() {
+    for (;;) {
+      struct pollfd fds[2] = { { listen_fd_, POLLIN, 0 },
+                               { stop_pipe_[0], POLLIN, 0 } };
+      if (poll(fds, 2, -1) < 0) {
+        if (errno == EINTR) continue;
+        return;
+      }
+      if (fds[1].revents) return;
+      const int fd = accept(listen_fd_, NULL, NULL);
+      if (fd < 0) continue;
+      HandleRequest(fd);
+      close(fd);
+    }
+  }
+
+private:
+  void HandleRequest(int fd) {
+    // Don't let a client that never finishes its request stall us.
+    struct timeval timeout = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos
+           && request.size() < 8192) {
+      const ssize_t r = read(fd, buffer, sizeof(buffer));
+      if (r <= 0) break;
+      request.append(buffer, r);
+    }
+    std::string status = "200 OK";
+    std::string body;
+    if (request.compare(0, 4, "GET ") != 0) {
+      status = "405 Method Not Allowed";
+    } else {
+      const size_t path_end = request.find_first_of(" ?", 4);
+      const std::string path = request.substr(4, path_end - 4);
+      if (path == "/metrics" || path == "/")
+        body = metrics_->Format();
+      else
+        status = "404 Not Found";
+    }
+    char header[256];
+    snprintf(header, sizeof(header),
+             "HTTP/1.0 %s\r\n"
+             "Content-Type: text/plain; version=0.0.4\r\n"
+             "Content-Length: %zu\r\n"
+             "Connection: close\r\n\r\n", status.c_str(), body.size());
+    std::string response = header + body;
+    const char *data = response.data();
+    size_t remaining = response.size();
+    while (remaining > 0) {
+      const ssize_t w = send(fd, data, remaining, MSG_NOSIGNAL);
+      if (w <= 0) break;
+      data += w;
+      remaining -= w;
+    }
+  }
+
+  const Metrics *const metrics_;
+  const int listen_fd_;
+  const std::string socket_path_;
+  int stop_pipe_[2];
+};
+
+Metrics::Metrics() : server_(NULL) {}
+
+Metrics::~Metrics() {
+  delete server_;
+  for (size_t i = 0; i < metrics_.size(); ++i) delete metrics_[i];
+}
+
+Metric *Metrics::Add(Metric *metric) {
+  MutexLock l(&mutex_);
+  metrics_.push_back(metric);
+  return metric;
+}
+
+Counter *Metrics::AddCounter(const char *name, const char *help) {
+  return static_cast<Counter*>(Add(new Counter(name, help)));
+}
+
+Gauge *Metrics::AddGauge(const char *name, const char *help) {
+  return static_cast<Gauge*>(Add(new Gauge(name, help)));
+}
+
+Histogram *Metrics::AddHistogram(const char *name, const char *help,
+                                 const std::vector<double> &bucket_bounds) {
+  return static_cast<Histogram*>(Add(new Histogram(name, help,
+                                                   bucket_bounds)));
+}
+
+std::string Metrics::Format() const {
+  std::string result;
+  MutexLock l(&mutex_);
+  for (size_t i = 0; i < metrics_.size(); ++i) {
+    metrics_[i]->AppendTo(&result);
+  }
+  return result;
+}
+
+static int ListenUnix(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+  unlink(path);  // Left over from a previous run.
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+      || listen(fd, 4) < 0) {
+    const int err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+  return fd;
+}
+
+// "port", "host:port" or "[ipv6-host]:port". Without a host, only listens
+// on the loopback interface; the metrics have no authentication.
+static int ListenTcp(const char *address) {
+  std::string host = "127.0.0.1";
+  const char *port;
+  if (!internal::SplitHostPort(address, &host, &port)) {
+    errno = EINVAL;
+    return -1;
+  }
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  struct addrinfo *result;
+  if (host.empty() || *port == '\0'
+      || getaddrinfo(host.c_str(), port, &hints, &result) != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  int fd = -1;
+  int err = EADDRNOTAVAIL;
+  for (struct addrinfo *ai = result; ai && fd < 0; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                ai->ai_protocol);
+    if (fd < 0) continue;
+    const int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0 || listen(fd, 4) < 0) {
+      err = errno;
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(result);
+  if (fd < 0) errno = err;
+  return fd;
+}
+
+bool Metrics::Serve(const char *address) {
+  if (server_ != NULL) {
+    errno = EBUSY;
+    return false;
+  }
+  const bool is_unix = (strncmp(address, "unix:", 5) == 0);
+  const int fd = is_unix ? ListenUnix(address + 5) : ListenTcp(address);
+  if (fd < 0) return false;
+  server_ = new Server(this, fd, is_unix ? address + 5 : "");
+  return true;
+}
+
+}  // namespace rgb_matrix
@@ -0,0 +1,45 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+
+#include "rgb-buffer.h"
+
+#include <string.h>
+
+namespace rgb_matrix {
+RGBBuffer::RGBBuffer(int width, int height)
+  : width_(width), height_(height), pixels_((size_t)3 * width * height) {
+}
+
+void RGBBuffer::SetPixel(int x, int y,
+                         uint8_t red, uint8_t green, uint8_t blue) {
+  if (x < 0 || x >= width_ || y < 0 || y >= height_) return;
+  uint8_t *p = &pixels_[3 * ((size_t)y * width_ + x)];
+  p[0] = red;
+  p[1] = green;
+  p[2] = blue;
+}
+
+void RGBBuffer::Clear() {
+  memset(&pixels_[0], 0, pixels_.size());
+}
+
+void RGBBuffer::Fill(uint8_t red, uint8_t green, uint8_t blue) {
+  for (size_t i = 0; i < pixels_.size(); i += 3) {
+    pixels_[i] = red;
+    pixels_[i + 1] = green;
+    pixels_[i + 2] = blue;
+  }
+}
+}  // namespace rgb_matrix
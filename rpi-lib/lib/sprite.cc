@@ -0,0 +1,244 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "sprite.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "graphics.h"
+#include "led-matrix.h"
+
+namespace rgb_matrix {
+namespace {
+static const int kSpanPixels = 256;
+static const float kFixedOne = 65536.0f;  // 16.16 fixed point.
+
+// Collects runs of adjacent pixels and writes them with one SetPixels()
+// if the canvas is a FrameCanvas.
+class SpanWriter {
+public:
+  explicit SpanWriter(Canvas *c)
+    : canvas_(c), frame_(dynamic_cast<FrameCanvas*>(c)), count_(0) {}
+  ~SpanWriter() { Flush(); }
+
+  void Put(int x, int y, const Color &color) {
+    if (frame_ == NULL) {
+      canvas_->SetPixel(x, y, color.r, color.g, color.b);
+      return;
+    }
+    if (count_ > 0 && (x != x_ + count_ || y != y_ || count_ == kSpanPixels))
+      Flush();
+    if (count_ == 0) {
+      x_ = x;
+      y_ = y;
+    }
+    span_[count_++] = color;
+  }
+
+  void Flush() {
+    if (count_ == 0) return;
+    frame_->SetPixels(x_, y_, count_, 1, span_);
+    count_ = 0;
+  }
+
+private:
+  Canvas *const canvas_;
+  FrameCanvas *const frame_;
+  int x_, y_, count_;
+  Color span_[kSpanPixels];
+};
+
+// Interpolates two bytes at once, in bits 0..7 and 16..23; "f" is 0..256.
+static inline uint32_t Lerp(uint32_t a, uint32_t b, int f) {
+  return ((a * (256 - f) + b * f) >> 8) & 0x00ff00ff;
+}
+
+static inline uint32_t RedBlue(const uint8_t *pixel) {
+  return pixel[0] | pixel[2] << 16;
+}
+
+// Samples "sprite" at 16.16 fixed point "u", "v", which are within it.
+// Returns false for transparent pixels.
+template <int kBytes, SpriteSampling kSampling>
+static inline bool Sample(const Sprite &sprite, int32_t u, int32_t v,
+                          Color *out) {
+  if (kSampling == SAMPLE_NEAREST) {
+    const uint8_t *p = sprite.pixels + (v >> 16) * sprite.stride
+      + (u >> 16) * kBytes;
+    if (kBytes == 4 && p[3] < 128) return false;
+    *out = Color(p[0], p[1], p[2]);
+    return true;
+  }
+
+  // Between the four pixel centers around the point, repeating the edges.
+  const int32_t su = u - 0x8000, sv = v - 0x8000;
+  const int fx = (su >> 8) & 0xff, fy = (sv >> 8) & 0xff;
+  const int x0 = std::max(su >> 16, 0);
+  const int y0 = std::max(sv >> 16, 0);
+  const int x1 = std::min((su >> 16) + 1, sprite.width - 1);
+  const int y1 = std::min((sv >> 16) + 1, sprite.height - 1);
+  const uint8_t *p00 = sprite.pixels + y0 * sprite.stride + x0 * kBytes;
+  const uint8_t *p10 = sprite.pixels + y0 * sprite.stride + x1 * kBytes;
+  const uint8_t *p01 = sprite.pixels + y1 * sprite.stride + x0 * kBytes;
+  const uint8_t *p11 = sprite.pixels + y1 * sprite.stride + x1 * kBytes;
+
+  if (kBytes == 3) {
+    // Red and blue interpolated together, in separate 16 bit lanes.
+    const uint32_t rb = Lerp(Lerp(RedBlue(p00), RedBlue(p10), fx),
+                             Lerp(RedBlue(p01), RedBlue(p11), fx), fy);
+    const uint32_t g = Lerp(Lerp(p00[1], p10[1], fx),
+                            Lerp(p01[1], p11[1], fx), fy);
+    *out = Color(rb & 0xff, g, rb >> 16);
+    return true;
+  }
+
+  // Colors weighted by alpha, so that transparent pixels don't darken the
+  // edges. Weights add up to about 256.
+  const int w00 = (256 - fx) * (256 - fy) >> 8, w10 = fx * (256 - fy) >> 8;
+  const int w01 = (256 - fx) * fy >> 8, w11 = fx * fy >> 8;
+  const int a00 = w00 * p00[3], a10 = w10 * p10[3];
+  const int a01 = w01 * p01[3], a11 = w11 * p11[3];
+  const int alpha = a00 + a10 + a01 + a11;
+  if (alpha < 128 * 256) return false;
+  uint8_t result[3];
+  for (int i = 0; i < 3; ++i) {
+    result[i] = (a00 * p00[i] + a10 * p10[i] + a01 * p01[i] + a11 * p11[i])
+      / alpha;
+  }
+  *out = Color(result[0], result[1], result[2]);
+  return true;
+}
+
+// Range of "x" with 0 <= start + step * x < limit, intersected with
+// [*begin, *end). Widened by a pixel; the fixed point check is exact.
+static inline void ClipRange(float start, float step, float limit,
+                             int *begin, int *end) {
+  // Less than one fixed point step per pixel, e.g. cos(90 degrees) which
+  // is not quite 0: the same for the whole row.
+  if (fabsf(step) < 1 / kFixedOne) {
+    if (start < 0 || start >= limit) *end = *begin;
+    return;
+  }
+  // Clamped while still float; a small step puts them out of int range.
+  const float x0 = -start / step, x1 = (limit - start) / step;
+  const float lo = *begin - 1, hi = *end + 1;
+  *begin = std::max(*begin, (int)floorf(std::max(std::min(x0, x1), lo)) - 1);
+  *end = std::min(*end, (int)ceilf(std::min(std::max(x0, x1), hi)) + 1);
+}
+
+template <int kBytes, SpriteSampling kSampling>
+static void DrawRows(Canvas *c, const Sprite &sprite,
+                     const AffineTransform &inverse,
+                     int y_begin, int y_end) {
+  const uint32_t u_limit = (uint32_t)sprite.width << 16;
+  const uint32_t v_limit = (uint32_t)sprite.height << 16;
+  const int32_t du = lroundf(inverse.a * kFixedOne);
+  const int32_t dv = lroundf(inverse.c * kFixedOne);
+  const int width = c->width();
+  SpanWriter out(c);
+  Color color;
+  for (int y = y_begin; y < y_end; ++y) {
+    // Sprite position of the center of pixel 0 in this row.
+    const float u0 = inverse.a * 0.5f + inverse.b * (y + 0.5f) + inverse.tx;
+    const float v0 = inverse.c * 0.5f + inverse.d * (y + 0.5f) + inverse.ty;
+    int x_begin = 0, x_end = width;
+    ClipRange(u0, inverse.a, sprite.width, &x_begin, &x_end);
+    ClipRange(v0, inverse.c, sprite.height, &x_begin, &x_end);
+    if (x_begin >= x_end) continue;
+
+    int32_t u = lroundf((u0 + inverse.a * x_begin) * kFixedOne);
+    int32_t v = lroundf((v0 + inverse.c * x_begin) * kFixedOne);
+    for (int x = x_begin; x < x_end; ++x, u += du, v += dv) {
+      if ((uint32_t)u < u_limit && (uint32_t)v < v_limit
+          && Sample<kBytes, kSampling>(sprite, u, v, &color)) {
+        out.Put(x, y, color);
+      }
+    }
+  }
+}
+}  // namespace
+
+AffineTransform &AffineTransform::Translate(float dx, float dy) {
+  tx += dx;
+  ty += dy;
+  return *this;
+}
+
+AffineTransform &AffineTransform::Scale(float sx, float sy) {
+  a *= sx; b *= sx; tx *= sx;
+  c *= sy; d *= sy; ty *= sy;
+  return *this;
+}
+
+AffineTransform &AffineTransform::Rotate(float radians) {
+  const float cos_r = cosf(radians), sin_r = sinf(radians);
+  const AffineTransform m = *this;
+  a = cos_r * m.a - sin_r * m.c;
+  b = cos_r * m.b - sin_r * m.d;
+  tx = cos_r * m.tx - sin_r * m.ty;
+  c = sin_r * m.a + cos_r * m.c;
+  d = sin_r * m.b + cos_r * m.d;
+  ty = sin_r * m.tx + cos_r * m.ty;
+  return *this;
+}
+
+bool AffineTransform::Invert(AffineTransform *inverse) const {
+  const float det = a * d - b * c;
+  if (fabsf(det) < 1e-9f) return false;
+  inverse->a = d / det;
+  inverse->b = -b / det;
+  inverse->c = -c / det;
+  inverse->d = a / det;
+  inverse->tx = -(inverse->a * tx + inverse->b * ty);
+  inverse->ty = -(inverse->c * tx + inverse->d * ty);
+  return true;
+}
+
+void DrawSprite(Canvas *c, const Sprite &sprite,
+                const AffineTransform &transform, SpriteSampling sampling) {
+  AffineTransform inverse;
+  if (sprite.width <= 0 || sprite.height <= 0
+      || !transform.Invert(&inverse)) {
+    return;
+  }
+
+  // Rows the corners of the sprite span.
+  float y_min = transform.ty, y_max = transform.ty;
+  const float corner_x[] = { (float)sprite.width, 0, (float)sprite.width };
+  const float corner_y[] = { 0, (float)sprite.height, (float)sprite.height };
+  for (int i = 0; i < 3; ++i) {
+    const float y = transform.c * corner_x[i] + transform.d * corner_y[i]
+      + transform.ty;
+    y_min = std::min(y_min, y);
+    y_max = std::max(y_max, y);
+  }
+  const int y_begin = std::max(0, (int)floorf(y_min));
+  const int y_end = std::min(c->height(), (int)ceilf(y_max));
+
+  const bool rgba = (sprite.format == Sprite::RGBA);
+  if (sampling == SAMPLE_NEAREST) {
+    if (rgba)
+      DrawRows<4, SAMPLE_NEAREST>(c, sprite, inverse, y_begin, y_end);
+    else
+      DrawRows<3, SAMPLE_NEAREST>(c, sprite, inverse, y_begin, y_end);
+  } else {
+    if (rgba)
+      DrawRows<4, SAMPLE_BILINEAR>(c, sprite, inverse, y_begin, y_end);
+    else
+      DrawRows<3, SAMPLE_BILINEAR>(c, sprite, inverse, y_begin, y_end);
+  }
+}
+}  // namespace rgb_matrix
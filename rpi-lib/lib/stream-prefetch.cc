@@ -0,0 +1,151 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "content-streamer.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+
+#include <deque>
+
+#include "led-matrix.h"
+#include "thread.h"
+
+namespace rgb_matrix {
+class PrefetchingStreamReader::Prefetcher : public Thread {
+public:
+  Prefetcher(StreamIO *io, const std::vector<FrameCanvas*> &canvases)
+    : reader_(io), free_(canvases), end_(false), rewind_(false),
+      stopping_(false), first_(true), underruns_(0) {
+    pthread_cond_init(&work_, NULL);
+    pthread_cond_init(&ready_, NULL);
+    Start();
+  }
+
+  ~Prefetcher() {
+    {
+      MutexLock l(&mutex_);
+      stopping_ = true;
+      pthread_cond_signal(&work_);
+    }
+    WaitStopped();
+    pthread_cond_destroy(&work_);
+    pthread_cond_destroy(&ready_);
+  }
+
+  void Rewind() {
+    MutexLock l(&mutex_);
+    rewind_ = true;
+    pthread_cond_signal(&work_);
+    while (rewind_) mutex_.WaitOn(&ready_);
+  }
+
+  bool GetNext(FrameCanvas *frame, uint32_t *hold_time_us) {
+    MutexLock l(&mutex_);
+    if (frames_.empty() && !end_ && !first_) ++underruns_;
+    first_ = false;
+    while (frames_.empty() && !end_) mutex_.WaitOn(&ready_);
+    if (frames_.empty()) return false;
+    const Frame next = frames_.front();
+    frames_.pop_front();
+
+    mutex_.Unlock();  // The canvas is neither free nor queued: ours.
+    frame->CopyFrom(*next.canvas);
+    mutex_.Lock();
+
+    if (hold_time_us) *hold_time_us = next.hold_time_us;
+    free_.push_back(next.canvas);
+    pthread_cond_signal(&work_);
+    return true;
+  }
+
+  int underruns() {
+    MutexLock l(&mutex_);
+    return underruns_;
+  }
+
+  void Run() final {
+    MutexLock l(&mutex_);
+    for (;;) {
+      while (!stopping_ && !rewind_ && (free_.empty() || end_))
+        mutex_.WaitOn(&work_);
+      if (stopping_) break;
+      if (rewind_) {
+        reader_.Rewind();
+        for (size_t i = 0; i < frames_.size(); ++i)
+          free_.push_back(frames_[i].canvas);
+        frames_.clear();
+        end_ = false;
+        first_ = true;
+        rewind_ = false;
+        pthread_cond_broadcast(&ready_);
+        continue;
+      }
+
+      Frame frame;
+      frame.canvas = free_.back();
+      free_.pop_back();
+      mutex_.Unlock();
+      const bool success = reader_.GetNext(frame.canvas, &frame.hold_time_us);
+      mutex_.Lock();
+      if (success && !rewind_) {
+        frames_.push_back(frame);
+      } else {
+        free_.push_back(frame.canvas);
+        if (!rewind_) end_ = true;  // End of stream or error.
+      }
+      pthread_cond_broadcast(&ready_);
+    }
+  }
+
+private:
+  struct Frame {
+    FrameCanvas *canvas;
+    uint32_t hold_time_us;
+  };
+
+  StreamReader reader_;  // Only used by the thread.
+  Mutex mutex_;
+  pthread_cond_t work_, ready_;
+  std::vector<FrameCanvas*> free_;
+  std::deque<Frame> frames_;  // Read ahead, in stream order.
+  bool end_;
+  bool rewind_;
+  bool stopping_;
+  bool first_;  // Nothing returned since start or rewind.
+  int underruns_;
+};
+
+PrefetchingStreamReader::PrefetchingStreamReader(
+  StreamIO *io, const std::vector<FrameCanvas*> &lookahead)
+  : prefetcher_(new Prefetcher(io, lookahead)) {}
+
+PrefetchingStreamReader::~PrefetchingStreamReader() { delete prefetcher_; }
+
+void PrefetchingStreamReader::Rewind() { prefetcher_->Rewind(); }
+
+bool PrefetchingStreamReader::GetNext(FrameCanvas *frame,
+                                      uint32_t *hold_time_us) {
+  return prefetcher_->GetNext(frame, hold_time_us);
+}
+
+int PrefetchingStreamReader::underruns() const {
+  return prefetcher_->underruns();
+}
+
+void AdviseSequentialRead(int fd) {
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+}
+}  // namespace rgb_matrix
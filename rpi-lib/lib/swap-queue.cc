@@ -0,0 +1,216 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "swap-queue.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "thread.h"
+
+namespace rgb_matrix {
+namespace {
+static const int kMinHistory = 64;
+
+static int64_t NowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long CeilMillis(int64_t nanos) { return (nanos + 999999) / 1000000; }
+}  // namespace
+
+// Takes frames off the queue and swaps them in. Everyone waits on the
+// same condition, which is broadcast on every change.
+class SwapQueue::Presenter : public Thread {
+public:
+  Presenter(SwapQueue *queue, RGBMatrix *matrix)
+    : queue_(queue), matrix_(matrix), stopping_(false) {
+    pthread_cond_init(&changed_, NULL);
+  }
+
+  ~Presenter() {
+    Stop();
+    pthread_cond_destroy(&changed_);
+  }
+
+  // Returns once the presenter is done swapping.
+  void Stop() {
+    {
+      MutexLock l(&mutex_);
+      stopping_ = true;
+      pthread_cond_broadcast(&changed_);
+    }
+    WaitStopped();
+  }
+
+  void Run() final {
+    MutexLock l(&mutex_);
+    while (!stopping_) {
+      if (queue_->queue_.empty()) {
+        mutex_.WaitOn(&changed_);
+        continue;
+      }
+      // Look again after waiting: the frame might have been dropped.
+      const Pending next = queue_->queue_.front();
+      const int64_t wait = next.present_at_nanos - NowNanos();
+      if (wait > 0) {
+        mutex_.WaitOn(&changed_, CeilMillis(wait));
+        continue;
+      }
+      queue_->queue_.pop_front();
+
+      mutex_.Unlock();
+      FrameCanvas *previous = matrix_->SwapOnVSync(next.frame,
+                                                   next.framerate_fraction);
+      const int64_t presented = NowNanos();
+      mutex_.Lock();
+
+      queue_->free_.push_back(previous);
+      queue_->Complete(next.fence, PRESENTED, presented);
+    }
+  }
+
+  Mutex mutex_;
+  pthread_cond_t changed_;
+
+private:
+  SwapQueue *const queue_;
+  RGBMatrix *const matrix_;
+  bool stopping_;
+};
+
+SwapQueue::SwapQueue(RGBMatrix *matrix, int depth, Policy policy)
+  : policy_(policy), presenter_(NULL), last_fence_(0) {
+  if (depth < 1) depth = 1;
+  for (int i = 0; i < depth + 1; ++i)
+    free_.push_back(matrix->CreateFrameCanvas());
+  // Enough to always remember the fences still pending.
+  const Record unused = { 0, PRESENTED, 0 };
+  history_.resize(std::max(kMinHistory, 2 * (depth + 2)), unused);
+  stats_.presented = stats_.dropped = 0;
+  stats_.acquire_wait_nanos = 0;
+  presenter_ = new Presenter(this, matrix);
+  presenter_->Start();
+}
+
+SwapQueue::~SwapQueue() {
+  presenter_->Stop();
+  for (size_t i = 0; i < queue_.size(); ++i)
+    Complete(queue_[i].fence, DROPPED, 0);
+  delete presenter_;
+}
+
+FrameCanvas *SwapQueue::Acquire() {
+  const int64_t start = NowNanos();
+  MutexLock l(&presenter_->mutex_);
+  FrameCanvas *result;
+  for (;;) {
+    if (!free_.empty()) {
+      result = free_.back();
+      free_.pop_back();
+      break;
+    }
+    if (policy_ == DROP_OLDEST && !queue_.empty()) {
+      result = queue_.front().frame;
+      Complete(queue_.front().fence, DROPPED, 0);
+      queue_.pop_front();
+      break;
+    }
+    presenter_->mutex_.WaitOn(&presenter_->changed_);
+  }
+  stats_.acquire_wait_nanos += NowNanos() - start;
+  return result;
+}
+
+SwapQueue::Fence SwapQueue::Submit(FrameCanvas *frame,
+                                   unsigned framerate_fraction,
+                                   int64_t present_at_nanos) {
+  MutexLock l(&presenter_->mutex_);
+  const Fence fence = ++last_fence_;
+  const Record pending = { fence, PENDING, 0 };
+  history_[fence % history_.size()] = pending;
+  const Pending entry = { frame, fence, framerate_fraction, present_at_nanos };
+  queue_.push_back(entry);
+  pthread_cond_broadcast(&presenter_->changed_);
+  return fence;
+}
+
+SwapQueue::FenceStatus SwapQueue::Status(Fence fence,
+                                         int64_t *presented_nanos) {
+  return Wait(fence, 0, presented_nanos);
+}
+
+SwapQueue::FenceStatus SwapQueue::Wait(Fence fence, long timeout_ms,
+                                       int64_t *presented_nanos) {
+  const int64_t deadline = NowNanos() + timeout_ms * 1000000LL;
+  MutexLock l(&presenter_->mutex_);
+  const Record *record;
+  while ((record = FindRecord(fence)) != NULL && record->status == PENDING) {
+    if (timeout_ms < 0) {
+      presenter_->mutex_.WaitOn(&presenter_->changed_);
+      continue;
+    }
+    const int64_t left = deadline - NowNanos();
+    if (left <= 0) break;
+    presenter_->mutex_.WaitOn(&presenter_->changed_, CeilMillis(left));
+  }
+  if (record == NULL) {  // Long forgotten.
+    if (presented_nanos) *presented_nanos = 0;
+    return PRESENTED;
+  }
+  if (presented_nanos) *presented_nanos = record->presented_nanos;
+  return record->status;
+}
+
+void SwapQueue::Flush() {
+  Fence last;
+  {
+    MutexLock l(&presenter_->mutex_);
+    last = last_fence_;
+  }
+  Wait(last);
+}
+
+SwapQueue::Stats SwapQueue::TakeStats() {
+  MutexLock l(&presenter_->mutex_);
+  const Stats result = stats_;
+  stats_.presented = stats_.dropped = 0;
+  stats_.acquire_wait_nanos = 0;
+  return result;
+}
+
+SwapQueue::Record *SwapQueue::FindRecord(Fence fence) {
+  Record *record = &history_[fence % history_.size()];
+  return record->fence == fence ? record : NULL;
+}
+
+// Called with the mutex held.
+void SwapQueue::Complete(Fence fence, FenceStatus status,
+                         int64_t presented_nanos) {
+  Record *record = FindRecord(fence);
+  if (record) {
+    record->status = status;
+    record->presented_nanos = presented_nanos;
+  }
+  if (status == PRESENTED)
+    stats_.presented++;
+  else
+    stats_.dropped++;
+  pthread_cond_broadcast(&presenter_->changed_);
+}
+}  // namespace rgb_matrix
@@ -0,0 +1,239 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "temporal-dither.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "thread.h"
+
+namespace rgb_matrix {
+namespace {
+static const int kMaxExtraBits = 4;
+static const int kMeasureRefreshes = 8;
+
+// Sub-frame phase of neighboring pixels, so that they don't all switch to
+// the upper level in the same refresh.
+static const uint8_t kPhase[4][4] = {
+  {  0,  8,  2, 10 },
+  { 12,  4, 14,  6 },
+  {  3, 11,  1,  9 },
+  { 15,  7, 13,  5 },
+};
+
+static int64_t NowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Same profile the framebuffer uses for luminance correction. 0.0 .. 1.0
+static float LuminanceCIE1931(uint8_t c, uint8_t brightness) {
+  const float v = c * brightness / 255.0f;
+  return (v <= 8) ? v / 902.3f : powf((v + 16) / 116.0f, 3);
+}
+
+// Level of "value" in the sub-frame that is "rank" in the cycle.
+static inline int SubFrameLevel(int value, int extra_bits, int rank) {
+  return (value >> extra_bits) + ((value & ((1 << extra_bits) - 1)) > rank);
+}
+
+static int ReverseBits(int value, int bits) {
+  int result = 0;
+  for (int i = 0; i < bits; ++i, value >>= 1)
+    result = (result << 1) | (value & 1);
+  return result;
+}
+}  // namespace
+
+DitherCanvas::Options::Options() : extra_bits(3), min_cycle_hz(100) {}
+
+// Swaps in the next sub-frame on every refresh.
+class DitherCanvas::Cycler : public Thread {
+public:
+  Cycler(RGBMatrix *matrix, const std::vector<FrameCanvas*> &frames)
+    : matrix_(matrix), frames_(frames), generation_(1), shown_generation_(0),
+      stopping_(false) {
+    pthread_cond_init(&shown_, NULL);
+  }
+
+  ~Cycler() {
+    Stop();
+    pthread_cond_destroy(&shown_);
+  }
+
+  // Show a new set of sub-frames. Returns with the previous set in
+  // "frames", once none of it is on the panel anymore.
+  void Exchange(std::vector<FrameCanvas*> *frames) {
+    MutexLock l(&mutex_);
+    frames_.swap(*frames);
+    ++generation_;
+    WaitShownLocked();
+  }
+
+  // Wait until the current set is on the panel.
+  void WaitShown() {
+    MutexLock l(&mutex_);
+    WaitShownLocked();
+  }
+
+  // Returns the set of sub-frames that was shown last.
+  std::vector<FrameCanvas*> Stop() {
+    {
+      MutexLock l(&mutex_);
+      stopping_ = true;
+      pthread_cond_broadcast(&shown_);
+    }
+    WaitStopped();
+    return frames_;
+  }
+
+  void Run() final {
+    unsigned int k = 0;
+    MutexLock l(&mutex_);
+    while (!stopping_) {
+      FrameCanvas *const frame = frames_[k++ % frames_.size()];
+      const uint64_t generation = generation_;
+      mutex_.Unlock();
+      matrix_->SwapOnVSync(frame);
+      mutex_.Lock();
+      if (shown_generation_ != generation) {
+        shown_generation_ = generation;
+        pthread_cond_broadcast(&shown_);
+      }
+    }
+  }
+
+private:
+  void WaitShownLocked() {
+    while (shown_generation_ != generation_ && !stopping_)
+      mutex_.WaitOn(&shown_);
+  }
+
+  RGBMatrix *const matrix_;
+  Mutex mutex_;
+  pthread_cond_t shown_;
+  std::vector<FrameCanvas*> frames_;
+  uint64_t generation_;
+  uint64_t shown_generation_;
+  bool stopping_;
+};
+
+DitherCanvas::DitherCanvas(RGBMatrix *matrix, const Options &options)
+  : matrix_(matrix), width_(matrix->width()), height_(matrix->height()),
+    extra_bits_(std::max(0, std::min(options.extra_bits, kMaxExtraBits))),
+    pixels_(width_ * height_ * 3, 0), cycler_(NULL) {
+  // The sub-frames can't cycle faster than the refresh rate.
+  matrix->SwapOnVSync(NULL);
+  const int64_t start = NowNanos();
+  for (int i = 0; i < kMeasureRefreshes; ++i)
+    matrix->SwapOnVSync(NULL);
+  const float refresh_hz = kMeasureRefreshes * 1e9f / (NowNanos() - start);
+  while (extra_bits_ > 0
+         && refresh_hz / (1 << extra_bits_) < options.min_cycle_hz) {
+    --extra_bits_;
+  }
+
+  // Two sets: one to show, one to render the next image into.
+  for (int i = 0; i < 2 << extra_bits_; ++i) {
+    FrameCanvas *frame = matrix->CreateFrameCanvas();
+    frame->set_luminance_correct(false);  // We do that with more bits.
+    frame->SetBrightness(100);
+    (i < 1 << extra_bits_ ? back_ : spare_).push_back(frame);
+  }
+}
+
+DitherCanvas::~DitherCanvas() { Stop(); }
+
+void DitherCanvas::SetPixel(int x, int y,
+                            uint8_t red, uint8_t green, uint8_t blue) {
+  if (x < 0 || x >= width_ || y < 0 || y >= height_) return;
+  uint8_t *pixel = &pixels_[3 * (y * width_ + x)];
+  pixel[0] = red;
+  pixel[1] = green;
+  pixel[2] = blue;
+}
+
+void DitherCanvas::Clear() {
+  memset(pixels_.data(), 0, pixels_.size());
+}
+
+void DitherCanvas::Fill(uint8_t red, uint8_t green, uint8_t blue) {
+  for (size_t i = 0; i < pixels_.size(); i += 3) {
+    pixels_[i] = red;
+    pixels_[i + 1] = green;
+    pixels_[i + 2] = blue;
+  }
+}
+
+void DitherCanvas::Show() {
+  Render();
+  if (cycler_ == NULL) {
+    cycler_ = new Cycler(matrix_, back_);
+    cycler_->Start();
+    cycler_->WaitShown();
+    back_.swap(spare_);
+  } else {
+    cycler_->Exchange(&back_);
+  }
+}
+
+void DitherCanvas::Stop() {
+  if (cycler_ == NULL) return;
+  spare_ = cycler_->Stop();
+  delete cycler_;
+  cycler_ = NULL;
+}
+
+// Each color is mapped to the exact output level in units of 1/n of what
+// the PWM bits can show. The integer part is shown in all n sub-frames,
+// the fraction f by showing the next level in f of them.
+void DitherCanvas::Render() {
+  const int pwm_bits = std::min<int>(back_[0]->pwmbits(), 8);
+  const int n = 1 << extra_bits_;
+  const int max_value = ((1 << pwm_bits) - 1) * n;
+  const int shift = 8 - pwm_bits;  // Without luminance correction.
+
+  uint16_t value[256];
+  const uint8_t brightness = matrix_->brightness();
+  for (int c = 0; c < 256; ++c)
+    value[c] = lroundf(LuminanceCIE1931(c, brightness) * max_value);
+
+  // Bit reversed, so that the sub-frames with the next level are spread
+  // evenly over the cycle.
+  int rank[1 << kMaxExtraBits];
+  for (int k = 0; k < n; ++k)
+    rank[k] = ReverseBits(k, extra_bits_);
+
+  const uint8_t *pixel = pixels_.data();
+  for (int y = 0; y < height_; ++y) {
+    for (int x = 0; x < width_; ++x, pixel += 3) {
+      const int phase = kPhase[y & 3][x & 3];
+      const int r = value[pixel[0]], g = value[pixel[1]], b = value[pixel[2]];
+      for (int k = 0; k < n; ++k) {
+        const int up = rank[(k + phase) & (n - 1)];
+        back_[k]->SetPixel(x, y,
+                           SubFrameLevel(r, extra_bits_, up) << shift,
+                           SubFrameLevel(g, extra_bits_, up) << shift,
+                           SubFrameLevel(b, extra_bits_, up) << shift);
+      }
+    }
+  }
+}
+}  // namespace rgb_matrix
@@ -0,0 +1,430 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Text measurement and a cache of laid-out text runs.
+
+#include "graphics.h"
+#include "led-matrix.h"
+#include "led-matrix-c.h"
+#include "trace-probes.h"
+#include "utf8-internal.h"
+
+#include <limits.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace rgb_matrix {
+// Fires the draw_text probe if it was traced from "start_ns" on and
+// returns "advance".
+static inline int DrawTextDone(const char *utf8_text, int advance,
+                               int64_t start_ns) {
+  if (start_ns != 0) {
+    RGB_MATRIX_PROBE3(draw_text, strlen(utf8_text), advance,
+                      probes::NowNs() - start_ns);
+  }
+  return advance;
+}
+
+// The advance DrawGlyph() would return for this codepoint.
+static int GlyphAdvance(const Font &font, uint32_t cp) {
+  int width = font.CharacterWidth(cp);
+  if (width < 0) width = font.CharacterWidth(kUnicodeReplacementCodepoint);
+  return width < 0 ? 0 : width;
+}
+
+int MeasureText(const Font &font, const char *utf8_text, int kerning_offset) {
+  int width = 0;
+  while (*utf8_text) {
+    width += GlyphAdvance(font, utf8_next_codepoint(&utf8_text));
+    width += kerning_offset;
+  }
+  return width;
+}
+
+namespace {
+// We lay out text by letting the regular DrawText() draw into this canvas
+// and record where pixels end up. Coordinates are relative to the origin
+// passed to DrawText(), which is far from the edges so that nothing is
+// clipped.
+class RecordingCanvas : public Canvas {
+public:
+  static const int kOrigin = 1 << 20;
+
+  struct Write {
+    int y, x;
+    bool foreground;
+    // Row order, which is friendlier to the framebuffer memory layout.
+    bool operator<(const Write &other) const {
+      return y != other.y ? y < other.y : x < other.x;
+    }
+  };
+
+  virtual int width() const { return 2 * kOrigin; }
+  virtual int height() const { return 2 * kOrigin; }
+  virtual void SetPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b) {
+    const Write w = { y - kOrigin, x - kOrigin, r != 0 };
+    writes_.push_back(w);
+  }
+  virtual void Clear() {}
+  virtual void Fill(uint8_t red, uint8_t green, uint8_t blue) {}
+
+  // All writes in the order they happened; sorting with stable_sort()
+  // keeps that order among writes to the same pixel.
+  std::vector<Write> writes_;
+};
+
+// Records the foreground pixels of glyphs drawn with DrawGlyph() that fall
+// within the target canvas or the one pixel border around it, which is
+// where an outline could still become visible.
+class FillRecorder : public Canvas {
+public:
+  FillRecorder(int width, int height) : width_(width), height_(height) {}
+
+  virtual int width() const { return width_; }
+  virtual int height() const { return height_; }
+  virtual void SetPixel(int x, int y, uint8_t r, uint8_t g, uint8_t b) {
+    if (x < -1 || x > width_ || y < -1 || y > height_) return;
+    pixels_.push_back(std::make_pair(x, y));
+  }
+  virtual void Clear() {}
+  virtual void Fill(uint8_t red, uint8_t green, uint8_t blue) {}
+
+  const std::vector<std::pair<int, int> > &pixels() const { return pixels_; }
+
+private:
+  const int width_;
+  const int height_;
+  std::vector<std::pair<int, int> > pixels_;
+};
+
+// Given the fill pixels of some text, determine the combined mask of fill
+// and outline and call emit(x, y, is_fill) exactly once for each pixel that
+// is set, in row-major order.
+//
+// The outline is the same as CreateOutlineFont() produces: every pixel in the
+// 8-neighborhood of a fill pixel that is not a fill pixel itself. Since the
+// regular text is drawn on top of the outline, fill always wins where the
+// outline of one character overlaps with a neighboring character.
+template <class Emit>
+void ComposeOutline(const std::vector<std::pair<int, int> > &fill,
+                    const Emit &emit) {
+  if (fill.empty()) return;
+  int min_x = INT_MAX, max_x = INT_MIN, min_y = INT_MAX, max_y = INT_MIN;
+  for (size_t i = 0; i < fill.size(); ++i) {
+    min_x = std::min(min_x, fill[i].first);
+    max_x = std::max(max_x, fill[i].first);
+    min_y = std::min(min_y, fill[i].second);
+    max_y = std::max(max_y, fill[i].second);
+  }
+  // Grid with one pixel border all around.
+  const int x0 = min_x - 1, y0 = min_y - 1;
+  const int w = max_x - min_x + 3, h = max_y - min_y + 3;
+  enum { kEmpty = 0, kOutline = 1, kFill = 2 };
+  std::vector<uint8_t> mask((size_t)w * h, kEmpty);
+  for (size_t i = 0; i < fill.size(); ++i) {
+    mask[(size_t)(fill[i].second - y0) * w + (fill[i].first - x0)] = kFill;
+  }
+  for (int y = 1; y < h - 1; ++y) {
+    for (int x = 1; x < w - 1; ++x) {
+      if (mask[(size_t)y * w + x] != kFill) continue;
+      for (int dy = -1; dy <= 1; ++dy) {
+        uint8_t *row = &mask[(size_t)(y + dy) * w + x];
+        if (row[-1] == kEmpty) row[-1] = kOutline;
+        if (row[0] == kEmpty) row[0] = kOutline;
+        if (row[1] == kEmpty) row[1] = kOutline;
+      }
+    }
+  }
+  for (int y = 0; y < h; ++y) {
+    const uint8_t *row = &mask[(size_t)y * w];
+    for (int x = 0; x < w; ++x) {
+      if (row[x] != kEmpty) emit(x0 + x, y0 + y, row[x] == kFill);
+    }
+  }
+}
+
+// Emits straight to a canvas.
+struct CanvasEmitter {
+  CanvasEmitter(Canvas *c, const Color &fill, const Color &outline)
+    : canvas(c), fill_color(fill), outline_color(outline) {}
+  void operator()(int x, int y, bool is_fill) const {
+    const Color &col = is_fill ? fill_color : outline_color;
+    canvas->SetPixel(x, y, col.r, col.g, col.b);
+  }
+  Canvas *const canvas;
+  const Color &fill_color;
+  const Color &outline_color;
+};
+}  // anonymous namespace
+
+int DrawTextOutlined(Canvas *c, const Font &font, int x, int y,
+                     const Color &color, const Color &outline_color,
+                     const char *utf8_text, int kerning_offset) {
+  const int64_t start_ns = RGB_MATRIX_PROBE_START_NS(draw_text);
+  FillRecorder recorder(c->width(), c->height());
+  const Color fg(255, 255, 255);
+  const int advance = rgb_matrix::DrawText(&recorder, font, x, y, fg, NULL,
+                                           utf8_text, kerning_offset);
+  ComposeOutline(recorder.pixels(),
+                 CanvasEmitter(c, color, outline_color));
+  return DrawTextDone(utf8_text, advance, start_ns);
+}
+
+struct TextRunCache::Run {
+  struct Pixel {
+    int dx;
+    int dy;
+  };
+
+  std::string key;
+  int advance;
+  std::vector<int> char_offsets;
+
+  // Pixels if drawn without background.
+  std::vector<Pixel> foreground;
+
+  // If drawn with background, the final kind of each pixel touched.
+  std::vector<Pixel> with_bg_pixels;
+  std::vector<uint8_t> with_bg_is_foreground;
+
+  // Combined fill and outline mask, computed on first use.
+  bool has_outline;
+  std::vector<Pixel> outlined_pixels;
+  std::vector<uint8_t> outlined_is_fill;
+
+  int min_dy, max_dy;  // Vertical extent of all pixels for quick clipping.
+};
+
+// Scrolling text is mostly outside the canvas; skip these pixels before
+// paying for the virtual SetPixel() call.
+static inline bool IsInside(int x, int y, int width, int height) {
+  return (unsigned)x < (unsigned)width && (unsigned)y < (unsigned)height;
+}
+
+TextRunCache::TextRunCache(int max_runs)
+  : max_runs_(max_runs < 1 ? 1 : max_runs) {
+}
+
+TextRunCache::~TextRunCache() {
+  Clear();
+}
+
+void TextRunCache::Clear() {
+  for (RunList::iterator it = lru_.begin(); it != lru_.end(); ++it) {
+    delete *it;
+  }
+  lru_.clear();
+  index_.clear();
+}
+
+TextRunCache::Run *TextRunCache::FindOrCreate(const Font &font,
+                                              const char *utf8_text,
+                                              int kerning_offset) {
+  std::string key;
+  const Font *font_ptr = &font;
+  key.append(reinterpret_cast<const char*>(&font_ptr), sizeof(font_ptr));
+  key.append(reinterpret_cast<const char*>(&kerning_offset),
+             sizeof(kerning_offset));
+  key.append(utf8_text);
+
+  std::map<std::string, RunList::iterator>::iterator found = index_.find(key);
+  if (found != index_.end()) {
+    lru_.splice(lru_.begin(), lru_, found->second);  // Most recent to front.
+    return *found->second;
+  }
+
+  Run *run = new Run();
+  run->key = key;
+  run->has_outline = false;
+
+  // Character positions.
+  run->advance = 0;
+  for (const char *it = utf8_text; *it; /**/) {
+    run->char_offsets.push_back(run->advance);
+    run->advance += GlyphAdvance(font, utf8_next_codepoint(&it));
+    run->advance += kerning_offset;
+  }
+
+  // Pixel mask. Foreground is recorded as red=1, background as black.
+  RecordingCanvas recorder;
+  const Color fg(1, 0, 0);
+  const Color bg(0, 0, 0);
+  rgb_matrix::DrawText(&recorder, font,
+                       RecordingCanvas::kOrigin, RecordingCanvas::kOrigin,
+                       fg, &bg, utf8_text, kerning_offset);
+  run->min_dy = INT_MAX;
+  run->max_dy = INT_MIN;
+  std::vector<RecordingCanvas::Write> &writes = recorder.writes_;
+  std::stable_sort(writes.begin(), writes.end());
+  for (size_t i = 0; i < writes.size(); /**/) {
+    // All writes to one pixel. With background, the last one counts;
+    // without, the pixel is foreground if any glyph set it.
+    size_t last = i;
+    bool any_foreground = writes[i].foreground;
+    while (last + 1 < writes.size() && !(writes[i] < writes[last + 1])) {
+      ++last;
+      any_foreground |= writes[last].foreground;
+    }
+    const Run::Pixel p = { writes[i].x, writes[i].y };
+    run->with_bg_pixels.push_back(p);
+    run->with_bg_is_foreground.push_back(writes[last].foreground);
+    if (any_foreground) run->foreground.push_back(p);
+    run->min_dy = std::min(run->min_dy, p.dy);
+    run->max_dy = std::max(run->max_dy, p.dy);
+    i = last + 1;
+  }
+
+  if (run->with_bg_pixels.empty()) {
+    run->min_dy = run->max_dy = 0;
+  }
+
+  lru_.push_front(run);
+  index_[key] = lru_.begin();
+  while (lru_.size() > max_runs_) {
+    Run *evict = lru_.back();
+    index_.erase(evict->key);
+    lru_.pop_back();
+    delete evict;
+  }
+  return run;
+}
+
+int TextRunCache::MeasureText(const Font &font, const char *utf8_text,
+                              int kerning_offset) {
+  return FindOrCreate(font, utf8_text, kerning_offset)->advance;
+}
+
+int TextRunCache::DrawTextOutlined(Canvas *c, const Font &font, int x, int y,
+                                   const Color &color,
+                                   const Color &outline_color,
+                                   const char *utf8_text, int kerning_offset) {
+  const int64_t start_ns = RGB_MATRIX_PROBE_START_NS(draw_text);
+  Run *run = FindOrCreate(font, utf8_text, kerning_offset);
+  if (!run->has_outline) {
+    std::vector<std::pair<int, int> > fill;
+    for (size_t i = 0; i < run->foreground.size(); ++i) {
+      fill.push_back(std::make_pair(run->foreground[i].dx,
+                                    run->foreground[i].dy));
+    }
+    ComposeOutline(fill, [run](int px, int py, bool is_fill) {
+        const Run::Pixel p = { px, py };
+        run->outlined_pixels.push_back(p);
+        run->outlined_is_fill.push_back(is_fill);
+      });
+    run->has_outline = true;
+  }
+  if (y + run->max_dy + 1 < 0 || y + run->min_dy - 1 >= c->height())
+    return DrawTextDone(utf8_text, run->advance, start_ns);  // Invisible.
+  const int width = c->width();
+  const int height = c->height();
+  for (size_t i = 0; i < run->outlined_pixels.size(); ++i) {
+    const Run::Pixel &p = run->outlined_pixels[i];
+    if (!IsInside(x + p.dx, y + p.dy, width, height)) continue;
+    const Color &col = run->outlined_is_fill[i] ? color : outline_color;
+    c->SetPixel(x + p.dx, y + p.dy, col.r, col.g, col.b);
+  }
+  return DrawTextDone(utf8_text, run->advance, start_ns);
+}
+
+int TextRunCache::GetCharacterOffsets(const Font &font, const char *utf8_text,
+                                      int kerning_offset,
+                                      std::vector<int> *offsets) {
+  const Run *run = FindOrCreate(font, utf8_text, kerning_offset);
+  if (offsets) *offsets = run->char_offsets;
+  return (int)run->char_offsets.size();
+}
+
+int TextRunCache::DrawText(Canvas *c, const Font &font, int x, int y,
+                           const Color &color, const Color *background_color,
+                           const char *utf8_text, int kerning_offset) {
+  const int64_t start_ns = RGB_MATRIX_PROBE_START_NS(draw_text);
+  const Run *run = FindOrCreate(font, utf8_text, kerning_offset);
+  if (y + run->max_dy < 0 || y + run->min_dy >= c->height())
+    return DrawTextDone(utf8_text, run->advance, start_ns);  // Invisible.
+  const int width = c->width();
+  const int height = c->height();
+  if (background_color == NULL) {
+    const Run::Pixel *p = run->foreground.data();
+    const Run::Pixel *const end = p + run->foreground.size();
+    for (/**/; p != end; ++p) {
+      if (!IsInside(x + p->dx, y + p->dy, width, height)) continue;
+      c->SetPixel(x + p->dx, y + p->dy, color.r, color.g, color.b);
+    }
+  } else {
+    const Color &bg = *background_color;
+    for (size_t i = 0; i < run->with_bg_pixels.size(); ++i) {
+      const Run::Pixel &p = run->with_bg_pixels[i];
+      if (!IsInside(x + p.dx, y + p.dy, width, height)) continue;
+      if (run->with_bg_is_foreground[i])
+        c->SetPixel(x + p.dx, y + p.dy, color.r, color.g, color.b);
+      else
+        c->SetPixel(x + p.dx, y + p.dy, bg.r, bg.g, bg.b);
+    }
+  }
+  return DrawTextDone(utf8_text, run->advance, start_ns);
+}
+}  // namespace rgb_matrix
+
+// -- C-API
+static rgb_matrix::Font *to_font(struct LedFont *font) {
+  return reinterpret_cast<rgb_matrix::Font*>(font);
+}
+
+static rgb_matrix::TextRunCache *to_cache(struct LedTextRunCache *cache) {
+  return reinterpret_cast<rgb_matrix::TextRunCache*>(cache);
+}
+
+static rgb_matrix::FrameCanvas *to_canvas(struct LedCanvas *canvas) {
+  return reinterpret_cast<rgb_matrix::FrameCanvas*>(canvas);
+}
+
+int measure_text(struct LedFont *font, const char *utf8_text,
+                 int kerning_offset) {
+  return rgb_matrix::MeasureText(*to_font(font), utf8_text, kerning_offset);
+}
+
+int draw_text_outlined(struct LedCanvas *c, struct LedFont *font, int x, int y,
+                       uint8_t r, uint8_t g, uint8_t b,
+                       uint8_t outline_r, uint8_t outline_g, uint8_t outline_b,
+                       const char *utf8_text, int kerning_offset) {
+  const rgb_matrix::Color col(r, g, b);
+  const rgb_matrix::Color outline(outline_r, outline_g, outline_b);
+  return rgb_matrix::DrawTextOutlined(to_canvas(c), *to_font(font), x, y,
+                                      col, outline, utf8_text, kerning_offset);
+}
+
+struct LedTextRunCache *create_text_run_cache(int max_runs) {
+  return reinterpret_cast<struct LedTextRunCache*>(
+    new rgb_matrix::TextRunCache(max_runs));
+}
+
+void delete_text_run_cache(struct LedTextRunCache *cache) {
+  delete to_cache(cache);
+}
+
+int measure_text_cached(struct LedTextRunCache *cache, struct LedFont *font,
+                        const char *utf8_text, int kerning_offset) {
+  return to_cache(cache)->MeasureText(*to_font(font), utf8_text,
+                                      kerning_offset);
+}
+
+int draw_text_cached(struct LedTextRunCache *cache,
+                     struct LedCanvas *c, struct LedFont *font, int x, int y,
+                     uint8_t r, uint8_t g, uint8_t b,
+                     const char *utf8_text, int kerning_offset) {
+  const rgb_matrix::Color col(r, g, b);
+  return to_cache(cache)->DrawText(to_canvas(c), *to_font(font), x, y,
+                                   col, NULL, utf8_text, kerning_offset);
+}
@@ -0,0 +1,27 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+
+#include "trace-probes.h"
+
+// The semaphores of the probes in trace-probes.h. Tracers find them in
+// the ".probes" section and count up while attached. Always defined, so
+// that programs built with <sys/sdt.h> link against a library without.
+#define RGB_MATRIX_PROBE_SEMAPHORE(name)                 \
+  volatile unsigned short rgbmatrix_##name##_semaphore  \
+  __attribute__((section(".probes"))) = 0
+
+RGB_MATRIX_PROBE_SEMAPHORE(swap_start);
+RGB_MATRIX_PROBE_SEMAPHORE(swap_done);
+RGB_MATRIX_PROBE_SEMAPHORE(draw_text);
@@ -0,0 +1,210 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#include "transitions.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace rgb_matrix {
+namespace {
+// Generic vectors, which the compiler maps to NEON or SSE2 where available
+// and to plain integer code elsewhere.
+typedef uint8_t u8x16 __attribute__((vector_size(16)));
+typedef uint16_t u16x8 __attribute__((vector_size(16)));
+
+static_assert(sizeof(Color) == 3, "Color is used as RGB24");
+
+// Unaligned loads and stores.
+template <typename V> static inline V Load(const uint8_t *p) {
+  V result;
+  memcpy(&result, p, sizeof(result));
+  return result;
+}
+template <typename V> static inline void Store(uint8_t *p, const V &v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+// out = (a * (256 - alpha) + b * alpha) / 256, alpha 1..255.
+static void CrossfadeBytes(const uint8_t *a, const uint8_t *b, uint8_t *out,
+                           size_t count, uint16_t alpha) {
+  const uint16_t inv = 256 - alpha;
+  size_t i = 0;
+  for (/**/; i + 16 <= count; i += 16) {
+    const u16x8 va = Load<u16x8>(a + i);
+    const u16x8 vb = Load<u16x8>(b + i);
+    // Each 16 bit lane holds two bytes; blend them separately.
+    const u16x8 even = ((va & 0xff) * inv + (vb & 0xff) * alpha) >> 8;
+    const u16x8 odd = ((va >> 8) * inv + (vb >> 8) * alpha) & 0xff00;
+    Store(out + i, even | odd);
+  }
+  for (/**/; i < count; ++i)
+    out[i] = (a[i] * inv + b[i] * alpha) >> 8;
+}
+
+// out = (order < level) ? b : a, level 1..255.
+static void DissolveBytes(const uint8_t *a, const uint8_t *b,
+                          const uint8_t *order, uint8_t *out,
+                          size_t count, uint8_t level) {
+  size_t i = 0;
+  for (/**/; i + 16 <= count; i += 16) {
+    const u8x16 mask = (u8x16)(Load<u8x16>(order + i) < level);
+    Store(out + i, (Load<u8x16>(b + i) & mask)
+          | (Load<u8x16>(a + i) & ~mask));
+  }
+  for (/**/; i < count; ++i)
+    out[i] = (order[i] < level) ? b[i] : a[i];
+}
+
+// Well mixed 8 bit value per pixel, the same on every run.
+static uint8_t PixelHash(uint32_t i) {
+  i ^= i >> 16;
+  i *= 0x7feb352d;
+  i ^= i >> 15;
+  i *= 0x846ca68b;
+  i ^= i >> 16;
+  return i >> 24;
+}
+}  // namespace
+
+Transition::Transition(Type type, int width, int height,
+                       const uint8_t *from, const uint8_t *to)
+  : type_(type), width_(width), height_(height), from_(from), to_(to),
+    frame_(width * height) {
+  if (type_ == DISSOLVE) {
+    dissolve_order_.resize(3 * width * height);
+    for (int i = 0; i < width * height; ++i) {
+      memset(&dissolve_order_[3 * i], PixelHash(i), 3);
+    }
+  }
+}
+
+Transition::Transition(Type type, const RGBBuffer &from, const RGBBuffer &to)
+  : Transition(type, to.width(), to.height(),
+               (from.width() == to.width() && from.height() == to.height())
+               ? from.data() : to.data(),
+               to.data()) {
+}
+
+const uint8_t *Transition::Blend(float progress) {
+  progress = std::max(0.0f, std::min(progress, 1.0f));
+  uint8_t *const out = reinterpret_cast<uint8_t*>(frame_.data());
+  const size_t bytes = 3 * width_ * height_;
+  const int level = (int)(progress * 256 + 0.5f);  // 0..256
+
+  switch (type_) {
+  case CROSSFADE:
+  case DISSOLVE:
+    if (level == 0) {
+      memcpy(out, from_, bytes);
+    } else if (level == 256) {
+      memcpy(out, to_, bytes);
+    } else if (type_ == CROSSFADE) {
+      CrossfadeBytes(from_, to_, out, bytes, level);
+    } else {
+      DissolveBytes(from_, to_, dissolve_order_.data(), out, bytes, level);
+    }
+    break;
+  case WIPE_LEFT: case WIPE_RIGHT:
+    Wipe((int)(progress * width_ + 0.5f));
+    break;
+  case WIPE_UP: case WIPE_DOWN:
+    Wipe((int)(progress * height_ + 0.5f));
+    break;
+  case SLIDE_LEFT: case SLIDE_RIGHT:
+    Slide((int)(progress * width_ + 0.5f));
+    break;
+  case SLIDE_UP: case SLIDE_DOWN:
+    Slide((int)(progress * height_ + 0.5f));
+    break;
+  }
+  return out;
+}
+
+void Transition::Render(float progress, FrameCanvas *canvas, int x, int y) {
+  Blend(progress);
+  canvas->SetPixels(x, y, width_, height_, frame_.data());
+}
+
+// "edge" columns or rows of "to" are showing.
+void Transition::Wipe(int edge) {
+  uint8_t *const out = reinterpret_cast<uint8_t*>(frame_.data());
+  const int stride = 3 * width_;
+  switch (type_) {
+  case WIPE_LEFT:
+  case WIPE_RIGHT: {
+    // Bytes per row from the left image, then from the right one.
+    const int split = 3 * (type_ == WIPE_LEFT ? width_ - edge : edge);
+    const uint8_t *left = (type_ == WIPE_LEFT) ? from_ : to_;
+    const uint8_t *right = (type_ == WIPE_LEFT) ? to_ : from_;
+    for (int y = 0; y < height_; ++y) {
+      const int row = y * stride;
+      memcpy(out + row, left + row, split);
+      memcpy(out + row + split, right + row + split, stride - split);
+    }
+    break;
+  }
+  case WIPE_UP:
+  case WIPE_DOWN: {
+    const int split = stride * (type_ == WIPE_UP ? height_ - edge : edge);
+    const uint8_t *top = (type_ == WIPE_UP) ? from_ : to_;
+    const uint8_t *bottom = (type_ == WIPE_UP) ? to_ : from_;
+    memcpy(out, top, split);
+    memcpy(out + split, bottom + split, stride * height_ - split);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// "to" moved in by "offset" columns or rows.
+void Transition::Slide(int offset) {
+  uint8_t *const out = reinterpret_cast<uint8_t*>(frame_.data());
+  const int stride = 3 * width_;
+  switch (type_) {
+  case SLIDE_LEFT:
+  case SLIDE_RIGHT: {
+    const int shift = 3 * offset;
+    for (int y = 0; y < height_; ++y) {
+      const int row = y * stride;
+      if (type_ == SLIDE_LEFT) {
+        memcpy(out + row, from_ + row + shift, stride - shift);
+        memcpy(out + row + stride - shift, to_ + row, shift);
+      } else {
+        memcpy(out + row, to_ + row + stride - shift, shift);
+        memcpy(out + row + shift, from_ + row, stride - shift);
+      }
+    }
+    break;
+  }
+  case SLIDE_UP:
+  case SLIDE_DOWN: {
+    const int shift = stride * offset;
+    const int total = stride * height_;
+    if (type_ == SLIDE_UP) {
+      memcpy(out, from_ + shift, total - shift);
+      memcpy(out + total - shift, to_, shift);
+    } else {
+      memcpy(out, to_ + total - shift, shift);
+      memcpy(out + shift, from_, total - shift);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+}  // namespace rgb_matrix
@@ -0,0 +1,126 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Helpers shared by the UDP protocols (genlock, frame distribution) and
+// the metrics server.
+
+#ifndef RPI_UDP_INTERNAL_H
+#define RPI_UDP_INTERNAL_H
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace rgb_matrix {
+namespace internal {
+inline void PutBigEndian(uint64_t v, int bytes, uint8_t *out) {
+  for (int i = bytes - 1; i >= 0; --i, v >>= 8) out[i] = v & 0xff;
+}
+
+inline uint64_t GetBigEndian(const uint8_t *in, int bytes) {
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; ++i) v = (v << 8) | in[i];
+  return v;
+}
+
+inline int64_t MonotonicNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// poll() timeout for the given time span, rounded up.
+inline int TimeoutMillis(int64_t nanos) {
+  if (nanos <= 0) return 0;
+  return (int)((nanos + 999999) / 1000000);
+}
+
+// Split "host:port", "[host]:port" (for IPv6 addresses) or just "port".
+// "host" is left alone if there is none. Returns false if the brackets
+// are not followed by ":port".
+inline bool SplitHostPort(const char *address, std::string *host,
+                          const char **port) {
+  *port = address;
+  if (address[0] == '[') {
+    const char *end = strchr(address, ']');
+    if (end == NULL || end[1] != ':') return false;
+    host->assign(address + 1, end - address - 1);
+    *port = end + 2;
+    return true;
+  }
+  const char *colon = strrchr(address, ':');
+  if (colon) {
+    host->assign(address, colon - address);
+    *port = colon + 1;
+  }
+  return true;
+}
+
+// Resolve "host:port", "[host]:port", or just "port" for the wildcard
+// address if "passive". Returns NULL and sets errno on failure; free with
+// freeaddrinfo().
+inline struct addrinfo *ResolveUdp(const char *address, bool passive) {
+  std::string host;
+  const char *port;
+  if (!SplitHostPort(address, &host, &port) || *port == '\0') {
+    errno = EINVAL;
+    return NULL;
+  }
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+  struct addrinfo *result;
+  if (getaddrinfo(host.empty() ? NULL : host.c_str(), port,
+                  &hints, &result) != 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return result;
+}
+
+// A UDP socket bound to (if "passive") or connected to "address".
+// Returns -1 and sets errno on failure.
+inline int OpenUdp(const char *address, bool passive) {
+  struct addrinfo *result = ResolveUdp(address, passive);
+  if (result == NULL) return -1;
+  int fd = -1;
+  int err = EADDRNOTAVAIL;
+  for (struct addrinfo *ai = result; ai && fd < 0; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                ai->ai_protocol);
+    if (fd < 0) continue;
+    const int r = passive ? bind(fd, ai->ai_addr, ai->ai_addrlen)
+      : connect(fd, ai->ai_addr, ai->ai_addrlen);
+    if (r < 0) {
+      err = errno;
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(result);
+  if (fd < 0) errno = err;
+  return fd;
+}
+}  // namespace internal
+}  // namespace rgb_matrix
+
+#endif  // RPI_UDP_INTERNAL_H
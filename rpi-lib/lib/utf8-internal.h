@@ -0,0 +1,49 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+#ifndef RPI_UTF8_INTERNAL_H
+#define RPI_UTF8_INTERNAL_H
+
+#include <stdint.h>
+
+namespace rgb_matrix {
+static const uint32_t kUnicodeReplacementCodepoint = 0xFFFD;
+
+// Decode the next codepoint from a NUL-terminated UTF-8 string and advance
+// the pointer. Truncated or invalid sequences decode as the replacement
+// character; we never read past the terminating NUL.
+inline uint32_t utf8_next_codepoint(const char **it) {
+  const uint8_t *p = reinterpret_cast<const uint8_t*>(*it);
+  uint32_t cp = *p++;
+  if (cp < 0x80) {
+    // ascii
+  } else if ((cp & 0xE0) == 0xC0 && p[0]) {
+    cp = ((cp & 0x1F) << 6) | (p[0] & 0x3F);
+    p += 1;
+  } else if ((cp & 0xF0) == 0xE0 && p[0] && p[1]) {
+    cp = ((cp & 0x0F) << 12) | ((p[0] & 0x3F) << 6) | (p[1] & 0x3F);
+    p += 2;
+  } else if ((cp & 0xF8) == 0xF0 && p[0] && p[1] && p[2]) {
+    cp = ((cp & 0x07) << 18) | ((p[0] & 0x3F) << 12) | ((p[1] & 0x3F) << 6)
+      | (p[2] & 0x3F);
+    p += 3;
+  } else {
+    cp = kUnicodeReplacementCodepoint;
+  }
+  *it = reinterpret_cast<const char*>(p);
+  return cp;
+}
+}  // namespace rgb_matrix
+
+#endif  // RPI_UTF8_INTERNAL_H
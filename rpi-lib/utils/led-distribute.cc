@@ -0,0 +1,263 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Render on one host, show on many display nodes; see frame-distribution.h
+
+#include "led-matrix.h"
+#include "frame-distribution.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace rgb_matrix;
+
+volatile bool interrupt_received = false;
+static void InterruptHandler(int signo) {
+  interrupt_received = true;
+}
+
+static int usage(const char *progname) {
+  fprintf(stderr, "usage: %s -n <node> [-n <node>...] [options]\n"
+          "       %s -l <listen-address> [options]\n",
+          progname, progname);
+  fprintf(stderr, "Sends frames from a render host to display nodes.\n"
+          "Render host (no LED matrix needed):\n"
+          "\t-n <id>=<host:port>@<x>,<y>,<w>x<h> : Node <id> listens at "
+          "<host:port> and\n"
+          "\t                   shows the rectangle at x,y of size w x h. "
+          "Several nodes\n"
+          "\t                   can listen on the same multicast group.\n"
+          "\t-s <w>x<h>       : Frame size (Default: enclosing all nodes).\n"
+          "\t-f <fps>         : Frames per second (Default: 30).\n"
+          "\t-r <file>        : Read raw RGB24 frames of this size from file, "
+          "'-' for stdin.\n"
+          "\t                   Without it, shows a test animation.\n"
+          "Display node:\n"
+          "\t-l <address>     : Listen on [host:]port or multicast-group:port."
+          "\n"
+          "\t-i <id>          : Node id (Default: 0).\n"
+          "\t-T               : Test without panel: don't touch the GPIO.\n"
+          "\t-v               : Print latency and bandwidth once a second.\n");
+  fprintf(stderr, "\nGeneral LED matrix options:\n");
+  rgb_matrix::PrintMatrixFlags(stderr);
+  return 1;
+}
+
+static int64_t NowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct NodeSpec {
+  int id;
+  std::string address;
+  int x, y, width, height;
+};
+
+// <id>=<host:port>@<x>,<y>,<w>x<h>
+static bool ParseNode(const char *spec, NodeSpec *node) {
+  const char *equal = strchr(spec, '=');
+  const char *at = strrchr(spec, '@');
+  if (!equal || !at || at < equal) return false;
+  node->id = atoi(spec);
+  node->address.assign(equal + 1, at - equal - 1);
+  return sscanf(at + 1, "%d,%d,%dx%d", &node->x, &node->y,
+                &node->width, &node->height) == 4
+    && node->width > 0 && node->height > 0;
+}
+
+// A box bouncing over a calm background: most tiles stay the same from
+// frame to frame, like in a typical sign.
+static void DrawTestFrame(int64_t frame, RGBBuffer *buffer) {
+  const int size = 8;
+  buffer->Fill(0, 0, 40);
+  const int w = std::max(1, buffer->width() - size);
+  const int h = std::max(1, buffer->height() - size);
+  int x = frame % (2 * w), y = (frame / 2) % (2 * h);
+  if (x >= w) x = 2 * w - x;
+  if (y >= h) y = 2 * h - y;
+  for (int dy = 0; dy < size; ++dy) {
+    for (int dx = 0; dx < size; ++dx)
+      buffer->SetPixel(x + dx, y + dy, 255, 200, 0);
+  }
+}
+
+static int RunSender(const std::vector<NodeSpec> &nodes, int width,
+                     int height, int fps, const char *raw_input) {
+  FrameSender sender;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const NodeSpec &n = nodes[i];
+    if (!sender.AddNode(n.id, n.address.c_str(),
+                        n.x, n.y, n.width, n.height)) {
+      fprintf(stderr, "Node %d: can't use %s: %s\n", n.id,
+              n.address.c_str(), strerror(errno));
+      return 1;
+    }
+  }
+  FILE *input = NULL;
+  if (raw_input) {
+    input = strcmp(raw_input, "-") == 0 ? stdin : fopen(raw_input, "rb");
+    if (!input) {
+      perror(raw_input);
+      return 1;
+    }
+  }
+
+  RGBBuffer frame(width, height);
+  const int64_t interval = 1000000000LL / fps;
+  int64_t next_frame = NowNanos();
+  int64_t next_stats = next_frame + 1000000000LL;
+  for (int64_t n = 0; !interrupt_received; ++n) {
+    if (input) {
+      if (fread(frame.data(), frame.size(), 1, input) != 1) break;
+    } else {
+      DrawTestFrame(n, &frame);
+    }
+    sender.SendFrame(frame);
+
+    next_frame += interval;
+    int64_t now;
+    while ((now = NowNanos()) < next_frame && !interrupt_received)
+      sender.WaitForAcks((next_frame - now + 999999) / 1000000);
+    if (now < next_stats) continue;
+    for (int i = 0; i < sender.node_count(); ++i) {
+      const FrameSenderStats s = sender.TakeStats(i);
+      printf("node %2d: %3d frames sent, %3d acked, %8.1f kbit/s, "
+             "ack latency %7.1fus\n", nodes[i].id, s.frames_sent,
+             s.frames_acked, s.bytes * 8 / 1000.0, s.ack_latency_ns / 1e3);
+    }
+    fflush(stdout);
+    next_stats += 1000000000LL;
+  }
+  if (input && input != stdin) fclose(input);
+  return 0;
+}
+
+static int RunNode(const char *address, int node_id, bool verbose,
+                   RGBMatrix *matrix) {
+  FrameReceiver receiver(node_id, matrix->width(), matrix->height());
+  if (!receiver.Open(address)) {
+    fprintf(stderr, "Can't listen on %s: %s\n", address, strerror(errno));
+    return 1;
+  }
+  FrameCanvas *offscreen = matrix->CreateFrameCanvas();
+  int64_t next_stats = NowNanos() + 1000000000LL;
+  int64_t last_bytes = 0;
+  int frames = 0;
+  int64_t latency_sum = 0;
+  while (!interrupt_received) {
+    if (receiver.Receive(1000)) {
+      receiver.Apply(offscreen);
+      offscreen = matrix->SwapOnVSync(offscreen);
+      ++frames;
+      latency_sum += receiver.latency_ns();
+    }
+    if (!verbose || NowNanos() < next_stats) continue;
+    printf("node %2d: %3d frames, %8.1f kbit/s, latency %7.1fus\n",
+           node_id, frames, (receiver.bytes_received() - last_bytes) * 8
+           / 1000.0, frames ? latency_sum / frames / 1e3 : 0.0);
+    fflush(stdout);
+    last_bytes = receiver.bytes_received();
+    frames = 0;
+    latency_sum = 0;
+    next_stats += 1000000000LL;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  RGBMatrix::Options matrix_options;
+  rgb_matrix::RuntimeOptions runtime_opt;
+  if (!rgb_matrix::ParseOptionsFromFlags(&argc, &argv,
+                                         &matrix_options, &runtime_opt)) {
+    return usage(argv[0]);
+  }
+
+  std::vector<NodeSpec> nodes;
+  int width = 0, height = 0;
+  int fps = 30;
+  const char *raw_input = NULL;
+  const char *listen_address = NULL;
+  int node_id = 0;
+  bool verbose = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:s:f:r:l:i:Tv")) != -1) {
+    switch (opt) {
+    case 'n': {
+      NodeSpec node;
+      if (!ParseNode(optarg, &node)) {
+        fprintf(stderr, "Invalid node '%s'\n", optarg);
+        return usage(argv[0]);
+      }
+      nodes.push_back(node);
+      break;
+    }
+    case 's':
+      if (sscanf(optarg, "%dx%d", &width, &height) != 2) {
+        fprintf(stderr, "Invalid size '%s'\n", optarg);
+        return usage(argv[0]);
+      }
+      break;
+    case 'f': fps = atoi(optarg); break;
+    case 'r': raw_input = optarg; break;
+    case 'l': listen_address = optarg; break;
+    case 'i': node_id = atoi(optarg); break;
+    case 'T': runtime_opt.do_gpio_init = false; break;
+    case 'v': verbose = true; break;
+    default:
+      return usage(argv[0]);
+    }
+  }
+  if (nodes.empty() == (listen_address == NULL)) {
+    fprintf(stderr, "Need either nodes to send to (-n) or -l\n");
+    return usage(argv[0]);
+  }
+
+  signal(SIGTERM, InterruptHandler);
+  signal(SIGINT, InterruptHandler);
+
+  if (!nodes.empty()) {
+    if (width <= 0 || height <= 0) {
+      for (size_t i = 0; i < nodes.size(); ++i) {
+        width = std::max(width, nodes[i].x + nodes[i].width);
+        height = std::max(height, nodes[i].y + nodes[i].height);
+      }
+    }
+    if (fps <= 0 || width <= 0 || height <= 0) {
+      fprintf(stderr, "Invalid frame size or -f\n");
+      return usage(argv[0]);
+    }
+    return RunSender(nodes, width, height, fps, raw_input);
+  }
+
+  RGBMatrix *matrix = RGBMatrix::CreateFromOptions(matrix_options,
+                                                   runtime_opt);
+  if (matrix == NULL)
+    return 1;
+  const int result = RunNode(listen_address, node_id, verbose, matrix);
+  delete matrix;
+  return result;
+}
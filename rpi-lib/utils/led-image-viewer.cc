@@ -173,12 +173,17 @@ static bool LoadImageAndScale(const char *filename,
   return true;
 }
 
+// Frames read ahead while playing, so that a slow SD card doesn't delay
+// the next one.
+static const int kLookaheadFrames = 8;
+
 void DisplayAnimation(const FileInfo *file,
-                      RGBMatrix *matrix, FrameCanvas *offscreen_canvas) {
+                      RGBMatrix *matrix, FrameCanvas *offscreen_canvas,
+                      const std::vector<FrameCanvas*> &lookahead) {
   const tmillis_t duration_ms = (file->is_multi_frame
                                  ? file->params.anim_duration_ms
                                  : file->params.wait_ms);
-  rgb_matrix::StreamReader reader(file->content_stream);
+  rgb_matrix::PrefetchingStreamReader reader(file->content_stream, lookahead);
   int loops = file->params.loops;
   const tmillis_t end_time_ms = GetTimeInMillis() + duration_ms;
   const tmillis_t override_anim_delay = file->params.anim_delay_ms;
@@ -200,6 +205,10 @@ void DisplayAnimation(const FileInfo *file,
     }
     reader.Rewind();
   }
+  if (reader.underruns() > 0) {
+    fprintf(stderr, "%d frames were not read from disk in time\n",
+            reader.underruns());
+  }
 }
 
 static int usage(const char *progname) {
@@ -247,6 +256,16 @@ static int usage(const char *progname) {
   return 1;
 }
 
+// Write what is left of the -O stream and tell how the disk kept up.
+static void FinishStream(rgb_matrix::AsyncFileStreamIO *io) {
+  if (!io->Checkpoint()) perror("Writing stream");
+  const rgb_matrix::AsyncFileStreamIO::Stats s = io->GetStats();
+  fprintf(stderr, "Wrote %.1f MB at %.1f MB/s; longest wait for the disk "
+          "%.1fms, %.1fms in total\n", s.bytes_written / 1e6,
+          s.elapsed_nanos ? s.bytes_written * 1e3 / s.elapsed_nanos : 0.0,
+          s.max_stall_nanos / 1e6, s.stall_nanos / 1e6);
+}
+
 int main(int argc, char *argv[]) {
   Magick::InitializeMagick(*argv);
 
@@ -374,7 +393,7 @@ int main(int argc, char *argv[]) {
   const bool fill_height = false;
 
   // In case the output to stream is requested, set up the stream object.
-  rgb_matrix::StreamIO *stream_io = NULL;
+  rgb_matrix::AsyncFileStreamIO *stream_io = NULL;
   rgb_matrix::StreamWriter *global_stream_writer = NULL;
   if (stream_output) {
     int fd = open(stream_output, O_CREAT|O_WRONLY, 0644);
@@ -382,7 +401,7 @@ int main(int argc, char *argv[]) {
       perror("Couldn't open output stream");
       return 1;
     }
-    stream_io = new rgb_matrix::FileStreamIO(fd);
+    stream_io = new rgb_matrix::AsyncFileStreamIO(fd);
     global_stream_writer = new rgb_matrix::StreamWriter(stream_io);
   }
 
@@ -401,7 +420,7 @@ int main(int argc, char *argv[]) {
                           fill_width, fill_height, &image_sequence, &err_msg)) {
       file_info = new FileInfo();
       file_info->params = filename_params[filename];
-      file_info->content_stream = new rgb_matrix::MemStreamIO();
+      file_info->content_stream = new rgb_matrix::ChunkedMemStreamIO();
       file_info->is_multi_frame = image_sequence.size() > 1;
       rgb_matrix::StreamWriter out(file_info->content_stream);
       for (size_t i = 0; i < image_sequence.size(); ++i) {
@@ -420,6 +439,7 @@ int main(int argc, char *argv[]) {
       // Ok, not an image. Let's see if it is one of our streams.
       int fd = open(filename, O_RDONLY);
       if (fd >= 0) {
+        rgb_matrix::AdviseSequentialRead(fd);
         file_info = new FileInfo();
         file_info->params = filename_params[filename];
         if (do_mmap) {
@@ -463,6 +483,7 @@ int main(int argc, char *argv[]) {
 
   if (stream_output) {
     delete global_stream_writer;
+    FinishStream(stream_io);
     delete stream_io;
     if (file_imgs.size()) {
       fprintf(stderr, "Done: Output to stream %s; "
@@ -498,6 +519,10 @@ int main(int argc, char *argv[]) {
   fprintf(stderr, "Loading took %.3fs; now: Display.\n",
           (GetTimeInMillis() - start_load) / 1000.0);
 
+  std::vector<FrameCanvas*> lookahead_canvases;
+  for (int i = 0; i < kLookaheadFrames; ++i)
+    lookahead_canvases.push_back(matrix->CreateFrameCanvas());
+
   signal(SIGTERM, InterruptHandler);
   signal(SIGINT, InterruptHandler);
 
@@ -506,7 +531,8 @@ int main(int argc, char *argv[]) {
       std::random_shuffle(file_imgs.begin(), file_imgs.end());
     }
     for (size_t i = 0; i < file_imgs.size() && !interrupt_received; ++i) {
-      DisplayAnimation(file_imgs[i], matrix, offscreen_canvas);
+      DisplayAnimation(file_imgs[i], matrix, offscreen_canvas,
+                       lookahead_canvases);
     }
   } while (do_forever && !interrupt_received);
 
@@ -0,0 +1,591 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Signage playlist: cycles through clock, text, ticker, image and stream
+// items within one RGBMatrix, instead of starting a separate program for
+// each of them.
+//
+// All items are loaded once at startup. While one item is showing, the
+// first frame of the next one is already rendered into a spare FrameCanvas,
+// so the switch is just a SwapOnVSync() without a blank gap.
+//
+// Needs GraphicsMagick for images, just like led-image-viewer:
+// $ sudo apt-get install libgraphicsmagick++-dev libwebp-dev
+// $ make led-signage
+
+#include "led-matrix.h"
+#include "graphics.h"
+#include "content-streamer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Magick++.h>
+#include <magick/image.h>
+
+using rgb_matrix::Color;
+using rgb_matrix::FrameCanvas;
+using rgb_matrix::RGBMatrix;
+
+typedef int64_t tmicros_t;
+static const tmicros_t distant_future = (1LL<<50);
+
+volatile bool interrupt_received = false;
+static void InterruptHandler(int signo) {
+  interrupt_received = true;
+}
+
+static tmicros_t GetTimeInMicros(clockid_t clock = CLOCK_MONOTONIC) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (tmicros_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void SleepUntil(tmicros_t when) {
+  struct timespec ts;
+  ts.tv_sec = when / 1000000;
+  ts.tv_nsec = (when % 1000000) * 1000;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR
+         && !interrupt_received) {
+  }
+}
+
+// Settings shared by all the text based items.
+struct TextStyle {
+  TextStyle() : font(NULL), color(255, 255, 255), bg_color(0, 0, 0),
+                x(0), y(0), letter_spacing(0), scroll_speed(7) {}
+  const rgb_matrix::Font *font;
+  Color color;
+  Color bg_color;
+  int x, y;
+  int letter_spacing;
+  float scroll_speed;   // Letters per second for tickers.
+};
+
+// A content type that can be part of the playlist.
+//
+// Everything expensive (loading, decoding, scaling) belongs into Init(),
+// which is called once at startup. Render() only draws, as it is called
+// while the previous item is still on display.
+class PlaylistItem {
+public:
+  virtual ~PlaylistItem() {}
+
+  // Prepare the item; "scratch" has the size and settings of the matrix.
+  virtual bool Init(FrameCanvas *scratch, std::string *err) { return true; }
+
+  // Called each time before the item comes up.
+  virtual void Rewind() {}
+
+  // Render the frame that will be shown at monotonic time "show_time" into
+  // "canvas". Returns how long the frame should stay in microseconds.
+  virtual tmicros_t Render(FrameCanvas *canvas, tmicros_t show_time) = 0;
+};
+
+// The current time, updated every second.
+class ClockItem : public PlaylistItem {
+public:
+  ClockItem(const TextStyle &style, const std::string &format)
+    : style_(style), format_(format.empty() ? "%H:%M" : format) {}
+
+  virtual tmicros_t Render(FrameCanvas *canvas, tmicros_t show_time) {
+    // Shown a bit later, so that is the wall clock time to display.
+    const tmicros_t wall = show_time + GetTimeInMicros(CLOCK_REALTIME)
+      - GetTimeInMicros(CLOCK_MONOTONIC);
+    const time_t seconds = wall / 1000000;
+    struct tm tm;
+    localtime_r(&seconds, &tm);
+    char text[256];
+    strftime(text, sizeof(text), format_.c_str(), &tm);
+
+    canvas->Fill(style_.bg_color.r, style_.bg_color.g, style_.bg_color.b);
+    cache_.DrawText(canvas, *style_.font,
+                    style_.x, style_.y + style_.font->baseline(),
+                    style_.color, NULL, text, style_.letter_spacing);
+    return 1000000 - wall % 1000000;   // Until the next full second.
+  }
+
+private:
+  const TextStyle &style_;
+  const std::string format_;
+  rgb_matrix::TextRunCache cache_;
+};
+
+// Fixed text or, with "scroll", a ticker. If the text starts with '@', it
+// is read from that file each time the item comes up, so that other
+// programs (e.g. a weather fetcher run from cron) can provide it.
+class TextItem : public PlaylistItem {
+public:
+  TextItem(const TextStyle &style, const std::string &text, bool scroll)
+    : style_(style), source_(text), scroll_(scroll), cache_(2),
+      width_(0), length_(0), start_time_(-1) {}
+
+  virtual bool Init(FrameCanvas *scratch, std::string *err) {
+    width_ = scratch->width();
+    if (!source_.empty() && source_[0] == '@') {
+      std::ifstream probe(source_.c_str() + 1);
+      if (!probe.good()) {
+        *err = "Can't read " + source_.substr(1);
+        return false;
+      }
+    } else {
+      text_ = source_;
+    }
+    return true;
+  }
+
+  virtual void Rewind() {
+    if (!source_.empty() && source_[0] == '@') {
+      std::ifstream fs(source_.c_str() + 1);
+      std::string str((std::istreambuf_iterator<char>(fs)),
+                      std::istreambuf_iterator<char>());
+      std::replace(str.begin(), str.end(), '\n', ' ');
+      text_ = str;
+    }
+    length_ = cache_.MeasureText(*style_.font, text_.c_str(),
+                                 style_.letter_spacing);
+    start_time_ = -1;
+  }
+
+  virtual tmicros_t Render(FrameCanvas *canvas, tmicros_t show_time) {
+    canvas->Fill(style_.bg_color.r, style_.bg_color.g, style_.bg_color.b);
+    const int baseline = style_.y + style_.font->baseline();
+    if (!scroll_ || style_.scroll_speed <= 0) {
+      cache_.DrawText(canvas, *style_.font, style_.x, baseline,
+                      style_.color, NULL, text_.c_str(),
+                      style_.letter_spacing);
+      return distant_future;
+    }
+
+    // Position follows the time, so late frames don't slow the ticker down.
+    if (start_time_ < 0) start_time_ = show_time;
+    const int letter_width = std::max(1, style_.font->CharacterWidth('W'));
+    const tmicros_t pixel_us = std::max<tmicros_t>(
+      1, 1000000 / style_.scroll_speed / letter_width);
+    const int64_t travel = width_ + length_;
+    const int offset = ((show_time - start_time_) / pixel_us) % travel;
+    cache_.DrawText(canvas, *style_.font, width_ - offset, baseline,
+                    style_.color, NULL, text_.c_str(), style_.letter_spacing);
+    return pixel_us;
+  }
+
+private:
+  const TextStyle &style_;
+  const std::string source_;
+  const bool scroll_;
+  rgb_matrix::TextRunCache cache_;
+  std::string text_;
+  int width_;
+  int length_;
+  tmicros_t start_time_;
+};
+
+// Plays a content stream, e.g. as written by video-viewer or
+// led-image-viewer with -O, in a loop.
+class StreamItem : public PlaylistItem {
+public:
+  explicit StreamItem(const std::string &filename)
+    : filename_(filename), io_(NULL), reader_(NULL) {}
+  virtual ~StreamItem() {
+    delete reader_;
+    delete io_;
+  }
+
+  virtual bool Init(FrameCanvas *scratch, std::string *err) {
+    const int fd = open(filename_.c_str(), O_RDONLY);
+    if (fd < 0) {
+      *err = filename_ + ": " + strerror(errno);
+      return false;
+    }
+    // Mapped and read ahead, so that an SD-card doesn't stall us during
+    // playback.
+    rgb_matrix::AdviseSequentialRead(fd);
+    rgb_matrix::MemMapViewInput *mapped = new rgb_matrix::MemMapViewInput(fd);
+    if (mapped->IsInitialized()) {
+      io_ = mapped;
+    } else {
+      delete mapped;
+      io_ = new rgb_matrix::FileStreamIO(fd);
+    }
+    return StartReading(scratch, err);
+  }
+
+  virtual void Rewind() { reader_->Rewind(); }
+
+  virtual tmicros_t Render(FrameCanvas *canvas, tmicros_t show_time) {
+    uint32_t hold_us = 0;
+    if (!reader_->GetNext(canvas, &hold_us)) {
+      reader_->Rewind();   // Loop.
+      if (!reader_->GetNext(canvas, &hold_us)) return distant_future;
+    }
+    return hold_us > 0 ? hold_us : distant_future;
+  }
+
+protected:
+  // Check that the stream matches the matrix settings.
+  bool StartReading(FrameCanvas *scratch, std::string *err) {
+    reader_ = new rgb_matrix::StreamReader(io_);
+    if (!reader_->GetNext(scratch, NULL)) {
+      *err = filename_ + ": not a stream for this panel configuration";
+      return false;
+    }
+    reader_->Rewind();
+    return true;
+  }
+
+  const std::string filename_;
+  rgb_matrix::StreamIO *io_;
+  rgb_matrix::StreamReader *reader_;
+};
+
+// Still image or animation; decoded and scaled once into a stream in memory.
+class ImageItem : public StreamItem {
+public:
+  explicit ImageItem(const std::string &filename) : StreamItem(filename) {}
+
+  virtual bool Init(FrameCanvas *scratch, std::string *err) {
+    std::vector<Magick::Image> frames;
+    try {
+      readImages(&frames, filename_);
+    } catch (std::exception &e) {
+      *err = filename_ + ": " + (e.what() ? e.what() : "can't read");
+      return false;
+    }
+    if (frames.empty()) {
+      *err = filename_ + ": no image found";
+      return false;
+    }
+    std::vector<Magick::Image> sequence;
+    if (frames.size() > 1) {
+      Magick::coalesceImages(&sequence, frames.begin(), frames.end());
+    } else {
+      sequence.push_back(frames[0]);
+    }
+
+    io_ = new rgb_matrix::ChunkedMemStreamIO();
+    rgb_matrix::StreamWriter out(io_);
+    for (size_t i = 0; i < sequence.size(); ++i) {
+      Magick::Image &img = sequence[i];
+      img.scale(Magick::Geometry(scratch->width(), scratch->height()));
+      const int x_offset = (scratch->width() - img.columns()) / 2;
+      const int y_offset = (scratch->height() - img.rows()) / 2;
+      scratch->Clear();
+      for (size_t y = 0; y < img.rows(); ++y) {
+        for (size_t x = 0; x < img.columns(); ++x) {
+          const Magick::Color &c = img.pixelColor(x, y);
+          if (c.alphaQuantum() < 255) {
+            scratch->SetPixel(x + x_offset, y + y_offset,
+                              ScaleQuantumToChar(c.redQuantum()),
+                              ScaleQuantumToChar(c.greenQuantum()),
+                              ScaleQuantumToChar(c.blueQuantum()));
+          }
+        }
+      }
+      // Still images stay up until the item is over.
+      int64_t delay_us = 0;
+      if (sequence.size() > 1) {
+        delay_us = img.animationDelay() * 10000;  // unit in 1/100s
+        if (delay_us <= 0) delay_us = 100 * 1000;
+      }
+      out.Stream(*scratch, delay_us);
+    }
+    return StartReading(scratch, err);
+  }
+};
+
+struct PlaylistEntry {
+  PlaylistEntry() : item(NULL), duration(0), frames(0), cpu_us(0),
+                    max_render_us(0) {}
+  std::string description;
+  PlaylistItem *item;
+  tmicros_t duration;
+
+  // Statistics for -v
+  int64_t frames;
+  tmicros_t cpu_us;
+  tmicros_t max_render_us;
+};
+
+// Render a frame of "entry", keeping track of the CPU time spent.
+static tmicros_t RenderFrame(PlaylistEntry *entry, FrameCanvas *canvas,
+                             tmicros_t show_time) {
+  const tmicros_t start = GetTimeInMicros(CLOCK_THREAD_CPUTIME_ID);
+  const tmicros_t hold = entry->item->Render(canvas, show_time);
+  const tmicros_t spent = GetTimeInMicros(CLOCK_THREAD_CPUTIME_ID) - start;
+  entry->frames++;
+  entry->cpu_us += spent;
+  entry->max_render_us = std::max(entry->max_render_us, spent);
+  return std::max(hold, (tmicros_t)1000);
+}
+
+// Playlist lines are "<seconds> <type> [<argument>]", e.g.
+//   10 clock %H:%M:%S
+//   10 text @/run/weather.txt
+//   20 ticker Welcome to the show
+//   8  image logo.png
+//   30 stream clip.stream
+static bool LoadPlaylist(const char *filename, const TextStyle &style,
+                         std::vector<PlaylistEntry> *playlist) {
+  std::ifstream in(filename);
+  if (!in.good()) {
+    fprintf(stderr, "Can't open playlist %s\n", filename);
+    return false;
+  }
+  std::string line;
+  int line_no = 0;
+  while (std::getline(in, line)) {
+    ++line_no;
+    std::istringstream fields(line);
+    float seconds;
+    std::string type;
+    if (!(fields >> seconds)) continue;   // Empty or comment.
+    if (!(fields >> type)) {
+      fprintf(stderr, "%s:%d: missing item type\n", filename, line_no);
+      return false;
+    }
+    std::string arg;
+    std::getline(fields >> std::ws, arg);
+
+    if (style.font == NULL
+        && (type == "clock" || type == "text" || type == "ticker")) {
+      fprintf(stderr, "%s:%d: %s needs a font (-f)\n",
+              filename, line_no, type.c_str());
+      return false;
+    }
+    PlaylistEntry entry;
+    entry.description = type + " " + arg;
+    entry.duration = (tmicros_t)roundf(seconds * 1e6f);
+    if (type == "clock") {
+      entry.item = new ClockItem(style, arg);
+    } else if (type == "text") {
+      entry.item = new TextItem(style, arg, false);
+    } else if (type == "ticker") {
+      entry.item = new TextItem(style, arg, true);
+    } else if (type == "image") {
+      entry.item = new ImageItem(arg);
+    } else if (type == "stream") {
+      entry.item = new StreamItem(arg);
+    } else {
+      fprintf(stderr, "%s:%d: unknown item type '%s'\n",
+              filename, line_no, type.c_str());
+      return false;
+    }
+    playlist->push_back(entry);
+  }
+  if (playlist->empty()) {
+    fprintf(stderr, "Playlist %s is empty\n", filename);
+    return false;
+  }
+  return true;
+}
+
+static int usage(const char *progname) {
+  fprintf(stderr, "usage: %s [options] <playlist-file>\n", progname);
+  fprintf(stderr, "Shows the items of the playlist one after another.\n");
+  fprintf(stderr, "Each line of the playlist is\n"
+          "\t<seconds> <type> <argument>\n"
+          "with these types:\n"
+          "\tclock <strftime-format>  : Time, e.g. %%H:%%M (default)\n"
+          "\ttext <text>|@<file>      : Text, or content of file; it is\n"
+          "\t                           read each time the item comes up.\n"
+          "\tticker <text>|@<file>    : Same, scrolling.\n"
+          "\timage <file>             : Image or animated gif.\n"
+          "\tstream <file>            : Content stream as written with -O by\n"
+          "\t                           led-image-viewer or video-viewer.\n"
+          "Options:\n"
+          "\t-f <font-file>    : Font for clock, text and ticker items.\n"
+          "\t-C <r,g,b>        : Text Color. Default 255,255,255 (white)\n"
+          "\t-B <r,g,b>        : Background-Color. Default 0,0,0\n"
+          "\t-x <x-origin>     : X-Origin of text (Default: 0)\n"
+          "\t-y <y-origin>     : Y-Origin of text (Default: 0)\n"
+          "\t-t <track-spacing>: Spacing pixels between letters (Default: 0)\n"
+          "\t-s <speed>        : Ticker: approximate letters per second "
+          "(Default: 7)\n"
+          "\t-v                : Print switch timing and render CPU time.\n"
+          );
+  fprintf(stderr, "\nGeneral LED matrix options:\n");
+  rgb_matrix::PrintMatrixFlags(stderr);
+  return 1;
+}
+
+static bool parseColor(Color *c, const char *str) {
+  return sscanf(str, "%hhu,%hhu,%hhu", &c->r, &c->g, &c->b) == 3;
+}
+
+int main(int argc, char *argv[]) {
+  Magick::InitializeMagick(*argv);
+
+  RGBMatrix::Options matrix_options;
+  rgb_matrix::RuntimeOptions runtime_opt;
+  runtime_opt.drop_priv_user = getenv("SUDO_UID");
+  runtime_opt.drop_priv_group = getenv("SUDO_GID");
+  if (!rgb_matrix::ParseOptionsFromFlags(&argc, &argv,
+                                         &matrix_options, &runtime_opt)) {
+    return usage(argv[0]);
+  }
+
+  TextStyle style;
+  const char *bdf_font_file = NULL;
+  bool verbose = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:C:B:x:y:t:s:v")) != -1) {
+    switch (opt) {
+    case 'f': bdf_font_file = strdup(optarg); break;
+    case 'x': style.x = atoi(optarg); break;
+    case 'y': style.y = atoi(optarg); break;
+    case 't': style.letter_spacing = atoi(optarg); break;
+    case 's': style.scroll_speed = atof(optarg); break;
+    case 'v': verbose = true; break;
+    case 'C':
+      if (!parseColor(&style.color, optarg)) {
+        fprintf(stderr, "Invalid color spec: %s\n", optarg);
+        return usage(argv[0]);
+      }
+      break;
+    case 'B':
+      if (!parseColor(&style.bg_color, optarg)) {
+        fprintf(stderr, "Invalid background color spec: %s\n", optarg);
+        return usage(argv[0]);
+      }
+      break;
+    default:
+      return usage(argv[0]);
+    }
+  }
+
+  if (optind != argc - 1) {
+    fprintf(stderr, "Expected playlist file.\n");
+    return usage(argv[0]);
+  }
+
+  rgb_matrix::Font font;
+  if (bdf_font_file) {
+    if (!font.LoadFont(bdf_font_file)) {
+      fprintf(stderr, "Couldn't load font '%s'\n", bdf_font_file);
+      return 1;
+    }
+    style.font = &font;
+  }
+
+  std::vector<PlaylistEntry> playlist;
+  if (!LoadPlaylist(argv[optind], style, &playlist))
+    return 1;
+
+  RGBMatrix *matrix = RGBMatrix::CreateFromOptions(matrix_options, runtime_opt);
+  if (matrix == NULL)
+    return 1;
+
+  // The canvas being drawn, and the one holding the first frame of the
+  // upcoming item.
+  FrameCanvas *offscreen = matrix->CreateFrameCanvas();
+  FrameCanvas *upcoming = matrix->CreateFrameCanvas();
+
+  const tmicros_t start_load = GetTimeInMicros();
+  for (size_t i = 0; i < playlist.size(); ++i) {
+    std::string err;
+    if (!playlist[i].item->Init(offscreen, &err)) {
+      fprintf(stderr, "%s\n", err.c_str());
+      return 1;
+    }
+  }
+  fprintf(stderr, "Loading %d items took %.3fs\n", (int)playlist.size(),
+          (GetTimeInMicros() - start_load) / 1e6);
+
+  signal(SIGTERM, InterruptHandler);
+  signal(SIGINT, InterruptHandler);
+
+  // A single item just stays on.
+  if (playlist.size() == 1) playlist[0].duration = distant_future;
+
+  // "offscreen" holds the next frame of the current item, due at
+  // "show_time". "upcoming" holds the first frame of the next item, due at
+  // "item_end".
+  size_t current = 0;
+  PlaylistEntry *entry = &playlist[current];
+  tmicros_t show_time = GetTimeInMicros();
+  tmicros_t item_end = show_time + entry->duration;
+  entry->item->Rewind();
+  tmicros_t hold = RenderFrame(entry, offscreen, show_time);
+  tmicros_t upcoming_hold = 0;
+  bool upcoming_ready = false;
+
+  while (!interrupt_received) {
+    PlaylistEntry *next_entry = &playlist[(current + 1) % playlist.size()];
+    if (!upcoming_ready && next_entry != entry) {
+      // Render the start of the next item while we still have time.
+      next_entry->item->Rewind();
+      upcoming_hold = RenderFrame(next_entry, upcoming, item_end);
+      upcoming_ready = true;
+    }
+
+    if (show_time < item_end) {
+      SleepUntil(show_time);
+      offscreen = matrix->SwapOnVSync(offscreen);
+      show_time += hold;
+      if (show_time < item_end) {
+        hold = RenderFrame(entry, offscreen, show_time);
+      }
+      continue;
+    }
+
+    // Time for the next item; its first frame is ready.
+    SleepUntil(item_end);
+    upcoming = matrix->SwapOnVSync(upcoming);
+    if (verbose) {
+      fprintf(stderr, "%-24.24s: %6lld frames, CPU %8.3fms "
+              "(max %.3fms/frame), next on screen after %.3fms\n",
+              entry->description.c_str(), (long long)entry->frames,
+              entry->cpu_us / 1e3, entry->max_render_us / 1e3,
+              (GetTimeInMicros() - item_end) / 1e3);
+      entry->frames = 0;
+      entry->cpu_us = entry->max_render_us = 0;
+    }
+    current = (current + 1) % playlist.size();
+    entry = next_entry;
+    show_time = item_end + upcoming_hold;
+    item_end += entry->duration;
+    if (show_time < item_end) {
+      hold = RenderFrame(entry, offscreen, show_time);
+    }
+    upcoming_ready = false;
+  }
+
+  if (interrupt_received) {
+    fprintf(stderr, "Caught signal. Exiting.\n");
+  }
+
+  // Finished. Shut down the RGB matrix.
+  matrix->Clear();
+  delete matrix;
+
+  for (size_t i = 0; i < playlist.size(); ++i) {
+    delete playlist[i].item;
+  }
+  return 0;
+}
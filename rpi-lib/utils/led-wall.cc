@@ -0,0 +1,248 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil; -*-
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation version 2.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://gnu.org/licenses/gpl-2.0.txt>
+
+// Video wall out of several Pis that swap frames in lock-step. One
+// coordinator tells all nodes which frame to show when; see genlock.h.
+
+#include "led-matrix.h"
+#include "content-streamer.h"
+#include "genlock.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace rgb_matrix;
+
+volatile bool interrupt_received = false;
+static void InterruptHandler(int signo) {
+  interrupt_received = true;
+}
+
+static int usage(const char *progname) {
+  fprintf(stderr, "usage: %s -C <listen-address> [options]\n"
+          "       %s -c <coordinator-address> [options] [<stream-file>]\n",
+          progname, progname);
+  fprintf(stderr, "Shows frames on several Pis in sync.\n"
+          "Coordinator (no LED matrix needed):\n"
+          "\t-C [host:]port   : Coordinate nodes; listen here.\n"
+          "\t-f <fps>         : Frames per second (Default: 30).\n"
+          "\t-l <ms>          : Announce frames this early (Default: 100).\n"
+          "\t-n <frames>      : Stop after this many frames (Default: "
+          "endless).\n"
+          "Node:\n"
+          "\t-c <host:port>   : Coordinator to follow.\n"
+          "\t-i <id>          : Node id, position from left in the wall "
+          "(Default: 0).\n"
+          "\t-w <nodes>       : Wall width in nodes, for the test pattern "
+          "(Default: 1).\n"
+          "\t-v               : Print own sync statistics.\n"
+          "\t-T               : Test without panel: don't touch the GPIO, so\n"
+          "\t                   several nodes can run on one machine.\n"
+          "\t<stream-file>    : Show frame N of this stream for frame N, "
+          "e.g. from\n"
+          "\t                   led-image-viewer -O. Without it, a bar "
+          "sweeps across the wall.\n");
+  fprintf(stderr, "\nGeneral LED matrix options:\n");
+  rgb_matrix::PrintMatrixFlags(stderr);
+  return 1;
+}
+
+static void PrintReport(const GenlockReport &r) {
+  printf("node %2d frame %6u  offset %+10.1fus  rtt %7.1fus  "
+         "swap error %+8.1fus  jitter %7.1fus\n",
+         r.node_id, r.frame, r.offset_ns / 1e3, r.rtt_ns / 1e3,
+         r.swap_error_ns / 1e3, r.swap_jitter_ns / 1e3);
+  fflush(stdout);
+}
+
+static int RunCoordinator(const char *address, int fps, int lead_ms,
+                          int64_t frames) {
+  GenlockCoordinator coordinator;
+  if (!coordinator.Open(address)) {
+    fprintf(stderr, "Can't listen on %s: %s\n", address, strerror(errno));
+    return 1;
+  }
+  coordinator.SetReportHandler(&PrintReport);
+  printf("Coordinating on %s at %d fps. CTRL-C for exit.\n", address, fps);
+
+  const int64_t interval = 1000000000LL / fps;
+  const int64_t lead = lead_ms * 1000000LL;
+  // Give nodes a moment to sync their clocks before the first frame.
+  const int64_t start = GenlockNowNanos() + lead + 1000000000LL;
+  for (int64_t n = 0; !interrupt_received && n != frames; ++n) {
+    const int64_t present_at = start + n * interval;
+    coordinator.ServeUntil(present_at - lead);
+    coordinator.Announce((uint32_t)n, present_at);
+  }
+  return 0;
+}
+
+// Frames of a stream by number, wrapping around at the end.
+class StreamFrames {
+public:
+  StreamFrames(int fd) : io_(fd), reader_(&io_), next_(0), count_(0) {}
+
+  bool Load(uint32_t frame, FrameCanvas *canvas) {
+    uint32_t want = count_ ? frame % count_ : frame;
+    if (want < next_) {
+      reader_.Rewind();
+      next_ = 0;
+    }
+    uint32_t hold_time_us;
+    while (next_ <= want) {
+      if (!reader_.GetNext(canvas, &hold_time_us)) {
+        if (next_ == 0) return false;  // Empty or broken stream.
+        count_ = next_;
+        want = frame % count_;
+        reader_.Rewind();
+        next_ = 0;
+        continue;
+      }
+      ++next_;
+    }
+    return true;
+  }
+
+private:
+  FileStreamIO io_;
+  StreamReader reader_;
+  uint32_t next_;   // Number of the frame GetNext() reads next.
+  uint32_t count_;  // Frames in stream; 0 while not known yet.
+};
+
+// A bar sweeping across a wall "wall_width" nodes wide. Makes tearing
+// between nodes easy to see.
+static void DrawSweep(uint32_t frame, int node, int wall_width,
+                      FrameCanvas *canvas) {
+  canvas->Fill(0, 0, 40);
+  const int w = canvas->width();
+  const int x = frame % (w * wall_width) - node * w;
+  if (x < 0 || x >= w) return;
+  for (int bar = x; bar < x + 4 && bar < w; ++bar) {
+    for (int y = 0; y < canvas->height(); ++y)
+      canvas->SetPixel(bar, y, 255, 255, 255);
+  }
+}
+
+static int RunNode(const char *coordinator, int node_id, int wall_width,
+                   bool verbose, const char *stream_file,
+                   RGBMatrix *matrix) {
+  StreamFrames *stream = NULL;
+  if (stream_file) {
+    const int fd = open(stream_file, O_RDONLY);
+    if (fd < 0) {
+      perror(stream_file);
+      return 1;
+    }
+    stream = new StreamFrames(fd);
+  }
+  GenlockNode node(node_id);
+  if (!node.Open(coordinator)) {
+    fprintf(stderr, "Can't reach %s: %s\n", coordinator, strerror(errno));
+    return 1;
+  }
+
+  FrameCanvas *offscreen = matrix->CreateFrameCanvas();
+  uint32_t frame;
+  int64_t present_at;
+  uint32_t last_reported = 0;
+  while (!interrupt_received) {
+    if (!node.NextPresent(1000, &frame, &present_at)) {
+      if (!node.synced())
+        fprintf(stderr, "Waiting for coordinator %s\n", coordinator);
+      continue;
+    }
+    if (stream) {
+      if (!stream->Load(frame, offscreen)) {
+        fprintf(stderr, "Can't read frames from %s\n", stream_file);
+        break;
+      }
+    } else {
+      DrawSweep(frame, node_id, wall_width, offscreen);
+    }
+    node.SleepUntil(present_at);
+    offscreen = matrix->SwapOnVSync(offscreen);
+    node.Presented(present_at);
+    if (verbose && node.last_report().frame != last_reported) {
+      last_reported = node.last_report().frame;
+      PrintReport(node.last_report());
+    }
+  }
+  delete stream;
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  RGBMatrix::Options matrix_options;
+  rgb_matrix::RuntimeOptions runtime_opt;
+  if (!rgb_matrix::ParseOptionsFromFlags(&argc, &argv,
+                                         &matrix_options, &runtime_opt)) {
+    return usage(argv[0]);
+  }
+
+  const char *listen_address = NULL;
+  const char *coordinator = NULL;
+  int fps = 30;
+  int lead_ms = 100;
+  int64_t frames = -1;
+  int node_id = 0;
+  int wall_width = 1;
+  bool verbose = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "C:f:l:n:c:i:w:vT")) != -1) {
+    switch (opt) {
+    case 'C': listen_address = optarg; break;
+    case 'f': fps = atoi(optarg); break;
+    case 'l': lead_ms = atoi(optarg); break;
+    case 'n': frames = atoll(optarg); break;
+    case 'c': coordinator = optarg; break;
+    case 'i': node_id = atoi(optarg); break;
+    case 'w': wall_width = atoi(optarg); break;
+    case 'v': verbose = true; break;
+    case 'T': runtime_opt.do_gpio_init = false; break;
+    default:
+      return usage(argv[0]);
+    }
+  }
+  if ((listen_address == NULL) == (coordinator == NULL)) {
+    fprintf(stderr, "Need either -C or -c\n");
+    return usage(argv[0]);
+  }
+  if (fps <= 0 || lead_ms < 0 || wall_width < 1 || node_id < 0) {
+    fprintf(stderr, "Invalid -f, -l, -w or -i value\n");
+    return usage(argv[0]);
+  }
+
+  signal(SIGTERM, InterruptHandler);
+  signal(SIGINT, InterruptHandler);
+
+  if (listen_address)
+    return RunCoordinator(listen_address, fps, lead_ms, frames);
+
+  RGBMatrix *matrix = RGBMatrix::CreateFromOptions(matrix_options,
+                                                   runtime_opt);
+  if (matrix == NULL)
+    return 1;
+  const int result = RunNode(coordinator, node_id, wall_width, verbose,
+                             optind < argc ? argv[optind] : NULL, matrix);
+  delete matrix;
+  return result;
+}
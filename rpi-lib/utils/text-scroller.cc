@@ -15,12 +15,16 @@
 
 #include "led-matrix.h"
 #include "graphics.h"
+#include "content-streamer.h"
+#include "metrics.h"
 
 #include <algorithm>
 #include <fstream>
 #include <streambuf>
 #include <string>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <math.h>
 #include <signal.h>
@@ -60,6 +64,11 @@ static int usage(const char *progname) {
           "\t-C <r,g,b>        : Text Color. Default 255,255,255 (white)\n"
           "\t-B <r,g,b>        : Background-Color. Default 0,0,0\n"
           "\t-O <r,g,b>        : Outline-Color, e.g. to increase contrast.\n"
+          "\n"
+          "\t--record=<file>   : Write frames to stream-file instead of matrix.\n"
+          "\t--frames=<count>  : Number of frames to record (Default: 100).\n"
+          "\t--metrics=<addr>  : Serve Prometheus metrics at http://<addr>/metrics\n"
+          "\t                    <addr>: [host:]port or unix:<socket-path>\n"
           );
   fprintf(stderr, "\nGeneral LED matrix options:\n");
   rgb_matrix::PrintMatrixFlags(stderr);
@@ -142,10 +151,24 @@ int main(int argc, char *argv[]) {
   int loops = -1;
   int blink_on = 0;
   int blink_off = 0;
+  const char *record_file = NULL;
+  int record_frames = 100;
+  const char *metrics_address = NULL;
+
+  static struct option long_options[] = {
+    {"record", required_argument, 0, 'R'},
+    {"frames", required_argument, 0, 'n'},
+    {"metrics", required_argument, 0, 'M'},
+    {0, 0, 0, 0}
+  };
 
   int opt;
-  while ((opt = getopt(argc, argv, "x:y:f:C:B:O:t:s:l:b:i:")) != -1) {
+  while ((opt = getopt_long(argc, argv, "x:y:f:C:B:O:t:s:l:b:i:",
+                            long_options, NULL)) != -1) {
     switch (opt) {
+    case 'R': record_file = strdup(optarg); break;
+    case 'n': record_frames = atoi(optarg); break;
+    case 'M': metrics_address = strdup(optarg); break;
     case 's': speed = atof(optarg); break;
     case 'b':
       if (sscanf(optarg, "%d,%d", &blink_on, &blink_off) == 1) {
@@ -216,19 +239,53 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  /*
-   * If we want an outline around the font, we create a new font with
-   * the original font as a template that is just an outline font.
-   */
-  rgb_matrix::Font *outline_font = NULL;
-  if (with_outline) {
-    outline_font = font.CreateOutlineFont();
-  }
-
+  // The same line is drawn at a different position every frame, so we keep
+  // it laid out (including the outline if requested) in the cache.
+  rgb_matrix::TextRunCache text_cache(4);
+
+  rgb_matrix::Metrics metrics;
+  Counter *frames = metrics.AddCounter("rgbmatrix_frames_total",
+                                       "Frames shown.");
+  Counter *late_frames
+    = metrics.AddCounter("text_scroller_late_frames_total",
+                         "Frames that were ready after their scroll time.");
+  Histogram *render_seconds
+    = metrics.AddHistogram("rgbmatrix_frame_render_seconds",
+                           "Time to draw a frame.",
+                           {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005,
+                            0.01, 0.025});
+  Histogram *swap_wait_seconds
+    = metrics.AddHistogram("rgbmatrix_swap_wait_seconds",
+                           "Time waiting in SwapOnVSync().",
+                           {0.001, 0.0025, 0.005, 0.01, 0.02, 0.05, 0.1});
+
+  runtime_opt.do_gpio_init = (record_file == NULL);
   RGBMatrix *canvas = RGBMatrix::CreateFromOptions(matrix_options, runtime_opt);
   if (canvas == NULL)
     return 1;
 
+  // After creating the matrix, which might have forked into a daemon.
+  if (metrics_address && !record_file && !metrics.Serve(metrics_address)) {
+    fprintf(stderr, "Can't serve metrics on %s: %s\n", metrics_address,
+            strerror(errno));
+    delete canvas;
+    return 1;
+  }
+
+  // Recording frames to a stream instead of showing them (see ../golden-test)
+  rgb_matrix::StreamIO *record_io = NULL;
+  rgb_matrix::StreamWriter *recorder = NULL;
+  if (record_file) {
+    int fd = open(record_file, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+    if (fd < 0) {
+      perror("Couldn't open output stream");
+      return 1;
+    }
+    record_io = new rgb_matrix::FileStreamIO(fd);
+    recorder = new rgb_matrix::StreamWriter(record_io);
+  }
+  int64_t record_render_ns = 0;
+
   const bool all_extreme_colors = (matrix_options.brightness == 100)
     && FullSaturation(color)
     && FullSaturation(bg_color)
@@ -268,6 +325,8 @@ int main(int argc, char *argv[]) {
 
   uint64_t frame_counter = 0;
   while (!interrupt_received && loops != 0) {
+    struct timespec render_start;
+    clock_gettime(CLOCK_MONOTONIC, &render_start);
     if (input_file && ReadLineOnChange(input_file, &line, &last_change)) {
       x = x_orig;
     }
@@ -277,21 +336,18 @@ int main(int argc, char *argv[]) {
       || (frame_counter % (blink_on + blink_off) < (uint64_t)blink_on);
 
     if (draw_on_frame) {
-      if (outline_font) {
-        // The outline font, we need to write with a negative (-2) text-spacing,
-        // as we want to have the same letter pitch as the regular text that
-        // we then write on top.
-        rgb_matrix::DrawText(offscreen_canvas, *outline_font,
-                             x - 1, y + font.baseline(),
-                             outline_color, NULL,
-                             line.c_str(), letter_spacing - 2);
-      }
-
       // length = holds how many pixels our text takes up
-      length = rgb_matrix::DrawText(offscreen_canvas, font,
-                                    x, y + font.baseline(),
-                                    color, NULL,
-                                    line.c_str(), letter_spacing);
+      if (with_outline) {
+        length = text_cache.DrawTextOutlined(offscreen_canvas, font,
+                                             x, y + font.baseline(),
+                                             color, outline_color,
+                                             line.c_str(), letter_spacing);
+      } else {
+        length = text_cache.DrawText(offscreen_canvas, font,
+                                     x, y + font.baseline(),
+                                     color, NULL,
+                                     line.c_str(), letter_spacing);
+      }
     }
 
     x += scroll_direction;
@@ -301,6 +357,20 @@ int main(int argc, char *argv[]) {
       if (loops > 0) --loops;
     }
 
+    struct timespec render_end;
+    clock_gettime(CLOCK_MONOTONIC, &render_end);
+    const int64_t render_ns
+      = (render_end.tv_sec - render_start.tv_sec) * 1000000000LL
+      + (render_end.tv_nsec - render_start.tv_nsec);
+    render_seconds->ObserveNanos(render_ns);
+
+    if (recorder) {
+      record_render_ns += render_ns;
+      recorder->Stream(*offscreen_canvas, delay_speed_usec);
+      if (frame_counter >= (uint64_t)record_frames) break;
+      continue;
+    }
+
     // Make sure render-time delays are not influencing scroll-time
     if (speed > 0) {
       if (next_frame.tv_sec == 0 && next_frame.tv_nsec == 0) {
@@ -308,14 +378,34 @@ int main(int argc, char *argv[]) {
         clock_gettime(CLOCK_MONOTONIC, &next_frame);
       } else {
         add_micros(&next_frame, delay_speed_usec);
+        if (render_end.tv_sec > next_frame.tv_sec
+            || (render_end.tv_sec == next_frame.tv_sec
+                && render_end.tv_nsec > next_frame.tv_nsec)) {
+          late_frames->Increment();
+        }
         clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_frame, NULL);
       }
     }
     // Swap the offscreen_canvas with canvas on vsync, avoids flickering
+    struct timespec swap_start;
+    clock_gettime(CLOCK_MONOTONIC, &swap_start);
     offscreen_canvas = canvas->SwapOnVSync(offscreen_canvas);
+    struct timespec swap_end;
+    clock_gettime(CLOCK_MONOTONIC, &swap_end);
+    swap_wait_seconds->ObserveNanos(
+      (swap_end.tv_sec - swap_start.tv_sec) * 1000000000LL
+      + (swap_end.tv_nsec - swap_start.tv_nsec));
+    frames->Increment();
     if (speed <= 0) pause();  // Nothing to scroll.
   }
 
+  if (recorder) {
+    fprintf(stderr, "Recorded %d frames to %s; render time %.3fms\n",
+            (int)frame_counter, record_file, record_render_ns / 1e6);
+    delete recorder;
+    delete record_io;
+  }
+
   // Finished. Shut down the RGB matrix.
   canvas->Clear();
   delete canvas;
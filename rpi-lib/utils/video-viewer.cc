@@ -37,30 +37,54 @@ extern "C" {
 #  include <libavdevice/avdevice.h>
 }
 
+#include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <limits.h>
 #include <signal.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <thread>
 
 #include "led-matrix.h"
 #include "content-streamer.h"
+#include "metrics.h"
+#include "swap-queue.h"
 
+using rgb_matrix::Counter;
 using rgb_matrix::FrameCanvas;
+using rgb_matrix::Histogram;
 using rgb_matrix::RGBMatrix;
 using rgb_matrix::StreamWriter;
 using rgb_matrix::StreamIO;
+using rgb_matrix::SwapQueue;
 
 volatile bool interrupt_received = false;
 static void InterruptHandler(int) {
   interrupt_received = true;
 }
 
+// Lets libav give up waiting for input; "stop" points to a
+// std::atomic<bool>, set from the display loop while the decoder thread
+// reads.
+static int ShouldStopReading(void *stop) {
+  return interrupt_received || static_cast<std::atomic<bool>*>(stop)->load();
+}
+
+static int64_t RealtimeMicros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 struct LedPixel {
   uint8_t r, g, b;
 };
@@ -103,7 +127,11 @@ static int usage(const char *progname, const char *msg = NULL) {
           "\t                     (Tip: use --led-limit-refresh for stable rate)\n"
 	  "\t-T <threads>       : Number of threads used to decode (default 1, max=%d)\n"
           "\t-v                 : verbose; prints video metadata and other info.\n"
-          "\t-f                 : Loop forever.\n",
+          "\t-f                 : Loop forever.\n"
+          "\t--live             : Live input, e.g. a camera or a pipe: start quickly,\n"
+          "\t                     don't buffer and always show the newest frame.\n"
+          "\t--metrics=<addr>   : Serve Prometheus metrics at http://<addr>/metrics\n"
+          "\t                     <addr>: [host:]port or unix:<socket-path>\n",
 	  (int)std::thread::hardware_concurrency());
 
   fprintf(stderr, "\nGeneral LED matrix options:\n");
@@ -111,14 +139,107 @@ static int usage(const char *progname, const char *msg = NULL) {
   return 1;
 }
 
-static void add_nanos(struct timespec *accumulator, long nanoseconds) {
-  accumulator->tv_nsec += nanoseconds;
-  while (accumulator->tv_nsec > 1000000000) {
-    accumulator->tv_nsec -= 1000000000;
-    accumulator->tv_sec += 1;
-  }
+static int64_t NanosBetween(const struct timespec &start,
+                            const struct timespec &end) {
+  return (end.tv_sec - start.tv_sec) * 1000000000LL
+    + (end.tv_nsec - start.tv_nsec);
+}
+
+static int64_t MonotonicNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
+// Presentation times when playing at the video's own rate.
+//
+// Each frame is shown at its timestamp relative to the first one, measured
+// against the monotonic clock, so being slow for a while doesn't make the
+// whole video run slower. If we fall behind by more than a frame, frames
+// are dropped without converting them; further behind, the decoder skips
+// frames no other frame depends on until we're back on time.
+class PresentationClock {
+public:
+  struct Stats {
+    int shown, late, dropped;
+    int64_t drift_sum, drift_max;  // Nanoseconds swapped after due.
+  };
+
+  PresentationClock(AVRational time_base, int64_t frame_nanos)
+    : time_base_(time_base), frame_nanos_(frame_nanos), started_(false),
+      skipping_(false), origin_(0), last_pts_nanos_(0), last_shown_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+  }
+
+  // Start over with the next frame, e.g. after seeking.
+  void Restart() { started_ = skipping_ = false; }
+
+  // When to show the frame with the given timestamp.
+  int64_t PresentationTime(int64_t pts, int64_t now) {
+    const AVRational nanos = { 1, 1000000000 };
+    const int64_t pts_nanos = (pts == AV_NOPTS_VALUE)
+      ? last_pts_nanos_ + frame_nanos_
+      : av_rescale_q(pts, time_base_, nanos);
+    // Start, or a timestamp discontinuity: the frame is due a frame from now.
+    if (!started_ || pts_nanos < last_pts_nanos_ - kMaxJumpNanos
+        || pts_nanos > last_pts_nanos_ + kMaxJumpNanos) {
+      origin_ = now + frame_nanos_ - pts_nanos;
+      last_shown_ = now;
+      started_ = true;
+    }
+    last_pts_nanos_ = pts_nanos;
+    return origin_ + pts_nanos;
+  }
+
+  // Frame due at "present_at" is too late to show. Still show one now and
+  // then if we can't keep up at all.
+  bool ShouldDrop(int64_t present_at, int64_t now) {
+    if (now - present_at <= frame_nanos_ || now - last_shown_ > kMaxGapNanos)
+      return false;
+    stats_.dropped++;
+    return true;
+  }
+
+  // Very late: decoding frames we'd drop anyway is a waste.
+  bool ShouldSkipNonReference(int64_t present_at, int64_t now) {
+    if (now - present_at > kSkipDecodeFrames * frame_nanos_)
+      skipping_ = true;
+    else if (now <= present_at)
+      skipping_ = false;
+    return skipping_;
+  }
+
+  void Shown(int64_t present_at, int64_t ready, int64_t swapped) {
+    const int64_t drift = std::max<int64_t>(0, swapped - present_at);
+    stats_.shown++;
+    if (ready > present_at) stats_.late++;
+    stats_.drift_sum += drift;
+    stats_.drift_max = std::max(stats_.drift_max, drift);
+    last_shown_ = swapped;
+  }
+
+  // Stats since the last call.
+  Stats TakeStats() {
+    Stats result = stats_;
+    memset(&stats_, 0, sizeof(stats_));
+    return result;
+  }
+
+private:
+  static constexpr int64_t kMaxJumpNanos = 10000000000LL;  // 10s
+  static constexpr int64_t kMaxGapNanos = 250000000;       // 250ms
+  static constexpr int kSkipDecodeFrames = 2;
+
+  const AVRational time_base_;
+  const int64_t frame_nanos_;
+  bool started_;
+  bool skipping_;
+  int64_t origin_;          // Monotonic time of pts 0.
+  int64_t last_pts_nanos_;
+  int64_t last_shown_;
+  Stats stats_;
+};
+
 // Convert deprecated color formats to new and manually set the color range.
 // YUV has funny ranges (16-235), while the YUVJ are 0-255. SWS prefers to
 // deal with the YUV range, but then requires to set the output range.
@@ -158,6 +279,16 @@ SwsContext *CreateSWSContext(const AVCodecContext *codec_ctx,
   return swsCtx;
 }
 
+// Write what is left of the -O stream and tell how the disk kept up.
+static void FinishStream(rgb_matrix::AsyncFileStreamIO *io) {
+  if (!io->Checkpoint()) perror("Writing stream");
+  const rgb_matrix::AsyncFileStreamIO::Stats s = io->GetStats();
+  fprintf(stderr, "Wrote %.1f MB at %.1f MB/s; longest wait for the disk "
+          "%.1fms, %.1fms in total\n", s.bytes_written / 1e6,
+          s.elapsed_nanos ? s.bytes_written * 1e3 / s.elapsed_nanos : 0.0,
+          s.max_stall_nanos / 1e6, s.stall_nanos / 1e6);
+}
+
 int main(int argc, char *argv[]) {
   RGBMatrix::Options matrix_options;
   rgb_matrix::RuntimeOptions runtime_opt;
@@ -180,10 +311,25 @@ int main(int argc, char *argv[]) {
   int stream_output_fd = -1;
   unsigned int frame_skip = 0;
   int64_t framecount_limit = INT64_MAX;
+  const char *metrics_address = NULL;
+  bool live = false;
+
+  static struct option long_options[] = {
+    {"metrics", required_argument, 0, 'M'},
+    {"live", no_argument, 0, 'l'},
+    {0, 0, 0, 0}
+  };
 
   int opt;
-  while ((opt = getopt(argc, argv, "vO:R:Lfc:s:FV:T:")) != -1) {
+  while ((opt = getopt_long(argc, argv, "vO:R:Lfc:s:FV:T:",
+                            long_options, NULL)) != -1) {
     switch (opt) {
+    case 'M':
+      metrics_address = strdup(optarg);
+      break;
+    case 'l':
+      live = true;
+      break;
     case 'v':
       verbose = true;
       break;
@@ -234,6 +380,9 @@ int main(int argc, char *argv[]) {
     fprintf(stderr, "Expected video filename.\n");
     return usage(argv[0]);
   }
+  if (live && stream_output_fd >= 0) {
+    return usage(argv[0], "--live shows frames as they come; not with -O");
+  }
 
   const bool multiple_videos = (argc > optind + 1);
 
@@ -243,13 +392,47 @@ int main(int argc, char *argv[]) {
   if (matrix == NULL) {
     return 1;
   }
+
+  rgb_matrix::Metrics metrics;
+  Counter *videos = metrics.AddCounter("video_viewer_videos_total",
+                                       "Videos started.");
+  Counter *frames = metrics.AddCounter("rgbmatrix_frames_total",
+                                       "Frames shown.");
+  Counter *late_frames
+    = metrics.AddCounter("video_viewer_late_frames_total",
+                         "Frames that were ready after their show time.");
+  Histogram *render_seconds
+    = metrics.AddHistogram("rgbmatrix_frame_render_seconds",
+                           "Time to scale and copy a frame.",
+                           {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05});
+  Histogram *swap_wait_seconds
+    = metrics.AddHistogram("rgbmatrix_swap_wait_seconds",
+                           "Time waiting for vsync or a free frame.",
+                           {0.001, 0.0025, 0.005, 0.01, 0.02, 0.05, 0.1});
+  Counter *dropped_frames
+    = metrics.AddCounter("video_viewer_dropped_frames_total",
+                         "Frames not shown: too late, or with --live, "
+                         "replaced by a newer one.");
+  Histogram *latency_seconds
+    = metrics.AddHistogram("video_viewer_glass_to_glass_seconds",
+                           "--live: time from the frame timestamp to its "
+                           "swap, if the stream has wall-clock timestamps.",
+                           {0.02, 0.05, 0.1, 0.2, 0.5, 1, 2});
+  // After creating the matrix, which might have forked into a daemon.
+  if (metrics_address && !metrics.Serve(metrics_address)) {
+    fprintf(stderr, "Can't serve metrics on %s: %s\n", metrics_address,
+            strerror(errno));
+    delete matrix;
+    return 1;
+  }
   FrameCanvas *offscreen_canvas = matrix->CreateFrameCanvas();
 
   long frame_count = 0;
-  StreamIO *stream_io = NULL;
+  rgb_matrix::AsyncFileStreamIO *stream_io = NULL;
   StreamWriter *stream_writer = NULL;
   if (stream_output_fd >= 0) {
-    stream_io = new rgb_matrix::FileStreamIO(stream_output_fd);
+    // Written in the background; decoding doesn't wait for the SD card.
+    stream_io = new rgb_matrix::AsyncFileStreamIO(stream_output_fd);
     stream_writer = new StreamWriter(stream_io);
     if (forever) {
       fprintf(stderr, "-f (forever) doesn't make sense with -O; disabling\n");
@@ -257,6 +440,11 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  // Frames are queued to be swapped in at their time by a thread, so the
+  // next one can be decoded while the previous one waits.
+  SwapQueue *swap_queue = NULL;
+  if (!stream_writer && !live) swap_queue = new SwapQueue(matrix);
+
   // If we only have to loop a single video, we can avoid doing the
   // expensive video stream set-up and just repeat in an inner loop.
   const bool one_video_forever = forever && !multiple_videos;
@@ -279,7 +467,21 @@ int main(int argc, char *argv[]) {
       }
 
       AVFormatContext *format_context = avformat_alloc_context();
-      if (avformat_open_input(&format_context, movie_file, NULL, NULL) != 0) {
+      AVDictionary *input_options = NULL;
+      std::atomic<bool> stop_reading(false);
+      if (live) {
+        // Start right away instead of analyzing seconds of input first,
+        // and don't keep packets around.
+        av_dict_set(&input_options, "probesize", "32", 0);
+        av_dict_set(&input_options, "analyzeduration", "0", 0);
+        av_dict_set(&input_options, "fflags", "nobuffer", 0);
+        format_context->interrupt_callback.callback = ShouldStopReading;
+        format_context->interrupt_callback.opaque = &stop_reading;
+      }
+      const int open_result = avformat_open_input(&format_context, movie_file,
+                                                  NULL, &input_options);
+      av_dict_free(&input_options);
+      if (open_result != 0) {
         perror("Issue opening file: ");
         return -1;
       }
@@ -290,6 +492,7 @@ int main(int argc, char *argv[]) {
       }
 
       if (verbose) av_dump_format(format_context, 0, movie_file, 0);
+      videos->Increment();
 
       // Find the first video stream
       int videoStream = -1;
@@ -314,7 +517,13 @@ int main(int argc, char *argv[]) {
       if (verbose) fprintf(stderr, "FPS: %f\n", 1.0*rate.num / rate.den);
 
       AVCodecContext *codec_context = avcodec_alloc_context3(av_codec);
-      if (thread_count > 1 &&
+      if (live) {
+        // Frame threads hold back a frame per thread; slices don't.
+        codec_context->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        codec_context->thread_type = FF_THREAD_SLICE;
+        codec_context->thread_count =
+          std::min(thread_count, std::thread::hardware_concurrency());
+      } else if (thread_count > 1 &&
           av_codec->capabilities & AV_CODEC_CAP_FRAME_THREADS &&
           std::thread::hardware_concurrency() > 1) {
         codec_context->thread_type = FF_THREAD_FRAME;
@@ -370,19 +579,150 @@ int main(int argc, char *argv[]) {
         return 1;
       }
 
-
-      struct timespec next_frame;
+      // Without -V or -O, frames are shown at their timestamps.
+      const bool pts_paced = !stream_writer && !use_vsync_for_frame_timing;
+      PresentationClock clock(stream->time_base, frame_wait_nanos);
+      int64_t next_report = MonotonicNanos() + 1000000000;
+
+      // Frames submitted with a time; to see when they were shown.
+      struct Submitted {
+        SwapQueue::Fence fence;
+        int64_t present_at, ready;
+      };
+      std::deque<Submitted> submitted;
+      auto collect_shown = [&]() {
+        while (!submitted.empty()) {
+          const Submitted &f = submitted.front();
+          int64_t swapped;
+          const SwapQueue::FenceStatus status
+            = swap_queue->Status(f.fence, &swapped);
+          if (status == SwapQueue::PENDING) break;
+          if (status == SwapQueue::PRESENTED)
+            clock.Shown(f.present_at, f.ready, swapped);
+          submitted.pop_front();
+        }
+      };
 
       AVPacket *packet = av_packet_alloc();
       AVFrame *decode_frame = av_frame_alloc();  // Decode video into this
       do {
+        if (live) {
+          // Decode in a thread that keeps only the newest frame; show it as
+          // soon as the previous one is up. No pacing, no frames to skip.
+          std::mutex newest_mutex;
+          std::condition_variable newest_changed;
+          AVFrame *newest = av_frame_alloc();
+          bool have_newest = false;
+          bool decoder_done = false;
+          std::thread decoder([&]() {
+            AVFrame *frame = av_frame_alloc();
+            bool more_input = true;
+            while (more_input && !stop_reading) {
+              more_input = (av_read_frame(format_context, packet) == 0);
+              if (!more_input) {
+                avcodec_send_packet(codec_context, NULL);  // Flush.
+              } else {
+                if (packet->stream_index == videoStream)
+                  avcodec_send_packet(codec_context, packet);
+                av_packet_unref(packet);
+              }
+              while (avcodec_receive_frame(codec_context, frame) == 0) {
+                std::lock_guard<std::mutex> l(newest_mutex);
+                if (have_newest) {
+                  dropped_frames->Increment();
+                  av_frame_unref(newest);
+                }
+                av_frame_move_ref(newest, frame);
+                have_newest = true;
+                newest_changed.notify_one();
+              }
+            }
+            av_frame_free(&frame);
+            std::lock_guard<std::mutex> l(newest_mutex);
+            decoder_done = true;
+            newest_changed.notify_one();
+          });
+
+          const AVRational micros = { 1, 1000000 };
+          int64_t frames_left = framecount_limit;
+          int64_t next_report = RealtimeMicros() + 1000000;
+          int64_t latency_sum = 0, latency_max = 0;
+          int shown = 0, with_latency = 0;
+          for (;;) {
+            {
+              std::unique_lock<std::mutex> l(newest_mutex);
+              newest_changed.wait(l, [&]() {
+                  return have_newest || decoder_done;
+                });
+              if (!have_newest) break;
+              av_frame_unref(decode_frame);
+              av_frame_move_ref(decode_frame, newest);
+              have_newest = false;
+            }
+            struct timespec render_start, render_end, swap_end;
+            clock_gettime(CLOCK_MONOTONIC, &render_start);
+            sws_scale(sws_ctx, (uint8_t const * const *)decode_frame->data,
+                      decode_frame->linesize, 0, codec_context->height,
+                      output_frame->data, output_frame->linesize);
+            CopyFrame(output_frame, offscreen_canvas,
+                      display_offset_x, display_offset_y,
+                      display_width, display_height);
+            clock_gettime(CLOCK_MONOTONIC, &render_end);
+            render_seconds->ObserveNanos(NanosBetween(render_start,
+                                                      render_end));
+            offscreen_canvas = matrix->SwapOnVSync(offscreen_canvas,
+                                                   vsync_multiple);
+            clock_gettime(CLOCK_MONOTONIC, &swap_end);
+            swap_wait_seconds->ObserveNanos(NanosBetween(render_end,
+                                                         swap_end));
+            frames->Increment();
+            frame_count++;
+            shown++;
+
+            // Cameras and producers using the wall clock for timestamps
+            // tell us how old the frame is.
+            const int64_t now = RealtimeMicros();
+            const int64_t pts = decode_frame->best_effort_timestamp;
+            if (pts != AV_NOPTS_VALUE) {
+              const int64_t latency
+                = now - av_rescale_q(pts, stream->time_base, micros);
+              if (latency >= 0 && latency < 3600 * 1000000LL) {
+                latency_seconds->ObserveNanos(latency * 1000);
+                latency_sum += latency;
+                latency_max = std::max(latency_max, latency);
+                with_latency++;
+              }
+            }
+            if (verbose && now >= next_report) {
+              fprintf(stderr, "%d frames shown", shown);
+              if (with_latency) {
+                fprintf(stderr, "; glass-to-glass latency %.1fms, "
+                        "max %.1fms", latency_sum / with_latency / 1e3,
+                        latency_max / 1e3);
+              }
+              fprintf(stderr, "\n");
+              shown = with_latency = 0;
+              latency_sum = latency_max = 0;
+              next_report = now + 1000000;
+            }
+            if (--frames_left <= 0 || interrupt_received) {
+              stop_reading = true;
+              break;
+            }
+          }
+          decoder.join();
+          av_frame_free(&newest);
+          break;
+        }
+
         int64_t frames_left = framecount_limit;
         unsigned int frames_to_skip = frame_skip;
         if (one_video_forever) {
           av_seek_frame(format_context, videoStream, 0, AVSEEK_FLAG_ANY);
           avcodec_flush_buffers(codec_context);
         }
-        clock_gettime(CLOCK_MONOTONIC, &next_frame);
+        clock.Restart();
+        codec_context->skip_frame = AVDISCARD_DEFAULT;
 
         int decode_in_flight = 0;
         bool state_reading = true;
@@ -412,36 +752,93 @@ int main(int argc, char *argv[]) {
             avcodec_send_packet(codec_context, nullptr); // Trigger decode drain
           }
 
+          int received = 0;
           while (decode_in_flight &&
-                 avcodec_receive_frame(codec_context, decode_frame) == 0) {
+                 (received = avcodec_receive_frame(codec_context,
+                                                   decode_frame)) == 0) {
             --decode_in_flight;
 
             if (frames_to_skip) { frames_to_skip--; continue; }
 
-            // Determine absolute end of this frame now so that we don't include
-            // decoding overhead. TODO: skip frames if getting too slow ?
-            add_nanos(&next_frame, frame_wait_nanos);
+            int64_t present_at = 0;
+            if (pts_paced) {
+              const int64_t now = MonotonicNanos();
+              present_at = clock.PresentationTime(
+                decode_frame->best_effort_timestamp, now);
+              codec_context->skip_frame =
+                clock.ShouldSkipNonReference(present_at, now)
+                ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+              if (clock.ShouldDrop(present_at, now)) {
+                dropped_frames->Increment();
+                frames_left--;
+                continue;
+              }
+            }
 
             // Convert the image from its native format to RGB
+            struct timespec render_start, render_end;
+            clock_gettime(CLOCK_MONOTONIC, &render_start);
+            if (swap_queue) {
+              offscreen_canvas = swap_queue->Acquire();
+              struct timespec acquired;
+              clock_gettime(CLOCK_MONOTONIC, &acquired);
+              swap_wait_seconds->ObserveNanos(NanosBetween(render_start,
+                                                           acquired));
+              render_start = acquired;
+            }
             sws_scale(sws_ctx, (uint8_t const * const *)decode_frame->data,
                       decode_frame->linesize, 0, codec_context->height,
                       output_frame->data, output_frame->linesize);
             CopyFrame(output_frame, offscreen_canvas,
                       display_offset_x, display_offset_y,
                       display_width, display_height);
+            clock_gettime(CLOCK_MONOTONIC, &render_end);
+            render_seconds->ObserveNanos(NanosBetween(render_start,
+                                                      render_end));
             frame_count++;
             frames_left--;
             if (stream_writer) {
               if (verbose) fprintf(stderr, "%6ld", frame_count);
               stream_writer->Stream(*offscreen_canvas, frame_wait_nanos/1000);
             } else {
-              offscreen_canvas = matrix->SwapOnVSync(offscreen_canvas,
-                                                     vsync_multiple);
+              const SwapQueue::Fence fence
+                = swap_queue->Submit(offscreen_canvas, vsync_multiple,
+                                     present_at);
+              if (pts_paced) {
+                const int64_t ready = (render_end.tv_sec * 1000000000LL
+                                       + render_end.tv_nsec);
+                if (ready > present_at) late_frames->Increment();
+                submitted.push_back({fence, present_at, ready});
+                collect_shown();
+              }
             }
-            if (!stream_writer && !use_vsync_for_frame_timing) {
-              clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_frame, NULL);
+            frames->Increment();
+
+            const int64_t now = MonotonicNanos();
+            if (swap_queue && verbose && now >= next_report) {
+              const SwapQueue::Stats q = swap_queue->TakeStats();
+              if (pts_paced) {
+                const PresentationClock::Stats s = clock.TakeStats();
+                fprintf(stderr, "%d shown, %d late, %d dropped; "
+                        "drift %.1fms avg, %.1fms max; ", s.shown, s.late,
+                        s.dropped, s.shown ? s.drift_sum / 1e6 / s.shown : 0,
+                        s.drift_max / 1e6);
+              } else {
+                fprintf(stderr, "%d shown; ", q.presented);
+              }
+              // Time the decoder had nothing to do but wait for a frame.
+              fprintf(stderr, "%.0f%% idle\n", 100.0 * q.acquire_wait_nanos
+                      / (now - next_report + 1000000000));
+              next_report = now + 1000000000;
             }
           }
+          // Frames skipped by the decoder never come out; don't wait for them.
+          if (!state_reading && received == AVERROR_EOF)
+            decode_in_flight = 0;
+        }
+        if (swap_queue && !interrupt_received) {
+          swap_queue->Flush();  // Show the last frames before going on.
+          if (pts_paced) collect_shown();
         }
       } while (one_video_forever && !interrupt_received);
 
@@ -460,8 +857,10 @@ int main(int argc, char *argv[]) {
     fprintf(stderr, "Got interrupt. Exiting\n");
   }
 
+  delete swap_queue;
   delete matrix;
   delete stream_writer;
+  if (stream_io) FinishStream(stream_io);
   delete stream_io;
   fprintf(stderr, "Total of %ld frames decoded\n", frame_count);
 